@@ -17,6 +17,7 @@
 #          pointers.
 # CUDA : required to control offloading to NVIDIA GPUs.
 # libhdfs3 : required to access HDFS based cloud provider
+# liblz4, libzstd : optional fast codecs for the cloud offloading plugin
 
 include (FindPackageHandleStandardArgs)
 
@@ -276,6 +277,102 @@ mark_as_advanced(
   LIBOMPTARGET_DEP_ZLIB_INCLUDE_DIRS
   LIBOMPTARGET_DEP_ZLIB_LIBRARIES)
 
+################################################################################
+# Looking for liblz4...
+################################################################################
+
+find_path (
+  LIBOMPTARGET_DEP_LZ4_INCLUDE_DIR
+  NAMES
+    lz4.h
+  HINTS
+    ${LIBOMPTARGET_SEARCH_LZ4_INCLUDE_DIRS}
+  PATHS
+    /usr/include
+    /usr/local/include
+    /opt/local/include
+    /sw/include
+    ENV CPATH)
+
+# Don't bother look for the library if the header files were not found.
+if (LIBOMPTARGET_DEP_LZ4_INCLUDE_DIR)
+  find_library (
+      LIBOMPTARGET_DEP_LZ4_LIBRARIES
+    NAMES
+      lz4
+    HINTS
+      ${LIBOMPTARGET_SEARCH_LZ4_LIBDIR}
+      ${LIBOMPTARGET_SEARCH_LZ4_LIBRARY_DIRS}
+    PATHS
+      /usr/lib
+      /usr/local/lib
+      /opt/local/lib
+      /sw/lib
+      ENV LIBRARY_PATH
+      ENV LD_LIBRARY_PATH
+    PATH_SUFFIXES
+      ${CMAKE_LIBRARY_ARCHITECTURE})
+endif()
+
+set(LIBOMPTARGET_DEP_LZ4_INCLUDE_DIRS ${LIBOMPTARGET_DEP_LZ4_INCLUDE_DIR})
+find_package_handle_standard_args(
+  LIBOMPTARGET_DEP_LZ4
+  DEFAULT_MSG
+  LIBOMPTARGET_DEP_LZ4_LIBRARIES
+  LIBOMPTARGET_DEP_LZ4_INCLUDE_DIRS)
+
+mark_as_advanced(
+  LIBOMPTARGET_DEP_LZ4_INCLUDE_DIRS
+  LIBOMPTARGET_DEP_LZ4_LIBRARIES)
+
+################################################################################
+# Looking for libzstd...
+################################################################################
+
+find_path (
+  LIBOMPTARGET_DEP_ZSTD_INCLUDE_DIR
+  NAMES
+    zstd.h
+  HINTS
+    ${LIBOMPTARGET_SEARCH_ZSTD_INCLUDE_DIRS}
+  PATHS
+    /usr/include
+    /usr/local/include
+    /opt/local/include
+    /sw/include
+    ENV CPATH)
+
+# Don't bother look for the library if the header files were not found.
+if (LIBOMPTARGET_DEP_ZSTD_INCLUDE_DIR)
+  find_library (
+      LIBOMPTARGET_DEP_ZSTD_LIBRARIES
+    NAMES
+      zstd
+    HINTS
+      ${LIBOMPTARGET_SEARCH_ZSTD_LIBDIR}
+      ${LIBOMPTARGET_SEARCH_ZSTD_LIBRARY_DIRS}
+    PATHS
+      /usr/lib
+      /usr/local/lib
+      /opt/local/lib
+      /sw/lib
+      ENV LIBRARY_PATH
+      ENV LD_LIBRARY_PATH
+    PATH_SUFFIXES
+      ${CMAKE_LIBRARY_ARCHITECTURE})
+endif()
+
+set(LIBOMPTARGET_DEP_ZSTD_INCLUDE_DIRS ${LIBOMPTARGET_DEP_ZSTD_INCLUDE_DIR})
+find_package_handle_standard_args(
+  LIBOMPTARGET_DEP_ZSTD
+  DEFAULT_MSG
+  LIBOMPTARGET_DEP_ZSTD_LIBRARIES
+  LIBOMPTARGET_DEP_ZSTD_INCLUDE_DIRS)
+
+mark_as_advanced(
+  LIBOMPTARGET_DEP_ZSTD_INCLUDE_DIRS
+  LIBOMPTARGET_DEP_ZSTD_LIBRARIES)
+
 ################################################################################
 # Looking for sbt...
 ################################################################################
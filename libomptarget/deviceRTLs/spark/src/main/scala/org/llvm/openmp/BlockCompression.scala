@@ -0,0 +1,168 @@
+package org.llvm.openmp
+
+import java.io.OutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.zip.Deflater
+import java.util.zip.Inflater
+
+import com.github.luben.zstd.Zstd
+import net.jpountz.lz4.LZ4Factory
+
+/**
+ * Block compression format shared with the cloud plugin (see
+ * cloud_compression.h). Buffers are split into fixed-size blocks compressed
+ * independently, so that they can be (de)compressed in parallel.
+ */
+object BlockCompression {
+
+  val Magic = Array[Byte]('O', 'M', 'P', 'B')
+  val Version = 2
+  val HeaderSize = 32
+
+  val CodecDeflate = 1
+  val CodecLZ4 = 2
+  val CodecZstd = 3
+
+  val DefaultBlockSize = 4 * 1024 * 1024
+
+  /**
+   * Parse the compression option passed by the plugin
+   * @param option "deflate", "lz4" or "zstd" with an optional ":level"
+   * @return (codec, level) or None if it is not a block format
+   */
+  def parse(option: String): Option[(Int, Int)] = {
+    val parts = option.split(":")
+    val level = if (parts.size > 1) parts(1).toInt else -1
+    parts(0) match {
+      case "deflate" => Some((CodecDeflate, level))
+      case "lz4" => Some((CodecLZ4, level))
+      case "zstd" => Some((CodecZstd, level))
+      case _ => None
+    }
+  }
+
+  /**
+   * Parsed header and index of a block compressed buffer. The index follows
+   * the blocks.
+   */
+  class Index(data: Array[Byte]) {
+    private val bb = ByteBuffer.wrap(data).order(ByteOrder.LITTLE_ENDIAN)
+    private val version = bb.getInt(4)
+
+    if (!data.take(4).sameElements(Magic) || version != Version)
+      throw new RuntimeException("Invalid block compression header")
+
+    val codec = bb.getInt(8)
+    val numBlocks = bb.getInt(12)
+    val blockSize = bb.getLong(16).toInt
+    val rawSize = bb.getLong(24).toInt
+
+    private val indexOffset = data.length - 8 * numBlocks
+    val compSizes = Array.tabulate(numBlocks)(i => bb.getLong(indexOffset + 8 * i).toInt)
+    val offsets = compSizes.scanLeft(HeaderSize)(_ + _)
+
+    def rawBlockSize(i: Int): Int = math.min(blockSize, rawSize - i * blockSize)
+  }
+
+  /**
+   * Decompress one block, independently of the others
+   * @param data	the whole compressed buffer
+   * @param index	its parsed header
+   * @param i	the block number
+   * @param out	the destination of the raw data, at offset i * blockSize
+   */
+  def decompressBlock(data: Array[Byte], index: Index, i: Int, out: Array[Byte]): Unit = {
+    val inOff = index.offsets(i)
+    val inLen = index.compSizes(i)
+    val outOff = i * index.blockSize
+    val outLen = index.rawBlockSize(i)
+
+    // Incompressible blocks are stored as is
+    if (inLen == outLen) {
+      System.arraycopy(data, inOff, out, outOff, outLen)
+      return
+    }
+
+    index.codec match {
+      case CodecDeflate =>
+        val inflater = new Inflater
+        inflater.setInput(data, inOff, inLen)
+        val len = inflater.inflate(out, outOff, outLen)
+        inflater.end
+        if (len != outLen)
+          throw new RuntimeException("Corrupted deflate block " + i)
+      case CodecLZ4 =>
+        LZ4Factory.fastestInstance().safeDecompressor()
+          .decompress(data, inOff, inLen, out, outOff, outLen)
+      case CodecZstd =>
+        val raw = Zstd.decompress(data.slice(inOff, inOff + inLen), outLen)
+        System.arraycopy(raw, 0, out, outOff, outLen)
+      case c =>
+        throw new RuntimeException("Unsupported block compression codec " + c)
+    }
+  }
+
+  def decompress(data: Array[Byte]): Array[Byte] = {
+    val index = new Index(data)
+    val out = new Array[Byte](index.rawSize)
+    (0 until index.numBlocks).par.foreach(i => decompressBlock(data, index, i, out))
+    out
+  }
+
+  private def compressBlock(codec: Int, level: Int, in: Array[Byte]): Array[Byte] = {
+    val out = codec match {
+      case CodecDeflate =>
+        val deflater = new Deflater(if (level < 0) Deflater.DEFAULT_COMPRESSION else level)
+        deflater.setInput(in)
+        deflater.finish
+        val buf = new Array[Byte](in.length + 64)
+        var len = 0
+        while (!deflater.finished && len < buf.length)
+          len += deflater.deflate(buf, len, buf.length - len)
+        val done = deflater.finished
+        deflater.end
+        if (done) buf.take(len) else in
+      case CodecLZ4 =>
+        val factory = LZ4Factory.fastestInstance()
+        // Levels above 1 select the high compression variant
+        val compressor = if (level > 1) factory.highCompressor() else factory.fastCompressor()
+        compressor.compress(in)
+      case CodecZstd =>
+        Zstd.compress(in, if (level < 0) 3 else level)
+      case c =>
+        throw new RuntimeException("Unsupported block compression codec " + c)
+    }
+    if (out.length >= in.length) in else out
+  }
+
+  def compress(os: OutputStream, data: Array[Byte], codec: Int, level: Int,
+    blockSize: Int = DefaultBlockSize): Unit = {
+    val numBlocks = (data.length + blockSize - 1) / blockSize
+
+    val header = ByteBuffer.allocate(HeaderSize).order(ByteOrder.LITTLE_ENDIAN)
+    header.put(Magic)
+    header.putInt(Version)
+    header.putInt(codec)
+    header.putInt(numBlocks)
+    header.putLong(blockSize)
+    header.putLong(data.length)
+    os.write(header.array)
+
+    // Blocks are compressed and written by waves, so that only a few of them
+    // are kept in memory, and the index is written after them
+    val index = ByteBuffer.allocate(8 * numBlocks).order(ByteOrder.LITTLE_ENDIAN)
+    val waveSize = Runtime.getRuntime.availableProcessors
+    (0 until numBlocks).grouped(waveSize).foreach { wave =>
+      val blocks = wave.par.map { i =>
+        compressBlock(codec, level, data.slice(i * blockSize, math.min(data.length, (i + 1) * blockSize)))
+      }.toArray
+      blocks.foreach { b =>
+        index.putLong(b.length)
+        os.write(b)
+      }
+    }
+    os.write(index.array)
+  }
+
+}
@@ -2,6 +2,9 @@ package org.llvm.openmp
 
 import java.io.InputStream
 import java.io.OutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.Arrays
 import java.util.HashMap
 
 import scala.util.Try
@@ -19,41 +22,108 @@ class AddressTable(fs: CloudFileSystem) {
   val OMP_TGT_MAPTYPE_FROM = 0x002
   val OMP_TGT_MAPTYPE_LITERAL = 0x100
 
-  val mapSize = new HashMap[String, Int]
+  val mapSize = new HashMap[String, Long]
   val mapType = new HashMap[String, Int]
   val mapId = new HashMap[String, Int]
   val mapName = new HashMap[Int, String]
   val mapValue = new HashMap[String, Array[Byte]]
+  val mapCompressed = new HashMap[String, Boolean]
+  val mapInputName = new HashMap[String, String]
+  // Data larger than JVM's ByteArrays are split into several objects
+  val mapPartSize = new HashMap[String, Int]
+  // Modified pages to patch into the input, sent instead of the whole data
+  val mapDeltaName = new HashMap[String, String]
+
+  // Binary format written by the cloud plugin, see rtl.h
+  val ADDRESS_TABLE_MAGIC = "OMPT"
+  val ADDRESS_TABLE_VERSION = 3
+  val ADDRESS_TABLE_HEADER_SIZE = 24
+  val ADDRESS_TABLE_COMPRESSED = 0x1
 
   // Initialize address table
-  val csv = IOUtils.toString(fs.read("addressTable"))
-  
-  for (line <- csv.lines) {
-    val values = line.split(";").map(_.trim)
-    if (values.size != 5)
-      throw new RuntimeException("Problem when reading the address table")
-    val tgtPtr = values(0)
-    val size = values(1).toInt
-    val typeOfmapping = values(2).toInt
-    val scalaId = values(3).toInt
-    // Literals are passed by value within the address table
-    val value = Util.hexString2byteArray(values(4))
+  val table = IOUtils.toByteArray(fs.read("addressTable"))
+
+  if (table.size >= 4 && new String(table, 0, 4, "US-ASCII") == ADDRESS_TABLE_MAGIC)
+    readBinaryTable(table)
+  else
+    readTextTable(new String(table, "US-ASCII"))
+
+  private def addEntry(tgtPtr: String, size: Long, typeOfmapping: Int, scalaId: Int,
+                       compressed: Boolean, inputName: String, deltaName: String,
+                       partSize: Int, value: Array[Byte]) = {
     mapSize.put(tgtPtr, size)
     mapType.put(tgtPtr, typeOfmapping)
     mapId.put(tgtPtr, scalaId)
     mapName.put(scalaId, tgtPtr)
     mapValue.put(tgtPtr, value)
+    // The plugin decides which data are transferred compressed
+    mapCompressed.put(tgtPtr, compressed)
+    // Inputs are stored in objects named after their content
+    mapInputName.put(tgtPtr, inputName)
+    mapPartSize.put(tgtPtr, partSize)
+    mapDeltaName.put(tgtPtr, deltaName)
     println(tgtPtr + ";" + size + ";" + typeOfmapping + ";" + scalaId + ";")
   }
-  
+
+  private def readBinaryTable(table: Array[Byte]) = {
+    val bb = ByteBuffer.wrap(table).order(ByteOrder.LITTLE_ENDIAN)
+    bb.position(4)
+    val version = bb.getInt
+    if (version != ADDRESS_TABLE_VERSION)
+      throw new RuntimeException("Unsupported address table version " + version)
+    val numRecords = bb.getInt
+    val recordSize = bb.getInt
+    val blobSize = bb.getLong
+    val blobStart = ADDRESS_TABLE_HEADER_SIZE + numRecords * recordSize
+    if (table.size != blobStart + blobSize)
+      throw new RuntimeException("Problem when reading the address table")
+
+    for (i <- 0 until numRecords) {
+      bb.position(ADDRESS_TABLE_HEADER_SIZE + i * recordSize)
+      val tgtPtr = java.lang.Long.toUnsignedString(bb.getLong)
+      val size = bb.getLong
+      val typeOfmapping = bb.getLong.toInt
+      val scalaId = bb.getInt
+      val flags = bb.getInt
+      val nameOffset = blobStart + bb.getInt
+      val nameLength = bb.getInt
+      val valueOffset = blobStart + bb.getInt
+      val valueLength = bb.getInt
+      val partSize = bb.getLong.toInt
+      val deltaOffset = blobStart + bb.getInt
+      val deltaLength = bb.getInt
+      val inputName = new String(table, nameOffset, nameLength, "US-ASCII")
+      val deltaName = new String(table, deltaOffset, deltaLength, "US-ASCII")
+      // Literals are passed by value within the address table
+      val value = Arrays.copyOfRange(table, valueOffset, valueOffset + valueLength)
+      addEntry(tgtPtr, size, typeOfmapping, scalaId,
+        (flags & ADDRESS_TABLE_COMPRESSED) != 0, inputName, deltaName, partSize, value)
+    }
+  }
+
+  private def readTextTable(csv: String) = {
+    for (line <- csv.lines) {
+      val values = line.split(";").map(_.trim)
+      if (values.size != 9)
+        throw new RuntimeException("Problem when reading the address table")
+      addEntry(values(0), values(1).toLong, values(2).toInt, values(3).toInt,
+        values(4).toInt != 0, values(5), values(6), values(7).toInt,
+        Util.hexString2byteArray(values(8)))
+    }
+  }
+
   def init(scalaId: Int): Array[Byte] = {
     val tgtPtr = mapName.get(scalaId)
-    val size = mapSize.get(tgtPtr)
+    val size = getSize(scalaId)
     println("XXXX DEBUG XXXX SizeOf " + tgtPtr + " = " + size)
     
-    if ((mapType.get(tgtPtr) & OMP_TGT_MAPTYPE_TO) != 0)
-      fs.read(tgtPtr, size)
-    else if ((mapType.get(tgtPtr) & OMP_TGT_MAPTYPE_LITERAL) != 0)
+    if ((mapType.get(tgtPtr) & OMP_TGT_MAPTYPE_TO) != 0) {
+      val data = fs.read(mapInputName.get(tgtPtr), size, mapCompressed.get(tgtPtr))
+      val deltaName = mapDeltaName.get(tgtPtr)
+      if (!deltaName.isEmpty)
+        Util.applyDelta(data, IOUtils.toByteArray(fs.read(deltaName)))
+      data
+    } else if ((mapType.get(tgtPtr) & OMP_TGT_MAPTYPE_LITERAL) != 0)
       mapValue.get(tgtPtr)
     else
       new Array[Byte](size)
@@ -61,26 +131,88 @@ class AddressTable(fs: CloudFileSystem) {
   
   def finalize(scalaId: Int, data: Array[Byte]) = {
     val tgtPtr = mapName.get(scalaId)
-    val size = mapSize.get(tgtPtr)
+    val size = getSize(scalaId)
     if ((mapType.get(tgtPtr) & OMP_TGT_MAPTYPE_FROM) != 0)
-      fs.write(tgtPtr, size, data)
+      fs.write(tgtPtr, size, data, mapCompressed.get(tgtPtr))
   }
-  
+
+  // Partitioned data: partitions are stored as '<name>.part<N>' objects and
+  // are read and written in parallel. Unpartitioned data are seen as a
+  // single partition.
+  def initPartitions(scalaId: Int): Array[Array[Byte]] = {
+    if (!isPartitioned(scalaId))
+      return Array(init(scalaId))
+    (0 until getNumPartitions(scalaId)).par.map(initPartition(scalaId, _)).toArray
+  }
+
+  def initPartition(scalaId: Int, part: Int): Array[Byte] = {
+    val tgtPtr = mapName.get(scalaId)
+    val size = getPartitionSize(scalaId, part)
+    if ((mapType.get(tgtPtr) & OMP_TGT_MAPTYPE_TO) != 0)
+      fs.read(mapInputName.get(tgtPtr) + ".part" + part, size, mapCompressed.get(tgtPtr))
+    else
+      new Array[Byte](size)
+  }
+
+  def finalizePartitions(scalaId: Int, data: Array[Array[Byte]]) = {
+    if (!isPartitioned(scalaId))
+      finalize(scalaId, data(0))
+    else
+      data.zipWithIndex.par.foreach { case (d, part) => finalizePartition(scalaId, part, d) }
+  }
+
+  def finalizePartition(scalaId: Int, part: Int, data: Array[Byte]) = {
+    val tgtPtr = mapName.get(scalaId)
+    val size = getPartitionSize(scalaId, part)
+    if ((mapType.get(tgtPtr) & OMP_TGT_MAPTYPE_FROM) != 0)
+      fs.write(tgtPtr + ".part" + part, size, data, mapCompressed.get(tgtPtr))
+  }
+
+  def isPartitioned(scalaId: Int): Boolean = {
+    mapPartSize.get(mapName.get(scalaId)) != 0
+  }
+
+  def getNumPartitions(scalaId: Int): Int = {
+    val tgtPtr = mapName.get(scalaId)
+    val partSize = mapPartSize.get(tgtPtr)
+    if (partSize == 0)
+      1
+    else
+      ((mapSize.get(tgtPtr) + partSize - 1) / partSize).toInt
+  }
+
+  def getPartitionSize(scalaId: Int, part: Int): Int = {
+    val tgtPtr = mapName.get(scalaId)
+    val size: Long = mapSize.get(tgtPtr)
+    val partSize = mapPartSize.get(tgtPtr)
+    if (partSize == 0)
+      size.toInt
+    else
+      math.min(partSize.toLong, size - part.toLong * partSize).toInt
+  }
+
   def getSize(scalaId: Int): Int = {
     val tgtPtr = mapName.get(scalaId)
-    mapSize.get(tgtPtr)
+    if (isPartitioned(scalaId))
+      throw new RuntimeException("Data of " + tgtPtr + " are partitioned (" +
+        mapSize.get(tgtPtr) + " bytes), use initPartitions/finalizePartitions")
+    mapSize.get(tgtPtr).toInt
+  }
+
+  def getFullSize(scalaId: Int): Long = {
+    mapSize.get(mapName.get(scalaId))
   }
 
 }
 
 class CloudFileSystem(fs: FileSystem, path: String, compressOption: String) {
 
-  val MIN_SIZE_COMPRESSION = 1000000
-
   val ccf = new CompressionCodecFactory(new Configuration)
 
   var compress = false
   var codec : CompressionCodec = null
+  // Block compression format (codec, level) shared with the cloud plugin
+  var blockCodec : Option[(Int, Int)] = None
 
   compressOption match {
     case "gzip" =>
@@ -89,19 +221,27 @@ class CloudFileSystem(fs: FileSystem, path: String, compressOption: String) {
     case "false" =>
       compress = false
     case _ =>
-      throw new RuntimeException("Unsupported compression codec ("+ compressOption + ")")
+      blockCodec = BlockCompression.parse(compressOption)
+      if (blockCodec.isEmpty)
+        throw new RuntimeException("Unsupported compression codec ("+ compressOption + ")")
+      compress = true
   }
 
-  def write(name: String, size: Int, data: Array[Byte]): Unit = {
-    val compressIt = compress && size >= MIN_SIZE_COMPRESSION
+  def write(name: String, size: Int, data: Array[Byte], compressed: Boolean): Unit = {
+    val compressIt = compress && compressed
     val filepath = new Path(path + name)
     if (data.size != size)
       throw new RuntimeException("Wrong output size of " +
         filepath.toString() + " : " + data.size + " instead of " + size)
     var os: OutputStream = fs.create(filepath)
-    if (compressIt)
-      os = codec.createOutputStream(os)
-    os.write(data)
+    if (compressIt && blockCodec.isDefined) {
+      val (blockId, level) = blockCodec.get
+      BlockCompression.compress(os, data, blockId, level)
+    } else {
+      if (compressIt)
+        os = codec.createOutputStream(os)
+      os.write(data)
+    }
     os.close
   }
 
@@ -110,14 +250,16 @@ class CloudFileSystem(fs: FileSystem, path: String, compressOption: String) {
     fs.open(filepath)
   }
 
-  def read(name: String, size: Int): Array[Byte] = {
-    val compressIt = compress && size >= MIN_SIZE_COMPRESSION
+  def read(name: String, size: Int, compressed: Boolean): Array[Byte] = {
+    val compressIt = compress && compressed
     val filepath = new Path(path + name)
     var is: InputStream = fs.open(filepath)
-    if (compressIt)
+    if (compressIt && codec != null)
       is = codec.createInputStream(is)
-    val data = IOUtils.toByteArray(is)
+    var data = IOUtils.toByteArray(is)
     is.close
+    if (compressIt && blockCodec.isDefined)
+      data = BlockCompression.decompress(data)
     if (data.size != size)
       throw new RuntimeException("Wrong input size of " +
         filepath.toString() + " : " + data.size + " instead of " + size)
@@ -21,6 +21,10 @@ object NativeKernels {
   @transient
   var isAlreadyLoaded = false
 
+  // Shared by the kernels run by a persistent driver, so that the library is
+  // always registered from the same path
+  lazy val localDir = Files.createTempDir()
+
   def loadOnce(): Unit = {
     if (isAlreadyLoaded) return
     System.load(SparkFiles.get(LibraryName))
@@ -73,7 +77,7 @@ class CloudInfo(args: Array[String]) {
 
   val fs = FileSystem.get(URI.create(uri), sc.hadoopConfiguration)
 
-  val myTempDir = Files.createTempDir()
+  val myTempDir = NativeKernels.localDir
   val localLibrary = new File(myTempDir, NativeKernels.LibraryName)
 
   FileUtil.copy(fs, new Path(uri + path + NativeKernels.LibraryName), localLibrary, false, fsConf)
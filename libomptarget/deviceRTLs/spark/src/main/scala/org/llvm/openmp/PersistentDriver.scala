@@ -0,0 +1,61 @@
+package org.llvm.openmp
+
+import java.io.BufferedReader
+import java.io.InputStreamReader
+import java.io.PrintWriter
+import java.lang.reflect.InvocationTargetException
+import java.net.InetAddress
+import java.net.Socket
+
+import org.apache.spark.SparkConf
+import org.apache.spark.sql.SparkSession
+
+/**
+ * Driver kept alive between target regions, so that the JVM and the Spark
+ * session are only started once. The cloud plugin sends the kernels to
+ * execute through a control channel on the loopback interface, whose port is
+ * given by the OMPCLOUD_DRIVER_PORT environment variable.
+ *
+ * Arguments: the kernel class followed by its usual arguments.
+ */
+object PersistentDriver {
+
+  def main(args: Array[String]): Unit = {
+    val kernel = Class.forName(args(0)).getMethod("main", classOf[Array[String]])
+    val kernelArgs = args.drop(1)
+
+    // Create the session once, kernels retrieve it with getOrCreate. The
+    // native library is not uploaded yet, CloudInfo cannot be built here.
+    val conf = new SparkConf().set("spark.driver.maxResultSize", "0")
+    val session = SparkSession.builder().config(conf).getOrCreate()
+
+    val port = sys.env("OMPCLOUD_DRIVER_PORT").toInt
+    val socket = new Socket(InetAddress.getLoopbackAddress, port)
+    val in = new BufferedReader(new InputStreamReader(socket.getInputStream))
+    val out = new PrintWriter(socket.getOutputStream, true)
+
+    out.println("READY")
+
+    var line = in.readLine
+    while (line != null && line != "EXIT") {
+      if (line.startsWith("RUN ")) {
+        try {
+          kernel.invoke(null, kernelArgs)
+          out.println("DONE")
+        } catch {
+          case e: InvocationTargetException =>
+            out.println("FAIL " + e.getCause.toString.replace('\n', ' '))
+          case e: Exception =>
+            out.println("FAIL " + e.toString.replace('\n', ' '))
+        }
+      } else {
+        out.println("FAIL unknown command '" + line + "'")
+      }
+      line = in.readLine
+    }
+
+    socket.close
+    session.stop
+  }
+
+}
@@ -1,5 +1,8 @@
 package org.llvm.openmp
 
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
 object Util {
 
   /**
@@ -26,4 +29,29 @@ object Util {
     hexaStr.sliding(2, 2).toArray.map(Integer.parseInt(_, 16).toByte)
   }
 
+  /**
+   * Patch the modified ranges of a delta object into a ByteArray
+   * @param data  the ByteArray to patch
+   * @param delta the delta object written by the cloud plugin
+   * @return the patched ByteArray (data for memory efficiency)
+   */
+  def applyDelta(data: Array[Byte], delta: Array[Byte]): Array[Byte] = {
+    val bb = ByteBuffer.wrap(delta).order(ByteOrder.LITTLE_ENDIAN)
+    if (delta.size < 16 || new String(delta, 0, 4, "US-ASCII") != "OMPD")
+      throw new RuntimeException("Invalid delta object")
+    bb.position(4)
+    val version = bb.getInt
+    if (version != 1)
+      throw new RuntimeException("Unsupported delta version " + version)
+    val numRanges = bb.getLong.toInt
+    var dataPos = 16 + 16 * numRanges
+    for (i <- 0 until numRanges) {
+      val offset = bb.getLong.toInt
+      val length = bb.getLong.toInt
+      System.arraycopy(delta, dataPos, data, offset, length)
+      dataPos += length
+    }
+    return data
+  }
+
 }
\ No newline at end of file
@@ -32,6 +32,30 @@
 #define DP(...)                                                                \
   DEBUGP("Target " GETNAME(TARGET_NAME) " RTL, Amazon Provider:", __VA_ARGS__)
 
+// Stream data to S3 through the standard input of s3cmd
+class S3PipeWriter : public CloudWriter {
+  FILE *pipe;
+
+public:
+  S3PipeWriter(FILE *pipe) : pipe(pipe) {}
+
+  int32_t write(const void *buffer, size_t size) {
+    if (fwrite(buffer, 1, size, pipe) != size) {
+      fprintf(stderr, "ERROR: Streaming data to s3cmd failed.\n");
+      return OFFLOAD_FAIL;
+    }
+    return OFFLOAD_SUCCESS;
+  }
+
+  int32_t close() {
+    if (pclose(pipe) != 0) {
+      fprintf(stderr, "ERROR: s3cmd failed.\n");
+      return OFFLOAD_FAIL;
+    }
+    return OFFLOAD_SUCCESS;
+  }
+};
+
 CloudProvider *createAmazonProvider(SparkInfo &sparkInfo) {
   return new AmazonProvider(sparkInfo);
 }
@@ -99,6 +123,28 @@ int32_t AmazonProvider::send_file(std::string filename,
   return OFFLOAD_SUCCESS;
 }
 
+CloudWriter *AmazonProvider::open_writer(std::string tgtfilename) {
+  // s3cmd uploads from its standard input when the source is '-'
+  std::string command = "s3cmd put -";
+
+  command += " " + get_cloud_path(std::string(tgtfilename));
+  command += " " + get_keys();
+
+  if (spark.VerboseMode == Verbosity::quiet)
+    command += " > /dev/null";
+
+  if (spark.VerboseMode == Verbosity::debug)
+    fprintf(stdout, "Running: %s\n", command.c_str());
+
+  FILE *pipe = popen(command.c_str(), "w");
+  if (pipe == nullptr) {
+    fprintf(stderr, "ERROR: Failed to execute command\n");
+    return nullptr;
+  }
+
+  return new S3PipeWriter(pipe);
+}
+
 int32_t AmazonProvider::get_file(std::string host_filename,
                                  std::string filename) {
   // Copying data from cloud
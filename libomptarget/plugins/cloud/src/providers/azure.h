@@ -45,6 +45,8 @@ public:
   virtual int32_t get_file(std::string host_filename, std::string filename);
   virtual int32_t delete_file(std::string filename);
   virtual int32_t submit_job();
+  // The driver runs on the cluster, jobs are submitted through ssh
+  virtual std::string get_driver_command() { return ""; }
   virtual std::string get_job_args();
 };
 
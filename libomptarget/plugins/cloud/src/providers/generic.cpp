@@ -11,6 +11,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
@@ -33,6 +34,38 @@
 #define DP(...)                                                                \
   DEBUGP("Target " GETNAME(TARGET_NAME) " RTL, Generic Provider:", __VA_ARGS__)
 
+// Stream data directly into an HDFS file
+class HdfsWriter : public CloudWriter {
+  hdfsFS fs;
+  hdfsFile file;
+
+public:
+  HdfsWriter(hdfsFS fs, hdfsFile file) : fs(fs), file(file) {}
+
+  int32_t write(const void *buffer, size_t size) {
+    const char *ptr = static_cast<const char *>(buffer);
+    while (size > 0) {
+      tSize chunk_size = tSize(std::min(size, size_t(STREAM_CHUNK_SIZE)));
+      tSize retval = hdfsWrite(fs, file, ptr, chunk_size);
+      if (retval < 0) {
+        fprintf(stderr, "ERROR: Writing on HDFS failed.\n");
+        return OFFLOAD_FAIL;
+      }
+      ptr += retval;
+      size -= size_t(retval);
+    }
+    return OFFLOAD_SUCCESS;
+  }
+
+  int32_t close() {
+    if (hdfsCloseFile(fs, file) < 0) {
+      fprintf(stderr, "ERROR: Closing on HDFS failed.\n");
+      return OFFLOAD_FAIL;
+    }
+    return OFFLOAD_SUCCESS;
+  }
+};
+
 CloudProvider *createGenericProvider(SparkInfo &sparkInfo) {
   return new GenericProvider(sparkInfo);
 }
@@ -150,6 +183,23 @@ int32_t GenericProvider::send_file(std::string filename,
   return OFFLOAD_SUCCESS;
 }
 
+CloudWriter *GenericProvider::open_writer(std::string tgtfilename) {
+  std::string final_name = get_cloud_path(tgtfilename);
+
+  if (spark.VerboseMode != Verbosity::quiet)
+    DP("streaming data as %s\n", final_name.c_str());
+
+  hdfsFile file = hdfsOpenFile(hdfsFS(fs), final_name.c_str(), O_WRONLY,
+                               int(STREAM_CHUNK_SIZE), 0, 0);
+
+  if (file == nullptr) {
+    fprintf(stderr, "ERROR: Opening file in HDFS failed.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  return new HdfsWriter(hdfsFS(fs), file);
+}
+
 int32_t GenericProvider::get_file(std::string host_filename,
                                   std::string filename) {
   filename = get_cloud_path(filename);
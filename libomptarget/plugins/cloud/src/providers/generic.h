@@ -44,6 +44,7 @@ public:
   virtual int32_t parse_config(INIReader *reader);
   virtual int32_t init_device();
   virtual int32_t send_file(std::string filename, std::string tgtfilename);
+  virtual CloudWriter *open_writer(std::string tgtfilename);
   virtual int32_t get_file(std::string host_filename, std::string filename);
   virtual int32_t delete_file(std::string filename);
   virtual int32_t submit_job();
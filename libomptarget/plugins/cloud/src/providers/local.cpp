@@ -70,6 +70,17 @@ int32_t LocalProvider::send_file(std::string filename,
   return OFFLOAD_SUCCESS;
 }
 
+CloudWriter *LocalProvider::open_writer(std::string tgtfilename) {
+  std::string targetfilepath = get_cloud_path(tgtfilename);
+  FILE *file = fopen(targetfilepath.c_str(), "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "Error opening file: %s", targetfilepath.c_str());
+    perror("");
+    return nullptr;
+  }
+  return new FileWriter(file, targetfilepath);
+}
+
 int32_t LocalProvider::get_file(std::string host_filename,
                                 std::string filename) {
   std::string targetfilepath = get_cloud_path(filename);
@@ -31,6 +31,7 @@ public:
   int32_t parse_config(INIReader *reader);
   int32_t init_device();
   int32_t send_file(std::string filename, std::string tgtfilename);
+  CloudWriter *open_writer(std::string tgtfilename);
   int32_t get_file(std::string host_filename, std::string filename);
   void *data_alloc(int64_t size, int32_t type, int32_t id);
   int32_t delete_file(std::string filename);
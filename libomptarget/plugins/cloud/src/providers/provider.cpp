@@ -0,0 +1,66 @@
+//===-------------------- Target RTLs Implementation -------------- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Common implementation shared by all the providers of Cloud RTL
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "omptarget.h"
+
+#include "provider.h"
+
+int32_t CloudWriter::write_chunked(const void *buffer, size_t size) {
+  const char *ptr = static_cast<const char *>(buffer);
+
+  for (size_t offset = 0; offset < size; offset += STREAM_CHUNK_SIZE) {
+    size_t chunk_size = std::min(STREAM_CHUNK_SIZE, size - offset);
+    if (write(ptr + offset, chunk_size) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t FileWriter::write(const void *buffer, size_t size) {
+  if (fwrite(buffer, 1, size, file) != size) {
+    fprintf(stderr, "ERROR: Writing file %s failed.\n", filepath.c_str());
+    return OFFLOAD_FAIL;
+  }
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t FileWriter::close() {
+  if (fclose(file) != 0) {
+    fprintf(stderr, "ERROR: Closing file %s failed.\n", filepath.c_str());
+    return OFFLOAD_FAIL;
+  }
+  return OFFLOAD_SUCCESS;
+}
+
+std::string CloudProvider::get_driver_command() {
+  // In cluster mode, the driver does not run on the host
+  if (spark.Mode == SparkMode::cluster)
+    return "";
+
+  std::string cmd = spark.BinPath + "spark-submit";
+
+  cmd += " " + spark.AdditionalArgs;
+  cmd += " --name " + std::string("\"") + __progname + std::string("\"");
+  cmd += " --class " + DRIVER_SPARK_PACKAGE + " " + spark.JarPath;
+
+  // The driver runs the kernel class for each target region
+  cmd += " " + spark.Package + " " + get_job_args();
+
+  return cmd;
+}
@@ -16,6 +16,34 @@
 
 #include "rtl.h"
 
+// Size of the chunks pushed to the cloud storage when streaming buffers
+const size_t STREAM_CHUNK_SIZE = 1 << 20;
+
+// Sink receiving the content of a cloud object chunk by chunk
+class CloudWriter {
+public:
+  virtual ~CloudWriter() {}
+
+  virtual int32_t write(const void *buffer, size_t size) = 0;
+  virtual int32_t close() = 0;
+
+  // Write a buffer of any size as a sequence of STREAM_CHUNK_SIZE chunks
+  int32_t write_chunked(const void *buffer, size_t size);
+};
+
+// Writer backed by a host file, also used for temporary files
+class FileWriter : public CloudWriter {
+  FILE *file;
+  std::string filepath;
+
+public:
+  FileWriter(FILE *file, std::string filepath)
+      : file(file), filepath(filepath) {}
+
+  int32_t write(const void *buffer, size_t size);
+  int32_t close();
+};
+
 class CloudProvider {
 protected:
   SparkInfo spark;
@@ -29,9 +57,18 @@ public:
   virtual int32_t parse_config(INIReader *reader) = 0;
   virtual int32_t init_device() = 0;
   virtual int32_t send_file(std::string filename, std::string tgtfilename) = 0;
+
+  // Providers able to stream data to the cloud storage return a writer,
+  // others return nullptr and are fed through temporary files.
+  virtual CloudWriter *open_writer(std::string tgtfilename) { return nullptr; }
+
   virtual int32_t get_file(std::string host_filename, std::string filename) = 0;
   virtual int32_t delete_file(std::string filename) = 0;
   virtual int32_t submit_job() = 0;
+
+  // Command running the persistent Spark driver from the host, empty if the
+  // provider cannot do it (e.g. the driver runs on the cluster).
+  virtual std::string get_driver_command();
   virtual std::string get_job_args() = 0;
 };
 
@@ -11,17 +11,21 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <dlfcn.h>
 #include <ffi.h>
+#include <functional>
 #include <gelf.h>
 #ifndef __APPLE__
 #include <link.h>
 #endif
 #include <list>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -29,13 +33,14 @@
 #include <fstream>
 #include <inttypes.h>
 #include <iomanip>
-#include <thread>
 #include <unistd.h>
 
 #include "INIReader.h"
 #include "amazon.h"
 #include "azure.h"
 #include "cloud_compression.h"
+#include "cloud_driver.h"
+#include "cloud_queue.h"
 #include "cloud_util.h"
 #include "generic.h"
 #include "local.h"
@@ -91,6 +96,7 @@ static std::vector<struct ProviderListEntry> ExistingProviderList = {
 static std::vector<struct ProviderListEntry> ProviderList;
 
 static char *library_tmpfile = strdup("/tmp/libompcloudXXXXXX");
+static uint64_t library_hash = 0;
 
 /// Class containing all the device information.
 class RTLDeviceInfoTy {
@@ -108,10 +114,29 @@ public:
     int64_t Size;
     int64_t Type;
     int32_t ScalaId;
+    // Whether the data is compressed when transferred, shared with the Spark
+    // side through the address table
+    bool Compressed;
+    // Name of the cloud object holding the latest data of the buffer: the
+    // submitted input, or the output of the last target region which wrote
+    // it. The data stay resident there until they are retrieved.
+    std::string InputName;
+    // Whether the whole buffer was retrieved and not submitted since, the
+    // object InputName then holds the content identified by RetrievedHash
+    bool Retrieved;
+    uint64_t RetrievedHash;
+    // Modified pages to patch into InputName, empty if none
+    std::string DeltaName;
   };
   typedef std::map<void *, AddrTableValTy> AddrTableListTy;
 
   AddrTableListTy AddrTableMap;
+  // Protects AddrTableMap and CurrentTargetDataPtr, regions may be offloaded
+  // by several host threads
+  std::mutex AddrTable_mutex;
+  // Kernels of a device are run one at a time since they share the address
+  // table, transfers of other regions may overlap them
+  std::mutex Run_mutex;
 
   std::list<DynLibTy> DynLibs;
 
@@ -127,9 +152,26 @@ public:
   std::vector<CloudProvider *> Providers;
   std::vector<std::string> AddressTables;
   std::vector<ElapsedTime> ElapsedTimes;
+  std::vector<CompressionScheme> CompressionSchemes;
+  // Content hash of the objects uploaded during the session to their name
+  std::vector<std::map<uint64_t, std::string>> UploadCaches;
+
+  // Last version of a host buffer uploaded as a whole, deltas are computed
+  // against it
+  struct ResidentVersionTy {
+    size_t Size;
+    size_t PageSize;
+    std::vector<uint64_t> PageHashes;
+    uint64_t Hash;
+    std::string Name;
+    bool Compressed;
+  };
+  std::vector<std::map<void *, ResidentVersionTy>> ResidentVersions;
 
-  std::vector<std::vector<std::thread>> submitting_threads;
-  std::vector<std::vector<std::thread>> retrieving_threads;
+  // Pending data transfers of each device when threads are used
+  std::vector<TransferQueue *> TransferQueues;
+  // Long-lived Spark drivers executing the kernels, if enabled
+  std::vector<DriverChannel *> Drivers;
 
   // Record entry point associated with device.
   void createOffloadTable(int32_t device_id, __tgt_offload_entry *begin,
@@ -235,8 +277,11 @@ public:
     SparkClusters.resize(NumberOfDevices);
     Providers.resize(NumberOfDevices);
     ElapsedTimes = std::vector<ElapsedTime>(NumberOfDevices);
-    submitting_threads.resize(NumberOfDevices);
-    retrieving_threads.resize(NumberOfDevices);
+    CompressionSchemes.resize(NumberOfDevices);
+    UploadCaches.resize(NumberOfDevices);
+    ResidentVersions.resize(NumberOfDevices);
+    TransferQueues.resize(NumberOfDevices, nullptr);
+    Drivers.resize(NumberOfDevices, nullptr);
 
     for (int i = 0; i < NumberOfDevices; i++) {
       char *tmpname = strdup((working_path + "/addresstable_XXXXXX").c_str());
@@ -262,6 +307,13 @@ public:
     if (NumberOfDevices == 0)
       return;
 
+    // Finish the pending transfers before reporting timings
+    for (auto queue : TransferQueues)
+      delete queue;
+
+    for (auto driver : Drivers)
+      delete driver;
+
     if (verbose != Verbosity::quiet)
       for (int i = 0; i < NumberOfDevices; i++) {
         ElapsedTime &timing = ElapsedTimes[i];
@@ -270,6 +322,10 @@ public:
         DP("Compression = %ds\n", timing.CompressionTime);
         DP("Decompression = %ds\n", timing.DecompressionTime);
         DP("Execution = %ds\n", timing.SparkExecutionTime);
+        DP("Cache hits = %d - misses = %d\n", timing.CacheHits,
+           timing.CacheMisses);
+        DP("Delta uploads = %d (%zu bytes)\n", timing.DeltaUploads,
+           timing.DeltaBytes);
       }
 
     if (!SparkClusters[0].KeepTmpFiles)
@@ -320,7 +376,21 @@ int32_t __tgt_rtl_init_device(int32_t device_id) {
       DeviceInfo.reader->GetBoolean("Spark", "Compression", true),
       DeviceInfo.reader->Get("Spark", "CompressionFormat",
                              DEFAULT_COMPRESSION_FORMAT),
+      size_t(DeviceInfo.reader->GetInteger("Spark", "CompressionBlockSize",
+                                           DEFAULT_COMPRESSION_BLOCK_SIZE)),
+      DeviceInfo.reader->GetBoolean("Spark", "AdaptiveCompression", true),
+      DeviceInfo.reader->GetReal("Spark", "UplinkBandwidth",
+                                 DEFAULT_UPLINK_BANDWIDTH),
+      DeviceInfo.reader->GetBoolean("Spark", "DataCache", true),
+      size_t(DeviceInfo.reader->GetInteger("Spark", "PartitionSize",
+                                           DEFAULT_PARTITION_SIZE)),
+      DeviceInfo.reader->GetBoolean("Spark", "DeltaUpload", false),
+      size_t(DeviceInfo.reader->GetInteger("Spark", "DeltaPageSize",
+                                           DEFAULT_DELTA_PAGE_SIZE)),
       DeviceInfo.reader->GetBoolean("Spark", "UseThreads", true),
+      DeviceInfo.reader->GetBoolean("Spark", "TextAddressTable", false),
+      DeviceInfo.reader->GetBoolean("Spark", "PersistentDriver", false),
+      DeviceInfo.reader->Get("Spark", "DriverCommand", ""),
       DeviceInfo.verbose,
       DeviceInfo.reader->GetBoolean("Spark", "KeepTmpFiles", false),
       DeviceInfo.reader->Get("Spark", "SchedulingSize", "0"),
@@ -362,6 +432,25 @@ int32_t __tgt_rtl_init_device(int32_t device_id) {
     exit(EXIT_FAILURE);
   }
 
+  if (!parse_compression_format(spark.CompressionFormat,
+                                spark.CompressionBlockSize,
+                                DeviceInfo.CompressionSchemes[device_id])) {
+    fprintf(stderr, "ERROR: Unsupported compression format '%s'\n",
+            spark.CompressionFormat.c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  if (spark.PartitionSize == 0 || spark.PartitionSize > MAX_JAVA_INT) {
+    fprintf(stderr, "ERROR: Partition size must be between 1 and %ld\n",
+            MAX_JAVA_INT);
+    exit(EXIT_FAILURE);
+  }
+
+  if (spark.DeltaUpload && (!spark.DataCache || spark.DeltaPageSize == 0)) {
+    fprintf(stderr, "ERROR: Delta uploads need DataCache and a page size\n");
+    exit(EXIT_FAILURE);
+  }
+
   if (DeviceInfo.verbose != Verbosity::quiet) {
     DP("Spark HostName: '%s' - Port: '%d' - User: '%s' - Mode: %s\n",
        spark.ServAddress.c_str(), spark.ServPort, spark.UserName.c_str(),
@@ -382,6 +471,42 @@ int32_t __tgt_rtl_init_device(int32_t device_id) {
   DeviceInfo.Providers[device_id]->parse_config(DeviceInfo.reader);
   DeviceInfo.Providers[device_id]->init_device();
 
+  if (spark.UseThreads) {
+    // The provider section can override the number of concurrent transfers
+    long maxTransfers = DeviceInfo.reader->GetInteger(
+        providerSectionName, "MaxTransfers",
+        DeviceInfo.reader->GetInteger("Spark", "MaxTransfers",
+                                      DEFAULT_MAX_TRANSFERS));
+    if (maxTransfers < 1) {
+      fprintf(stderr, "ERROR: Invalid number of concurrent transfers %ld\n",
+              maxTransfers);
+      exit(EXIT_FAILURE);
+    }
+    if (spark.VerboseMode != Verbosity::quiet)
+      DP("Up to %ld concurrent transfers\n", maxTransfers);
+    DeviceInfo.TransferQueues[device_id] = new TransferQueue(maxTransfers);
+  }
+
+  // Start the driver once, kernels are then sent through its control channel
+  if (spark.PersistentDriver) {
+    std::string command = spark.DriverCommand;
+    if (command.empty())
+      command = DeviceInfo.Providers[device_id]->get_driver_command();
+    if (command.empty()) {
+      fprintf(stderr, "ERROR: Persistent driver not supported by provider %s\n",
+              ProviderList[device_id].ProviderName.c_str());
+      exit(EXIT_FAILURE);
+    }
+
+    DriverChannel *driver =
+        new DriverChannel(spark.VerboseMode == Verbosity::debug);
+    if (driver->start(command) != OFFLOAD_SUCCESS) {
+      fprintf(stderr, "ERROR: Cannot start the persistent driver\n");
+      exit(EXIT_FAILURE);
+    }
+    DeviceInfo.Drivers[device_id] = driver;
+  }
+
   return OFFLOAD_SUCCESS;
 }
 
@@ -472,6 +597,8 @@ __tgt_target_table *__tgt_rtl_load_binary(int32_t device_id,
   fwrite(image->ImageStart, ImageSize, 1, ftmp);
   fclose(ftmp);
 
+  library_hash = hash_buffer(image->ImageStart, ImageSize, 0);
+
   DynLibTy Lib = {library_tmpfile, dlopen(library_tmpfile, RTLD_LAZY)};
 
   if (!Lib.Handle) {
@@ -516,10 +643,19 @@ __tgt_target_table *__tgt_rtl_load_binary(int32_t device_id,
 
 void *__tgt_rtl_data_alloc(int32_t device_id, int64_t size, void *hst_ptr,
                            int64_t type) {
+  // Data only copied back from the device cannot be sampled, their
+  // compression is decided by their size
+  bool compressed = DeviceInfo.SparkClusters[device_id].Compression &&
+                    size >= MIN_SIZE_COMPRESSION;
+
+  std::unique_lock<std::mutex> lock(DeviceInfo.AddrTable_mutex);
   uintptr_t tgt_ptr_as_int = DeviceInfo.CurrentTargetDataPtr++;
   void *tgt_ptr = reinterpret_cast<void *>(tgt_ptr_as_int);
 
-  DeviceInfo.AddrTableMap[tgt_ptr] = {hst_ptr, tgt_ptr_as_int, size, type, -1};
+  DeviceInfo.AddrTableMap[tgt_ptr] = {hst_ptr, tgt_ptr_as_int, size,
+                                      type,    -1,             compressed,
+                                      std::to_string(tgt_ptr_as_int)};
+  lock.unlock();
 
   if (DeviceInfo.verbose != Verbosity::quiet)
     DP("Adding '%" PRIxPTR "' (Size=%ld - Type=0x%" PRIx64
@@ -530,32 +666,176 @@ void *__tgt_rtl_data_alloc(int32_t device_id, int64_t size, void *hst_ptr,
   return tgt_ptr;
 }
 
-static int32_t data_submit(int32_t device_id, void *hst_ptr, size_t size,
-                           int64_t id) {
-  double sizeInMB = size / (1024 * 1024);
-  if (size > MAX_JAVA_INT) {
-    fprintf(stderr,
-            "ERROR: Not supported -- size of %" PRId64
-            " is larger (%.2fMB) than the maximal size of JVM's bytearrays "
-            "(%.2fMB).\n",
-            id, sizeInMB, MAX_SIZE_IN_MB);
-    exit(EXIT_FAILURE);
+// Return true if an object with the same content is resident in the cloud
+// storage, 'name' is then set to the name of this object.
+static bool lookup_upload_cache(int32_t device_id, uint64_t hash,
+                                std::string &name) {
+  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  std::lock_guard<std::mutex> lock(timing.DataCache_mutex);
+  auto &cache = DeviceInfo.UploadCaches[device_id];
+
+  auto it = cache.find(hash);
+  if (it == cache.end()) {
+    timing.CacheMisses++;
+    return false;
+  }
+  timing.CacheHits++;
+  name = it->second;
+  return true;
+}
+
+// Record that the object 'name' holds the content identified by the hash, or
+// forget its content if it is about to be overwritten (no hash).
+static void record_upload_cache(int32_t device_id, const uint64_t *hash,
+                                const std::string &name) {
+  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  std::lock_guard<std::mutex> lock(timing.DataCache_mutex);
+  auto &cache = DeviceInfo.UploadCaches[device_id];
+
+  for (auto old = cache.begin(); old != cache.end();) {
+    if (old->second == name)
+      old = cache.erase(old);
+    else
+      ++old;
   }
+  if (hash)
+    cache[*hash] = name;
+}
 
+// Return true if an object with the same content was already uploaded as
+// 'name' during the session, otherwise record that it is about to be.
+static bool check_upload_cache(int32_t device_id, uint64_t hash,
+                               const std::string &name) {
   ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  std::lock_guard<std::mutex> lock(timing.DataCache_mutex);
+  auto &cache = DeviceInfo.UploadCaches[device_id];
 
-  bool needCompression = DeviceInfo.SparkClusters[device_id].Compression &&
-                         size >= MIN_SIZE_COMPRESSION;
+  auto it = cache.find(hash);
+  if (it != cache.end() && it->second == name) {
+    timing.CacheHits++;
+    return true;
+  }
+  timing.CacheMisses++;
+
+  // The object is overwritten, previous contents are not available anymore
+  for (auto old = cache.begin(); old != cache.end();) {
+    if (old->second == name)
+      old = cache.erase(old);
+    else
+      ++old;
+  }
+  cache[hash] = name;
+  return false;
+}
+
+// Decide whether compressing the buffer before uploading it pays off, from
+// the compressibility of a few samples and the measured uplink bandwidth.
+static bool need_compression(int32_t device_id, void *hst_ptr, size_t size) {
+  SparkInfo &spark = DeviceInfo.SparkClusters[device_id];
+
+  if (!spark.Compression || size < MIN_SIZE_COMPRESSION)
+    return false;
+
+  if (!spark.AdaptiveCompression)
+    return true;
+
+  CompressibilityEstimate estimate =
+      estimate_compressibility(static_cast<char *>(hst_ptr), size,
+                               DeviceInfo.CompressionSchemes[device_id]);
+
+  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  double bandwidth = spark.UplinkBandwidth * 1024 * 1024;
+  timing.Bandwidth_mutex.lock();
+  if (timing.UploadSeconds >= MIN_BANDWIDTH_MEASURE_TIME)
+    bandwidth = timing.UploadedBytes / timing.UploadSeconds;
+  timing.Bandwidth_mutex.unlock();
+
+  double raw_time = size / bandwidth;
+  double comp_time =
+      size / estimate.Throughput + size * estimate.Ratio / bandwidth;
+  bool compress =
+      estimate.Ratio <= MAX_COMPRESSION_RATIO && comp_time < raw_time;
+
+  if (DeviceInfo.verbose != Verbosity::quiet)
+    DP("Estimated ratio %.2f at %.1fMB/s (uplink %.1fMB/s): %s\n",
+       estimate.Ratio, estimate.Throughput / (1024 * 1024),
+       bandwidth / (1024 * 1024), compress ? "compress" : "send raw");
+
+  return compress;
+}
+
+// Upload the buffer as a single cloud object
+static int32_t send_object(int32_t device_id, void *hst_ptr, size_t size,
+                           std::string filename, bool needCompression) {
+  double sizeInMB = size / (1024 * 1024);
+
+  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+
+  const CompressionScheme &scheme = DeviceInfo.CompressionSchemes[device_id];
+
+  CloudProvider *provider = DeviceInfo.Providers[device_id];
+
+  // Stream host memory straight to the cloud storage when the provider
+  // supports it, so that no temporary file is written on the host.
+  if (CloudWriter *writer = provider->open_writer(filename)) {
+    int32_t ret_val = OFFLOAD_SUCCESS;
+    size_t sendingSize;
+
+    auto t_start = std::chrono::high_resolution_clock::now();
+    if (needCompression) {
+      if (scheme.Block)
+        sendingSize = block_compress_to_writer(
+            writer, static_cast<char *>(hst_ptr), size, scheme);
+      else
+        sendingSize =
+            compress_to_writer(writer, static_cast<char *>(hst_ptr), size);
+      if (sendingSize == 0)
+        ret_val = OFFLOAD_FAIL;
+    } else {
+      ret_val = writer->write_chunked(hst_ptr, size);
+      sendingSize = size;
+    }
+    if (writer->close() != OFFLOAD_SUCCESS)
+      ret_val = OFFLOAD_FAIL;
+    delete writer;
+    auto t_end = std::chrono::high_resolution_clock::now();
+    auto t_delay =
+        std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start)
+            .count();
+
+    // Only raw transfers measure the uplink bandwidth alone
+    if (!needCompression) {
+      timing.Bandwidth_mutex.lock();
+      timing.UploadedBytes += sendingSize;
+      timing.UploadSeconds +=
+          std::chrono::duration<double>(t_end - t_start).count();
+      timing.Bandwidth_mutex.unlock();
+    }
+
+    // Compression and upload are interleaved, the whole transfer is
+    // accounted as upload time.
+    timing.UploadTime_mutex.lock();
+    timing.UploadTime += t_delay;
+    timing.UploadTime_mutex.unlock();
+
+    if (DeviceInfo.verbose != Verbosity::quiet)
+      DP("Streamed %.1fMB (%.1fMB sent) in %lds\n", sizeInMB,
+         sendingSize / (1024.0 * 1024.0), t_delay);
+
+    return ret_val;
+  }
 
-  // Since we now need the hdfs file, we create it here
-  std::string filename = std::to_string(id);
   std::string host_filepath = DeviceInfo.working_path + "/" + filename;
 
   size_t sendingSize;
   if (needCompression) {
     auto t_start = std::chrono::high_resolution_clock::now();
-    sendingSize =
-        compress_to_file(host_filepath, static_cast<char *>(hst_ptr), size);
+    if (scheme.Block)
+      sendingSize = block_compress_to_file(
+          host_filepath, static_cast<char *>(hst_ptr), size, scheme);
+    else
+      sendingSize =
+          compress_to_file(host_filepath, static_cast<char *>(hst_ptr), size);
     auto t_end = std::chrono::high_resolution_clock::now();
     auto t_delay =
         std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start)
@@ -580,8 +860,7 @@ static int32_t data_submit(int32_t device_id, void *hst_ptr, size_t size,
 
   double sendingSizeInMB = sendingSize / (1024 * 1024);
   auto t_start = std::chrono::high_resolution_clock::now();
-  int ret_val =
-      DeviceInfo.Providers[device_id]->send_file(host_filepath, filename);
+  int ret_val = provider->send_file(host_filepath, filename);
   auto t_end = std::chrono::high_resolution_clock::now();
   auto t_delay =
       std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
@@ -589,6 +868,12 @@ static int32_t data_submit(int32_t device_id, void *hst_ptr, size_t size,
   timing.UploadTime += t_delay;
   timing.UploadTime_mutex.unlock();
 
+  timing.Bandwidth_mutex.lock();
+  timing.UploadedBytes += sendingSize;
+  timing.UploadSeconds +=
+      std::chrono::duration<double>(t_end - t_start).count();
+  timing.Bandwidth_mutex.unlock();
+
   if (DeviceInfo.verbose != Verbosity::quiet)
     DP("Uploaded %.1fMB in %lds\n", sendingSizeInMB, t_delay);
 
@@ -598,24 +883,13 @@ static int32_t data_submit(int32_t device_id, void *hst_ptr, size_t size,
   return ret_val;
 }
 
-static int32_t data_retrieve(int32_t device_id, void *hst_ptr, size_t size,
-                             int64_t id) {
+// Download a single cloud object into the buffer
+static int32_t get_object(int32_t device_id, void *hst_ptr, size_t size,
+                          std::string filename, bool needDecompression) {
   double sizeInMB = size / (1024 * 1024);
-  if (size > MAX_JAVA_INT) {
-    fprintf(stderr,
-            "ERROR: Not supported -- size of %" PRId64
-            " is larger (%.1fMB) than the maximal size of JVM's bytearrays "
-            "(%.1fMB).\n",
-            id, sizeInMB, MAX_SIZE_IN_MB);
-    exit(EXIT_FAILURE);
-  }
 
   ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
 
-  bool needDecompression = DeviceInfo.SparkClusters[device_id].Compression &&
-                           size >= MIN_SIZE_COMPRESSION;
-
-  std::string filename = std::to_string(id);
   std::string host_filepath = DeviceInfo.working_path + "/" + filename;
 
   auto t_start = std::chrono::high_resolution_clock::now();
@@ -633,8 +907,13 @@ static int32_t data_retrieve(int32_t device_id, void *hst_ptr, size_t size,
   if (needDecompression) {
     auto t_start = std::chrono::high_resolution_clock::now();
     // Decompress data directly to the host memory
-    size_t decomp_size =
-        decompress_file(host_filepath, static_cast<char *>(hst_ptr), size);
+    size_t decomp_size;
+    if (DeviceInfo.CompressionSchemes[device_id].Block)
+      decomp_size = block_decompress_file(host_filepath,
+                                          static_cast<char *>(hst_ptr), size);
+    else
+      decomp_size =
+          decompress_file(host_filepath, static_cast<char *>(hst_ptr), size);
     if (decomp_size != size) {
       fprintf(stderr, "Decompressed data are not the right size. => %zu\n",
               decomp_size);
@@ -682,20 +961,329 @@ static int32_t data_retrieve(int32_t device_id, void *hst_ptr, size_t size,
   return OFFLOAD_SUCCESS;
 }
 
+// Buffers larger than the partition size are split into several objects
+// '<name>.part<N>', which are transferred concurrently when threads are used.
+// 'done' is called once the whole buffer is transferred successfully.
+static int32_t transfer_partitions(
+    int32_t device_id, void *key, char *hst_ptr, size_t size,
+    std::string name, bool compressed,
+    int32_t (*transfer)(int32_t, void *, size_t, std::string, bool),
+    std::function<void()> done = nullptr) {
+  size_t partSize = DeviceInfo.SparkClusters[device_id].PartitionSize;
+  if (size <= partSize) {
+    int32_t rc = transfer(device_id, hst_ptr, size, name, compressed);
+    if (rc == OFFLOAD_SUCCESS && done)
+      done();
+    return rc;
+  }
+
+  bool useThreads = DeviceInfo.SparkClusters[device_id].UseThreads;
+  auto remaining =
+      std::make_shared<std::atomic<size_t>>((size + partSize - 1) / partSize);
+  int32_t rc = OFFLOAD_SUCCESS;
+  for (size_t n = 0; n * partSize < size; n++) {
+    char *part = hst_ptr + n * partSize;
+    size_t size_part = std::min(partSize, size - n * partSize);
+    std::string name_part = name + ".part" + std::to_string(n);
+
+    if (useThreads) {
+      DeviceInfo.TransferQueues[device_id]->push(key, size_part, [=]() {
+        int32_t rc =
+            transfer(device_id, part, size_part, name_part, compressed);
+        // A failed partition never completes the buffer
+        if (rc == OFFLOAD_SUCCESS && --*remaining == 0 && done)
+          done();
+        return rc;
+      });
+    } else if (transfer(device_id, part, size_part, name_part, compressed) !=
+               OFFLOAD_SUCCESS) {
+      rc = OFFLOAD_FAIL;
+    }
+  }
+  if (!useThreads && rc == OFFLOAD_SUCCESS && done)
+    done();
+  return rc;
+}
+
+typedef RTLDeviceInfoTy::AddrTableValTy AddrTableValTy;
+typedef RTLDeviceInfoTy::ResidentVersionTy ResidentVersionTy;
+
+static std::vector<uint64_t> hash_pages(const char *ptr, size_t size,
+                                        size_t pageSize) {
+  std::vector<uint64_t> hashes((size + pageSize - 1) / pageSize);
+  for (size_t i = 0; i < hashes.size(); i++)
+    hashes[i] = hash_buffer(ptr + i * pageSize,
+                            std::min(pageSize, size - i * pageSize), 0);
+  return hashes;
+}
+
+// Record the version of the host buffer now resident as the object 'name'
+static void record_resident_version(int32_t device_id, void *hst_ptr,
+                                    size_t size, uint64_t hash,
+                                    std::string name, bool compressed) {
+  size_t pageSize = DeviceInfo.SparkClusters[device_id].DeltaPageSize;
+  ResidentVersionTy version = {
+      size, pageSize, hash_pages(static_cast<char *>(hst_ptr), size, pageSize),
+      hash, name, compressed};
+
+  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  std::lock_guard<std::mutex> lock(timing.Delta_mutex);
+  DeviceInfo.ResidentVersions[device_id][hst_ptr] = version;
+}
+
+// Upload only the pages modified since the resident version of the buffer,
+// return false if a new version has to be uploaded as a whole.
+static bool send_delta(int32_t device_id, void *hst_ptr, size_t size,
+                       uint64_t hash, AddrTableValTy *entry, int32_t &rc) {
+  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  size_t pageSize = DeviceInfo.SparkClusters[device_id].DeltaPageSize;
+  const char *ptr = static_cast<char *>(hst_ptr);
+
+  ResidentVersionTy base;
+  {
+    std::lock_guard<std::mutex> lock(timing.Delta_mutex);
+    auto &versions = DeviceInfo.ResidentVersions[device_id];
+    auto it = versions.find(hst_ptr);
+    if (it == versions.end())
+      return false;
+    base = it->second;
+  }
+  if (base.Size != size || base.PageSize != pageSize)
+    return false;
+
+  // The resident version may have been overwritten since
+  {
+    std::lock_guard<std::mutex> lock(timing.DataCache_mutex);
+    auto &cache = DeviceInfo.UploadCaches[device_id];
+    auto it = cache.find(base.Hash);
+    if (it == cache.end() || it->second != base.Name)
+      return false;
+  }
+
+  std::vector<uint64_t> pages = hash_pages(ptr, size, pageSize);
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  size_t deltaSize = 0;
+  for (size_t i = 0; i < pages.size(); i++) {
+    if (pages[i] == base.PageHashes[i])
+      continue;
+    uint64_t offset = i * pageSize;
+    uint64_t length = std::min(pageSize, size - offset);
+    if (!ranges.empty() && ranges.back().first + ranges.back().second == offset)
+      ranges.back().second += length;
+    else
+      ranges.push_back(std::make_pair(offset, length));
+    deltaSize += length;
+  }
+
+  if (deltaSize > size * MAX_DELTA_RATIO)
+    return false;
+
+  uint32_t version = DELTA_VERSION;
+  uint64_t numRanges = ranges.size();
+  std::string delta(DELTA_MAGIC, sizeof(DELTA_MAGIC));
+  delta.append((const char *)&version, sizeof(version));
+  delta.append((const char *)&numRanges, sizeof(numRanges));
+  for (auto &range : ranges) {
+    delta.append((const char *)&range.first, sizeof(range.first));
+    delta.append((const char *)&range.second, sizeof(range.second));
+  }
+  for (auto &range : ranges)
+    delta.append(ptr + range.first, range.second);
+
+  std::string deltaName = "delta_" + hash_to_string(hash);
+  if (DeviceInfo.verbose != Verbosity::quiet)
+    DP("Sending %zu modified bytes of %s as %s\n", deltaSize, base.Name.c_str(),
+       deltaName.c_str());
+
+  // The base is read as it was uploaded
+  entry->InputName = base.Name;
+  entry->DeltaName = deltaName;
+  entry->Compressed = base.Compressed;
+  rc = send_object(device_id, &delta[0], delta.size(), deltaName, false);
+
+  timing.Delta_mutex.lock();
+  timing.DeltaUploads++;
+  timing.DeltaBytes += deltaSize;
+  timing.Delta_mutex.unlock();
+
+  return true;
+}
+
+// Upload an input named after its content. If the upload fails, the object
+// may be partially written and must not be referenced by later submissions.
+static int32_t send_cached_object(int32_t device_id, void *hst_ptr,
+                                  size_t size, std::string filename,
+                                  bool needCompression) {
+  int32_t rc = send_object(device_id, hst_ptr, size, filename, needCompression);
+  if (rc != OFFLOAD_SUCCESS)
+    record_upload_cache(device_id, nullptr,
+                        filename.substr(0, filename.find(".part")));
+  return rc;
+}
+
+static int32_t data_submit(int32_t device_id, void *hst_ptr, size_t size,
+                           int64_t id, bool needCompression,
+                           AddrTableValTy *entry) {
+  SparkInfo &spark = DeviceInfo.SparkClusters[device_id];
+  std::string filename = std::to_string(id);
+  entry->DeltaName.clear();
+
+  // Input objects are named after their content, so that identical data
+  // submitted again during the session are only referenced.
+  // Outputs of previous target regions retrieved unchanged on the host are
+  // also used as inputs directly.
+  if (spark.DataCache) {
+    uint64_t hash = hash_buffer(hst_ptr, size, needCompression);
+    bool delta = spark.DeltaUpload && size <= spark.PartitionSize;
+
+    if (lookup_upload_cache(device_id, hash, filename)) {
+      if (DeviceInfo.verbose != Verbosity::quiet)
+        DP("Data of %" PRId64 " already resident as %s\n", id,
+           filename.c_str());
+      entry->InputName = filename;
+      if (delta)
+        record_resident_version(device_id, hst_ptr, size, hash, filename,
+                                needCompression);
+      return OFFLOAD_SUCCESS;
+    }
+
+    int32_t rc;
+    if (delta && send_delta(device_id, hst_ptr, size, hash, entry, rc))
+      return rc;
+
+    // The object is recorded before its upload so that identical data
+    // submitted meanwhile are only referenced, it is forgotten if the upload
+    // fails.
+    filename = "data_" + hash_to_string(hash);
+    entry->InputName = filename;
+    record_upload_cache(device_id, &hash, filename);
+    if (delta)
+      record_resident_version(device_id, hst_ptr, size, hash, filename,
+                              needCompression);
+
+    return transfer_partitions(device_id, (void *)id,
+                               static_cast<char *>(hst_ptr), size, filename,
+                               needCompression, send_cached_object);
+  } else {
+    entry->InputName = filename;
+  }
+
+  return transfer_partitions(device_id, (void *)id,
+                             static_cast<char *>(hst_ptr), size, filename,
+                             needCompression, send_object);
+}
+
+static int32_t data_retrieve(int32_t device_id, void *hst_ptr, size_t size,
+                             int64_t id, bool needDecompression,
+                             std::string name, std::function<void()> done) {
+  return transfer_partitions(device_id, (void *)id,
+                             static_cast<char *>(hst_ptr), size, name,
+                             needDecompression, get_object, done);
+}
+
+// Human-readable address table, only meant for debugging
+static void
+write_text_address_table(std::string path,
+                         const std::vector<const AddrTableValTy *> &entries,
+                         const std::vector<std::string> &values,
+                         size_t partSize) {
+  std::ofstream ofs(path, std::ios_base::trunc);
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const AddrTableValTy &ArgInfo = *entries[i];
+    ofs << ArgInfo.TgtPtrAsInt << ";" << ArgInfo.Size << ";" << ArgInfo.Type
+        << ";" << ArgInfo.ScalaId << ";" << ArgInfo.Compressed << ";"
+        << ArgInfo.InputName << ";" << ArgInfo.DeltaName << ";"
+        << (size_t(ArgInfo.Size) > partSize ? partSize : 0) << ";";
+    if (values[i].empty()) {
+      ofs << "0";
+    } else {
+      for (unsigned char c : values[i])
+        ofs << std::hex << std::setw(2) << std::setfill('0') << int(c);
+      ofs << std::dec;
+    }
+    ofs << ";" << std::endl;
+  }
+}
+
+static void
+write_binary_address_table(std::string path,
+                           const std::vector<const AddrTableValTy *> &entries,
+                           const std::vector<std::string> &values,
+                           size_t partSize) {
+  std::vector<AddressTableRecord> records(entries.size());
+  std::string blob;
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const AddrTableValTy &ArgInfo = *entries[i];
+    AddressTableRecord &rec = records[i];
+    rec.TgtPtr = ArgInfo.TgtPtrAsInt;
+    rec.Size = ArgInfo.Size;
+    rec.Type = ArgInfo.Type;
+    rec.ScalaId = ArgInfo.ScalaId;
+    rec.Flags = ArgInfo.Compressed ? ADDRESS_TABLE_COMPRESSED : 0;
+    rec.NameOffset = blob.size();
+    rec.NameLength = ArgInfo.InputName.size();
+    blob += ArgInfo.InputName;
+    rec.ValueOffset = blob.size();
+    rec.ValueLength = values[i].size();
+    blob += values[i];
+    rec.PartitionSize = size_t(ArgInfo.Size) > partSize ? partSize : 0;
+    rec.DeltaOffset = blob.size();
+    rec.DeltaLength = ArgInfo.DeltaName.size();
+    blob += ArgInfo.DeltaName;
+  }
+
+  uint32_t version = ADDRESS_TABLE_VERSION;
+  uint32_t numRecords = records.size();
+  uint32_t recordSize = sizeof(AddressTableRecord);
+  uint64_t blobSize = blob.size();
+
+  std::ofstream ofs(path, std::ios_base::binary | std::ios_base::trunc);
+  ofs.write(ADDRESS_TABLE_MAGIC, sizeof(ADDRESS_TABLE_MAGIC));
+  ofs.write((const char *)&version, sizeof(version));
+  ofs.write((const char *)&numRecords, sizeof(numRecords));
+  ofs.write((const char *)&recordSize, sizeof(recordSize));
+  ofs.write((const char *)&blobSize, sizeof(blobSize));
+  ofs.write((const char *)records.data(), records.size() * recordSize);
+  ofs.write(blob.data(), blob.size());
+
+  if (!ofs) {
+    fprintf(stderr, "ERROR: Could not write address table %s\n",
+            path.c_str());
+    exit(EXIT_FAILURE);
+  }
+}
+
 int32_t __tgt_rtl_data_submit(int32_t device_id, void *tgt_ptr, void *hst_ptr,
                               int64_t size) {
   int64_t id = int64_t(tgt_ptr);
 
-  if (DeviceInfo.AddrTableMap.find(tgt_ptr) == DeviceInfo.AddrTableMap.end()) {
+  std::unique_lock<std::mutex> lock(DeviceInfo.AddrTable_mutex);
+  auto it = DeviceInfo.AddrTableMap.find(tgt_ptr);
+  if (it == DeviceInfo.AddrTableMap.end()) {
     DP("Arg not find in the address table\n");
     return OFFLOAD_FAIL;
   }
+  // The host data may differ from the last retrieved ones
+  it->second.Retrieved = false;
+  lock.unlock();
+
+  // The decision is recorded in the address table, so that the data are
+  // retrieved the same way and the Spark side does not re-derive it.
+  bool compressed = need_compression(device_id, hst_ptr, size_t(size));
+  it->second.Compressed = compressed;
+
+  // Elements of the address table are not moved by later insertions, the
+  // submitting thread can safely update the input names.
+  AddrTableValTy *entry = &it->second;
 
   if (DeviceInfo.SparkClusters[device_id].UseThreads) {
-    DeviceInfo.submitting_threads[device_id].push_back(
-        std::thread(data_submit, device_id, hst_ptr, size, id));
+    DeviceInfo.TransferQueues[device_id]->push(tgt_ptr, size_t(size), [=]() {
+      return data_submit(device_id, hst_ptr, size, id, compressed, entry);
+    });
   } else {
-    return data_submit(device_id, hst_ptr, size, id);
+    return data_submit(device_id, hst_ptr, size, id, compressed, entry);
   }
   return OFFLOAD_SUCCESS;
 }
@@ -705,24 +1293,111 @@ int32_t __tgt_rtl_data_retrieve(int32_t device_id, void *hst_ptr, void *tgt_ptr,
   int64_t id = (int64_t)tgt_ptr;
 
   if (DeviceInfo.SparkClusters[device_id].UseThreads) {
-    DeviceInfo.retrieving_threads[device_id].push_back(
-        std::thread(data_retrieve, device_id, hst_ptr, size, id));
+    // The data cannot be retrieved before their submission is over
+    if (DeviceInfo.TransferQueues[device_id]->wait(tgt_ptr) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+  }
+
+  std::unique_lock<std::mutex> lock(DeviceInfo.AddrTable_mutex);
+  auto it = DeviceInfo.AddrTableMap.find(tgt_ptr);
+  if (it == DeviceInfo.AddrTableMap.end()) {
+    DP("Arg not find in the address table\n");
+    return OFFLOAD_FAIL;
+  }
+  bool compressed = it->second.Compressed;
+
+  // The data are read from where they are resident, the submitted input if
+  // no target region wrote them
+  std::string name = it->second.InputName;
+  bool whole = hst_ptr == it->second.HstPtr && size == it->second.Size &&
+               DeviceInfo.SparkClusters[device_id].DataCache;
+  it->second.Retrieved = false;
+  lock.unlock();
+
+  // The content of the object is known as soon as the whole buffer is
+  // downloaded, before the host can modify it
+  std::function<void()> done = nullptr;
+  if (whole)
+    done = [=]() {
+      uint64_t hash = hash_buffer(hst_ptr, size_t(size), compressed);
+      std::lock_guard<std::mutex> lock(DeviceInfo.AddrTable_mutex);
+      auto it = DeviceInfo.AddrTableMap.find(tgt_ptr);
+      if (it != DeviceInfo.AddrTableMap.end() && it->second.InputName == name) {
+        it->second.Retrieved = true;
+        it->second.RetrievedHash = hash;
+      }
+    };
+
+  if (DeviceInfo.SparkClusters[device_id].UseThreads) {
+    DeviceInfo.TransferQueues[device_id]->push(tgt_ptr, size_t(size), [=]() {
+      return data_retrieve(device_id, hst_ptr, size_t(size), id, compressed,
+                           name, done);
+    });
   } else {
-    return data_retrieve(device_id, hst_ptr, size_t(size), id);
+    return data_retrieve(device_id, hst_ptr, size_t(size), id, compressed,
+                         name, done);
   }
 
   return OFFLOAD_SUCCESS;
 }
 
+int32_t __tgt_rtl_data_submit_batch(int32_t device_id, int32_t num_buffers,
+                                    void **tgt_ptrs, void **hst_ptrs,
+                                    int64_t *sizes) {
+  TransferQueue *queue = DeviceInfo.SparkClusters[device_id].UseThreads
+                             ? DeviceInfo.TransferQueues[device_id]
+                             : nullptr;
+  int32_t rc = OFFLOAD_SUCCESS;
+
+  // The whole batch is queued before its transfers start, so that the
+  // largest inputs of the region are uploaded first
+  if (queue)
+    queue->hold();
+  for (int32_t i = 0; i < num_buffers; i++)
+    if (__tgt_rtl_data_submit(device_id, tgt_ptrs[i], hst_ptrs[i], sizes[i]) !=
+        OFFLOAD_SUCCESS)
+      rc = OFFLOAD_FAIL;
+  if (queue)
+    queue->release();
+
+  return rc;
+}
+
+int32_t __tgt_rtl_data_retrieve_batch(int32_t device_id, int32_t num_buffers,
+                                      void **hst_ptrs, void **tgt_ptrs,
+                                      int64_t *sizes) {
+  // Retrievals wait for the submission of their buffer, they cannot be held
+  int32_t rc = OFFLOAD_SUCCESS;
+  for (int32_t i = 0; i < num_buffers; i++)
+    if (__tgt_rtl_data_retrieve(device_id, hst_ptrs[i], tgt_ptrs[i],
+                                sizes[i]) != OFFLOAD_SUCCESS)
+      rc = OFFLOAD_FAIL;
+  return rc;
+}
+
 int32_t __tgt_rtl_data_delete(int32_t device_id, void *tgt_ptr) {
   uintptr_t id = (uintptr_t)tgt_ptr;
   std::string filename = std::to_string(id);
-  // FIXME: Check retrieving thread is over before deleting data
+  int32_t rc = OFFLOAD_SUCCESS;
+
+  // The host buffer is only valid until the retrieval of the data is over
+  if (DeviceInfo.SparkClusters[device_id].UseThreads)
+    rc = DeviceInfo.TransferQueues[device_id]->wait(tgt_ptr);
+
+  // The cloud object is kept: if the host submits the retrieved data again
+  // without modifying them, it is used as input instead of a new upload.
+  std::lock_guard<std::mutex> lock(DeviceInfo.AddrTable_mutex);
+  auto it = DeviceInfo.AddrTableMap.find(tgt_ptr);
+  if (rc == OFFLOAD_SUCCESS && it != DeviceInfo.AddrTableMap.end() &&
+      it->second.Retrieved && DeviceInfo.SparkClusters[device_id].DataCache) {
+    const AddrTableValTy &entry = it->second;
+    record_upload_cache(device_id, &entry.RetrievedHash, entry.InputName);
+  }
   // return DeviceInfo.Providers[device_id]->delete_file(filename);
 
   DeviceInfo.AddrTableMap.erase(tgt_ptr);
 
-  return OFFLOAD_SUCCESS;
+  return rc;
 }
 
 int32_t __tgt_rtl_run_target_team_region(int32_t device_id, void *tgt_entry_ptr,
@@ -762,8 +1437,10 @@ int32_t __tgt_rtl_run_target_team_region(int32_t device_id, void *tgt_entry_ptr,
 
   void (*entry)(void);
   *((void **)&entry) = tgt_entry_ptr;
+  std::lock_guard<std::mutex> run_lock(DeviceInfo.Run_mutex);
   ffi_call(&cif, entry, nullptr, &args[0]);
 
+  std::unique_lock<std::mutex> lock(DeviceInfo.AddrTable_mutex);
   auto &AddrTableMap = DeviceInfo.AddrTableMap;
   auto AddrTablePath = DeviceInfo.AddressTables[device_id];
 
@@ -773,66 +1450,96 @@ int32_t __tgt_rtl_run_target_team_region(int32_t device_id, void *tgt_entry_ptr,
          "value (%ld)\n",
          tgt_sizes[i]);
       uintptr_t tgt_ptr_as_int = (uintptr_t)ptrs[i];
-      DeviceInfo.AddrTableMap[ptrs[i]] = {ptrs[i], tgt_ptr_as_int, tgt_sizes[i],
-                                          OMP_TGT_MAPTYPE_LITERAL, args_id[i]};
+      DeviceInfo.AddrTableMap[ptrs[i]] = {
+          ptrs[i],    tgt_ptr_as_int, tgt_sizes[i], OMP_TGT_MAPTYPE_LITERAL,
+          args_id[i], false,          std::to_string(tgt_ptr_as_int)};
     } else {
       AddrTableMap[ptrs[i]].ScalaId = args_id[i];
     }
   }
+  lock.unlock();
 
-  std::ofstream ofs(AddrTablePath, std::ios_base::app);
+  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  CloudProvider *provider = DeviceInfo.Providers[device_id];
 
-  for (uint32_t i = 0; i < arg_num; ++i) {
-    auto ArgInfo = AddrTableMap[ptrs[i]];
-    // Write entry in the address table
-    ofs << ArgInfo.TgtPtrAsInt << ";" << std::to_string(ArgInfo.Size) << ";"
-        << std::to_string(ArgInfo.Type) << ";"
-        << std::to_string(ArgInfo.ScalaId) << ";";
-    if (ArgInfo.Type & OMP_TGT_MAPTYPE_LITERAL) {
-      char *buf = (char *)&tgt_args[i];
-      for (int j = 0; j < ArgInfo.Size; j++) {
-        DP("ARG BY VALUE = %d \n", static_cast<int>(buf[j]));
-        ofs << std::hex << std::setw(2) << std::setfill('0')
-            << static_cast<int>(buf[j]);
-      }
-    } else
-      ofs << "0";
-    ofs << ";" << std::endl;
-    DP("%ld = %ld; %ld; %d;\n", ArgInfo.TgtPtrAsInt, ArgInfo.Size, ArgInfo.Type,
-       ArgInfo.ScalaId);
+  // The library is only sent again if its content changed
+  if (check_upload_cache(device_id, library_hash, "libmr.so")) {
+    if (DeviceInfo.verbose != Verbosity::quiet)
+      DP("Library already uploaded\n");
+  } else {
+    if (DeviceInfo.verbose != Verbosity::quiet)
+      DP("Send Library: %s --> %s\n", library_tmpfile,
+         provider->get_cloud_path("libmr.so").c_str());
+    if (provider->send_file(library_tmpfile, "libmr.so") != OFFLOAD_SUCCESS) {
+      DP("Failed to send the library\n");
+      record_upload_cache(device_id, nullptr, "libmr.so");
+      return OFFLOAD_FAIL;
+    }
+    if (DeviceInfo.verbose != Verbosity::quiet)
+      DP("Done!\n");
   }
-  ofs.close();
 
-  DP("address table written in %s\n", AddrTablePath.c_str());
+  // The input names are known once all the data are submitted. Pending
+  // retrievals are also waited for, so that the job cannot overwrite
+  // outputs which are still being downloaded.
+  if (DeviceInfo.SparkClusters[device_id].UseThreads) {
+    if (DeviceInfo.TransferQueues[device_id]->wait_all() != OFFLOAD_SUCCESS) {
+      DP("Data transfer failed\n");
+      return OFFLOAD_FAIL;
+    }
+  }
 
-  ElapsedTime &timing = DeviceInfo.ElapsedTimes[device_id];
+  lock.lock();
+  std::vector<const AddrTableValTy *> entries(arg_num);
+  std::vector<std::string> values(arg_num);
 
-  if (DeviceInfo.verbose != Verbosity::quiet)
-    DP("Send library and address table to the Spark driver\n");
+  for (int32_t i = 0; i < arg_num; ++i) {
+    entries[i] = &AddrTableMap[ptrs[i]];
+    // Literals are passed by value within the address table
+    if (entries[i]->Type & OMP_TGT_MAPTYPE_LITERAL)
+      values[i] = std::string((char *)&tgt_args[i], entries[i]->Size);
+    DP("%ld = %ld; %ld; %d; %d; %s;\n", entries[i]->TgtPtrAsInt,
+       entries[i]->Size, entries[i]->Type, entries[i]->ScalaId,
+       entries[i]->Compressed, entries[i]->InputName.c_str());
+  }
 
-  DeviceInfo.Providers[device_id]->send_file(AddrTablePath.c_str(),
-                                             "addressTable");
+  size_t partSize = DeviceInfo.SparkClusters[device_id].PartitionSize;
+  if (DeviceInfo.SparkClusters[device_id].TextAddressTable)
+    write_text_address_table(AddrTablePath, entries, values, partSize);
+  else
+    write_binary_address_table(AddrTablePath, entries, values, partSize);
+
+  DP("address table written in %s\n", AddrTablePath.c_str());
 
   if (DeviceInfo.verbose != Verbosity::quiet)
-    DP("Send Library: %s --> %s\n", library_tmpfile,
-       DeviceInfo.Providers[device_id]->get_cloud_path("libmr.so").c_str());
-  DeviceInfo.Providers[device_id]->send_file(library_tmpfile, "libmr.so");
-  if (DeviceInfo.verbose != Verbosity::quiet)
-    DP("Done!\n");
+    DP("Send address table to the Spark driver\n");
+
+  provider->send_file(AddrTablePath.c_str(), "addressTable");
 
   if (!DeviceInfo.SparkClusters[device_id].KeepTmpFiles)
     remove(AddrTablePath.c_str());
 
-  if (DeviceInfo.SparkClusters[device_id].UseThreads) {
-    for (auto it = DeviceInfo.submitting_threads[device_id].begin();
-         it != DeviceInfo.submitting_threads[device_id].end(); it++) {
-      (*it).join();
-    }
-    DeviceInfo.submitting_threads[device_id].clear();
+  // Outputs stay resident in the cloud storage: they are retrieved only if
+  // the host asks for them, and are the inputs of the next target regions.
+  for (int32_t i = 0; i < arg_num; ++i) {
+    AddrTableValTy &ArgInfo = AddrTableMap[ptrs[i]];
+    if (!(ArgInfo.Type & OMP_TGT_MAPTYPE_FROM) ||
+        (ArgInfo.Type & OMP_TGT_MAPTYPE_LITERAL))
+      continue;
+    std::string outputName = std::to_string(ArgInfo.TgtPtrAsInt);
+    record_upload_cache(device_id, nullptr, outputName);
+    ArgInfo.InputName = outputName;
+    ArgInfo.DeltaName.clear();
+    ArgInfo.Retrieved = false;
   }
+  lock.unlock();
 
   auto t_start = std::chrono::high_resolution_clock::now();
-  int32_t ret_val = DeviceInfo.Providers[device_id]->submit_job();
+  int32_t ret_val;
+  if (DeviceInfo.Drivers[device_id])
+    ret_val = DeviceInfo.Drivers[device_id]->run_kernel();
+  else
+    ret_val = provider->submit_job();
   auto t_end = std::chrono::high_resolution_clock::now();
   auto t_delay =
       std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
@@ -2,6 +2,7 @@
 #define _INCLUDE_RTL_H
 
 #include <assert.h>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
@@ -31,7 +32,17 @@ struct SparkInfo {
   std::string WorkingDir;
   bool Compression;
   std::string CompressionFormat;
+  size_t CompressionBlockSize;
+  bool AdaptiveCompression;
+  double UplinkBandwidth;
+  bool DataCache;
+  size_t PartitionSize;
+  bool DeltaUpload;
+  size_t DeltaPageSize;
   bool UseThreads;
+  bool TextAddressTable;
+  bool PersistentDriver;
+  std::string DriverCommand;
   Verbosity VerboseMode;
   bool KeepTmpFiles;
   std::string SchedulingSize;
@@ -55,6 +66,20 @@ struct ElapsedTime {
   int DownloadTime = 0;
   std::mutex DownloadTime_mutex;
   int SparkExecutionTime = 0;
+  // Uncompressed uploads, used to measure the uplink bandwidth
+  size_t UploadedBytes = 0;
+  double UploadSeconds = 0;
+  std::mutex Bandwidth_mutex;
+  // Uploads avoided thanks to the content-addressed cache, the mutex also
+  // protects the cache itself
+  int CacheHits = 0;
+  int CacheMisses = 0;
+  std::mutex DataCache_mutex;
+  // Uploads reduced to the modified pages, the mutex also protects the page
+  // hashes of the resident versions
+  int DeltaUploads = 0;
+  size_t DeltaBytes = 0;
+  std::mutex Delta_mutex;
 };
 
 const std::string OMPCLOUD_CONF_ENV = "OMPCLOUD_CONF_PATH";
@@ -62,6 +87,8 @@ const int DEFAULT_SPARK_PORT = 7077;
 const std::string DEFAULT_SPARK_USER = "anonymous";
 const std::string DEFAULT_SPARK_MODE = "client";
 const std::string DEFAULT_SPARK_PACKAGE = "org.llvm.openmp.OmpKernel";
+// Spark class keeping a driver alive between target regions
+const std::string DRIVER_SPARK_PACKAGE = "org.llvm.openmp.PersistentDriver";
 const std::string DEFAULT_SPARK_JARPATH =
     "target/scala-2.11/test-assembly-0.2.0.jar";
 
@@ -69,9 +96,56 @@ const std::string DEFAULT_SPARK_JARPATH =
 const int MIN_SIZE_COMPRESSION = 1000000;
 const std::string DEFAULT_COMPRESSION_FORMAT = "gzip";
 
-// Maximal size of offloaded data is about 2GB
-// Size of JVM's ByteArrays are limited by MAX_JAVA_INT = 2^31-1
+// Uplink bandwidth (in MB/s) assumed until some uploads have been measured
+const double DEFAULT_UPLINK_BANDWIDTH = 100;
+// Minimal upload duration (in seconds) for the bandwidth measure to be used
+const double MIN_BANDWIDTH_MEASURE_TIME = 1;
+// Data whose estimated compression ratio is higher are sent uncompressed
+const double MAX_COMPRESSION_RATIO = 0.9;
+
+// Number of concurrent transfers per device, unless configured by provider
+const int DEFAULT_MAX_TRANSFERS = 4;
+
+// Binary address table shared with the Spark kernel: a header (magic,
+// version, number of records, size of a record, size of the blob), followed
+// by fixed-width records and a blob holding the input names and the values of
+// the literals. Integers are stored in little-endian order.
+const char ADDRESS_TABLE_MAGIC[4] = {'O', 'M', 'P', 'T'};
+const uint32_t ADDRESS_TABLE_VERSION = 3;
+const uint32_t ADDRESS_TABLE_COMPRESSED = 0x1;
+
+struct AddressTableRecord {
+  uint64_t TgtPtr;
+  int64_t Size;
+  int64_t Type;
+  int32_t ScalaId;
+  uint32_t Flags;
+  // Offsets are relative to the beginning of the blob
+  uint32_t NameOffset;
+  uint32_t NameLength;
+  uint32_t ValueOffset;
+  uint32_t ValueLength;
+  // Size of the partition objects, 0 if the data are stored in one object
+  uint64_t PartitionSize;
+  // Name of the delta object to apply on the input, empty if none
+  uint32_t DeltaOffset;
+  uint32_t DeltaLength;
+};
+static_assert(sizeof(AddressTableRecord) == 64,
+              "Address table records must match the Spark side");
+
+// Delta object patching a resident input: a header (magic, version, number
+// of ranges), the ranges (offset and length, 64-bit each) and then the data of
+// the ranges. Integers are stored in little-endian order.
+const char DELTA_MAGIC[4] = {'O', 'M', 'P', 'D'};
+const uint32_t DELTA_VERSION = 1;
+const size_t DEFAULT_DELTA_PAGE_SIZE = 64 * 1024;
+// A new version of the whole buffer is uploaded if more data changed
+const double MAX_DELTA_RATIO = 0.5;
+
+// Size of JVM's ByteArrays are limited by MAX_JAVA_INT = 2^31-1, larger data
+// are split into several objects
 const long MAX_JAVA_INT = 2147483647;
-const double MAX_SIZE_IN_MB = MAX_JAVA_INT / (1024 * 1024);
+const size_t DEFAULT_PARTITION_SIZE = 1 << 30;
 
 #endif
@@ -11,14 +11,31 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <string>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include <zlib.h>
+#ifdef OMPCLOUD_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef OMPCLOUD_HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "cloud_compression.h"
+#include "omptarget.h"
+#include "provider.h"
 
 size_t decompress_file(std::string comp_file, char *ptr_buff_out,
                        size_t buff_size) {
@@ -41,3 +58,393 @@ size_t compress_to_file(std::string comp_file, char *ptr_buff_in,
   gzclose(out);
   return size_t(len);
 }
+
+size_t compress_to_writer(CloudWriter *writer, const char *ptr_buff_in,
+                          size_t buff_size) {
+  z_stream strm;
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+
+  // Adding 16 to the window bits produces a gzip header, as with gzwrite
+  if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    fprintf(stderr, "Failed to compress: %s", strm.msg);
+    return 0;
+  }
+
+  std::vector<unsigned char> out(STREAM_CHUNK_SIZE);
+  size_t comp_size = 0;
+  size_t offset = 0;
+  int flush;
+
+  do {
+    // avail_in is 32-bit, feed the input by chunks
+    size_t chunk_size = std::min(STREAM_CHUNK_SIZE, buff_size - offset);
+    strm.next_in = (Bytef *)(ptr_buff_in + offset);
+    strm.avail_in = uInt(chunk_size);
+    offset += chunk_size;
+    flush = (offset == buff_size) ? Z_FINISH : Z_NO_FLUSH;
+
+    do {
+      strm.next_out = out.data();
+      strm.avail_out = uInt(out.size());
+      deflate(&strm, flush);
+      size_t have = out.size() - strm.avail_out;
+      if (have > 0 && writer->write(out.data(), have) != OFFLOAD_SUCCESS) {
+        deflateEnd(&strm);
+        return 0;
+      }
+      comp_size += have;
+    } while (strm.avail_out == 0);
+  } while (flush != Z_FINISH);
+
+  deflateEnd(&strm);
+  return comp_size;
+}
+
+bool parse_compression_format(std::string format, size_t block_size,
+                              CompressionScheme &scheme) {
+  scheme.Block = true;
+  scheme.Level = -1;
+  scheme.BlockSize = block_size ? block_size : DEFAULT_COMPRESSION_BLOCK_SIZE;
+
+  if (format == "gzip") {
+    scheme.Block = false;
+    scheme.Codec = CODEC_DEFLATE;
+    return true;
+  }
+
+  std::string codec = format;
+  size_t sep = format.find(':');
+  if (sep != std::string::npos) {
+    codec = format.substr(0, sep);
+    scheme.Level = std::atoi(format.substr(sep + 1).c_str());
+  }
+
+  if (codec == "deflate") {
+    scheme.Codec = CODEC_DEFLATE;
+    return true;
+  }
+#ifdef OMPCLOUD_HAVE_LZ4
+  if (codec == "lz4") {
+    scheme.Codec = CODEC_LZ4;
+    return true;
+  }
+#endif
+#ifdef OMPCLOUD_HAVE_ZSTD
+  if (codec == "zstd") {
+    scheme.Codec = CODEC_ZSTD;
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+// Number of blocks (de)compressed at the same time, which also bounds the
+// number of blocks held in memory
+static size_t compression_wave_size() {
+  return size_t(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Run fn(0..n-1) over the cores of the host
+static void parallel_for(size_t n, std::function<void(size_t)> fn) {
+  size_t nthreads = std::min(n, compression_wave_size());
+  std::atomic<size_t> next(0);
+
+  auto worker = [&]() {
+    for (size_t i = next++; i < n; i = next++)
+      fn(i);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < nthreads; t++)
+    threads.push_back(std::thread(worker));
+  worker();
+  for (auto &t : threads)
+    t.join();
+}
+
+// Compress one block, return the compressed size or 0 if the block does not
+// fit in the output buffer.
+static size_t compress_block(const CompressionScheme &scheme, const char *in,
+                             size_t in_size, char *out, size_t out_size) {
+  switch (scheme.Codec) {
+  case CODEC_DEFLATE: {
+    uLongf len = uLongf(out_size);
+    int level = scheme.Level < 0 ? Z_DEFAULT_COMPRESSION : scheme.Level;
+    if (compress2((Bytef *)out, &len, (const Bytef *)in, uLong(in_size),
+                  level) != Z_OK)
+      return 0;
+    return size_t(len);
+  }
+#ifdef OMPCLOUD_HAVE_LZ4
+  case CODEC_LZ4: {
+    int len;
+    // Levels above 1 select the high compression variant
+    if (scheme.Level > 1)
+      len = LZ4_compress_HC(in, out, int(in_size), int(out_size), scheme.Level);
+    else
+      len = LZ4_compress_default(in, out, int(in_size), int(out_size));
+    return len > 0 ? size_t(len) : 0;
+  }
+#endif
+#ifdef OMPCLOUD_HAVE_ZSTD
+  case CODEC_ZSTD: {
+    int level = scheme.Level < 0 ? ZSTD_CLEVEL_DEFAULT : scheme.Level;
+    size_t len = ZSTD_compress(out, out_size, in, in_size, level);
+    return ZSTD_isError(len) ? 0 : len;
+  }
+#endif
+  default:
+    return 0;
+  }
+}
+
+static size_t compress_bound(BlockCodec codec, size_t size) {
+  switch (codec) {
+#ifdef OMPCLOUD_HAVE_LZ4
+  case CODEC_LZ4:
+    return size_t(LZ4_compressBound(int(size)));
+#endif
+#ifdef OMPCLOUD_HAVE_ZSTD
+  case CODEC_ZSTD:
+    return ZSTD_compressBound(size);
+#endif
+  default:
+    return size_t(compressBound(uLong(size)));
+  }
+}
+
+static bool decompress_block(BlockCodec codec, const char *in, size_t in_size,
+                             char *out, size_t out_size) {
+  // Incompressible blocks are stored as is
+  if (in_size == out_size) {
+    memcpy(out, in, out_size);
+    return true;
+  }
+
+  switch (codec) {
+  case CODEC_DEFLATE: {
+    uLongf len = uLongf(out_size);
+    return uncompress((Bytef *)out, &len, (const Bytef *)in, uLong(in_size)) ==
+               Z_OK &&
+           len == out_size;
+  }
+#ifdef OMPCLOUD_HAVE_LZ4
+  case CODEC_LZ4:
+    return LZ4_decompress_safe(in, out, int(in_size), int(out_size)) ==
+           int(out_size);
+#endif
+#ifdef OMPCLOUD_HAVE_ZSTD
+  case CODEC_ZSTD:
+    return ZSTD_decompress(out, out_size, in, in_size) == out_size;
+#endif
+  default:
+    fprintf(stderr, "Unsupported block compression codec %u\n", codec);
+    return false;
+  }
+}
+
+size_t block_compress_to_writer(CloudWriter *writer, const char *ptr_buff_in,
+                                size_t buff_size,
+                                const CompressionScheme &scheme) {
+  size_t block_size = scheme.BlockSize;
+  uint32_t num_blocks = uint32_t((buff_size + block_size - 1) / block_size);
+
+  uint32_t header[4] = {0, BLOCK_COMPRESSION_VERSION, scheme.Codec,
+                        num_blocks};
+  memcpy(&header[0], BLOCK_COMPRESSION_MAGIC, sizeof(header[0]));
+  uint64_t sizes[2] = {block_size, buff_size};
+
+  if (writer->write(header, sizeof(header)) != OFFLOAD_SUCCESS ||
+      writer->write(sizes, sizeof(sizes)) != OFFLOAD_SUCCESS)
+    return 0;
+  size_t comp_size = sizeof(header) + sizeof(sizes);
+
+  // Blocks are compressed and written by waves, so that only a few of them
+  // are kept in memory whatever the size of the buffer.
+  size_t wave_size = std::min(size_t(num_blocks), compression_wave_size());
+  std::vector<std::vector<char>> blocks(wave_size);
+  std::vector<uint64_t> comp_sizes(num_blocks);
+
+  for (size_t first = 0; first < num_blocks; first += wave_size) {
+    size_t count = std::min(wave_size, num_blocks - first);
+
+    parallel_for(count, [&](size_t j) {
+      size_t i = first + j;
+      const char *in = ptr_buff_in + i * block_size;
+      size_t in_size = std::min(block_size, buff_size - i * block_size);
+
+      std::vector<char> &out = blocks[j];
+      out.resize(compress_bound(scheme.Codec, in_size));
+      size_t len = compress_block(scheme, in, in_size, out.data(), out.size());
+
+      if (len == 0 || len >= in_size) {
+        out.assign(in, in + in_size);
+        len = in_size;
+      }
+      out.resize(len);
+      comp_sizes[i] = len;
+    });
+
+    for (size_t j = 0; j < count; j++) {
+      if (writer->write_chunked(blocks[j].data(), blocks[j].size()) !=
+          OFFLOAD_SUCCESS)
+        return 0;
+      comp_size += blocks[j].size();
+    }
+  }
+
+  if (writer->write(comp_sizes.data(), num_blocks * sizeof(uint64_t)) !=
+      OFFLOAD_SUCCESS)
+    return 0;
+
+  return comp_size + num_blocks * sizeof(uint64_t);
+}
+
+size_t block_compress_to_file(std::string comp_file, const char *ptr_buff_in,
+                              size_t buff_size,
+                              const CompressionScheme &scheme) {
+  FILE *file = fopen(comp_file.c_str(), "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "Failed to compress: cannot open %s\n", comp_file.c_str());
+    return 0;
+  }
+
+  FileWriter writer(file, comp_file);
+  size_t comp_size =
+      block_compress_to_writer(&writer, ptr_buff_in, buff_size, scheme);
+  if (writer.close() != OFFLOAD_SUCCESS)
+    return 0;
+  return comp_size;
+}
+
+size_t block_decompress_file(std::string comp_file, char *ptr_buff_out,
+                             size_t buff_size) {
+  std::ifstream in(comp_file, std::ios::in | std::ios::binary);
+  in.seekg(0, std::ios::end);
+  size_t file_size = in.good() ? size_t(in.tellg()) : 0;
+  in.seekg(0, std::ios::beg);
+
+  uint32_t header[4];
+  uint64_t sizes[2];
+  if (file_size < sizeof(header) + sizeof(sizes) ||
+      !in.read((char *)header, sizeof(header)) ||
+      !in.read((char *)sizes, sizeof(sizes))) {
+    fprintf(stderr, "Failed to decompress: truncated file %s\n",
+            comp_file.c_str());
+    return 0;
+  }
+
+  uint32_t version = header[1];
+  uint32_t num_blocks = header[3];
+  uint64_t block_size = sizes[0];
+  uint64_t raw_size = sizes[1];
+  size_t header_size = sizeof(header) + sizeof(sizes);
+  size_t index_size = num_blocks * sizeof(uint64_t);
+
+  if (memcmp(&header[0], BLOCK_COMPRESSION_MAGIC, sizeof(header[0])) ||
+      version != BLOCK_COMPRESSION_VERSION ||
+      raw_size != buff_size || file_size < header_size + index_size) {
+    fprintf(stderr, "Failed to decompress: invalid block header in %s\n",
+            comp_file.c_str());
+    return 0;
+  }
+
+  // Read the index first, it follows the blocks
+  size_t index_offset = file_size - index_size;
+  std::vector<uint64_t> comp_sizes(num_blocks);
+  in.seekg(index_offset, std::ios::beg);
+  if (!in.read((char *)comp_sizes.data(), index_size)) {
+    fprintf(stderr, "Failed to decompress: truncated file %s\n",
+            comp_file.c_str());
+    return 0;
+  }
+
+  // Compute the offset of each block from the index
+  std::vector<size_t> offsets(num_blocks + 1);
+  size_t offset = header_size;
+  for (uint32_t i = 0; i < num_blocks; i++) {
+    offsets[i] = offset;
+    offset += comp_sizes[i];
+  }
+  offsets[num_blocks] = offset;
+  if (offset > file_size) {
+    fprintf(stderr, "Failed to decompress: truncated file %s\n",
+            comp_file.c_str());
+    return 0;
+  }
+
+  // Blocks are read and decompressed by waves, so that only a few of them are
+  // kept in memory whatever the size of the buffer.
+  size_t wave_size = std::min(size_t(num_blocks), compression_wave_size());
+  std::vector<char> data;
+  std::atomic<bool> success(true);
+
+  for (size_t first = 0; first < num_blocks && success; first += wave_size) {
+    size_t count = std::min(wave_size, num_blocks - first);
+    size_t wave_offset = offsets[first];
+
+    data.resize(offsets[first + count] - wave_offset);
+    in.seekg(wave_offset, std::ios::beg);
+    if (!in.read(data.data(), data.size())) {
+      fprintf(stderr, "Failed to decompress: truncated file %s\n",
+              comp_file.c_str());
+      return 0;
+    }
+
+    parallel_for(count, [&](size_t j) {
+      size_t i = first + j;
+      size_t out_size = std::min(block_size, raw_size - i * block_size);
+      if (!decompress_block(BlockCodec(header[2]),
+                            data.data() + offsets[i] - wave_offset,
+                            comp_sizes[i], ptr_buff_out + i * block_size,
+                            out_size))
+        success = false;
+    });
+  }
+
+  if (!success) {
+    fprintf(stderr, "Failed to decompress: corrupted block in %s\n",
+            comp_file.c_str());
+    return 0;
+  }
+
+  return raw_size;
+}
+
+CompressibilityEstimate
+estimate_compressibility(const char *ptr_buff_in, size_t buff_size,
+                         const CompressionScheme &scheme) {
+  size_t sample_size = std::min(COMPRESSION_SAMPLE_SIZE, buff_size);
+  std::vector<char> out(compress_bound(scheme.Codec, sample_size));
+  size_t raw_total = 0;
+  size_t comp_total = 0;
+
+  auto t_start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < COMPRESSION_SAMPLE_COUNT; i++) {
+    // Samples are evenly spread over the buffer
+    size_t offset =
+        (buff_size - sample_size) / COMPRESSION_SAMPLE_COUNT * size_t(i);
+    size_t len = compress_block(scheme, ptr_buff_in + offset, sample_size,
+                                out.data(), out.size());
+    raw_total += sample_size;
+    comp_total += (len == 0) ? sample_size : len;
+  }
+  auto t_end = std::chrono::high_resolution_clock::now();
+  double seconds = std::chrono::duration<double>(t_end - t_start).count();
+
+  CompressibilityEstimate estimate;
+  estimate.Ratio = raw_total ? double(comp_total) / double(raw_total) : 1.0;
+  estimate.Throughput = double(raw_total) / std::max(seconds, 1e-9);
+
+  if (scheme.Block) {
+    size_t num_blocks = (buff_size + scheme.BlockSize - 1) / scheme.BlockSize;
+    estimate.Throughput *= double(std::min(
+        num_blocks, size_t(std::max(1u, std::thread::hardware_concurrency()))));
+  }
+
+  return estimate;
+}
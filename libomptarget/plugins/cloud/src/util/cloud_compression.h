@@ -14,11 +14,87 @@
 #ifndef _INCLUDE_COMPRESSION_H_
 #define _INCLUDE_COMPRESSION_H_
 
+#include <cstdint>
+#include <string>
+
 size_t decompress_file(std::string comp_file, char *ptr_buff_out,
                        size_t buff_size);
 
 size_t compress_to_file(std::string comp_file, char *ptr_buff_out,
                         size_t buff_size);
 
+class CloudWriter;
+
+// Compress the buffer in gzip format and push it chunk by chunk to the writer.
+// Return the compressed size or 0 on failure.
+size_t compress_to_writer(CloudWriter *writer, const char *ptr_buff_in,
+                          size_t buff_size);
+
+// Block compression format: the buffer is split into fixed-size blocks which
+// are compressed independently, so that both the plugin and the Spark
+// executors can (de)compress them in parallel. Integers are little-endian.
+//
+//   char     magic[4] = "OMPB"
+//   uint32_t version
+//   uint32_t codec
+//   uint32_t number of blocks
+//   uint64_t block size (raw)
+//   uint64_t total size (raw)
+//   blocks...
+//   uint64_t compressed size of each block
+//
+// The index of the compressed sizes comes last so that the blocks can be
+// written as soon as they are compressed. Only BLOCK_COMPRESSION_VERSION is
+// read back.
+//
+// A block whose compressed size equals its raw size is stored uncompressed.
+const char BLOCK_COMPRESSION_MAGIC[4] = {'O', 'M', 'P', 'B'};
+const uint32_t BLOCK_COMPRESSION_VERSION = 2;
+const size_t DEFAULT_COMPRESSION_BLOCK_SIZE = 4 * 1024 * 1024;
+
+enum BlockCodec : uint32_t { CODEC_DEFLATE = 1, CODEC_LZ4 = 2, CODEC_ZSTD = 3 };
+
+struct CompressionScheme {
+  // False for the legacy single gzip stream
+  bool Block;
+  BlockCodec Codec;
+  // Codec specific level, -1 for the default one
+  int Level;
+  size_t BlockSize;
+};
+
+// Parse the CompressionFormat option: "gzip" for the legacy format, or
+// "deflate", "lz4", "zstd" with an optional ":<level>" suffix for the block
+// format. Return false if the format is unknown or not compiled in.
+bool parse_compression_format(std::string format, size_t block_size,
+                              CompressionScheme &scheme);
+
+size_t block_compress_to_writer(CloudWriter *writer, const char *ptr_buff_in,
+                                size_t buff_size,
+                                const CompressionScheme &scheme);
+
+size_t block_compress_to_file(std::string comp_file, const char *ptr_buff_in,
+                              size_t buff_size,
+                              const CompressionScheme &scheme);
+
+size_t block_decompress_file(std::string comp_file, char *ptr_buff_out,
+                             size_t buff_size);
+
+// Number and size of the chunks sampled to estimate compressibility
+const int COMPRESSION_SAMPLE_COUNT = 4;
+const size_t COMPRESSION_SAMPLE_SIZE = 64 * 1024;
+
+struct CompressibilityEstimate {
+  // Compressed size over raw size of the samples
+  double Ratio;
+  // Compression throughput in bytes per second, accounting for the blocks
+  // compressed in parallel
+  double Throughput;
+};
+
+// Compress a few chunks sampled across the buffer with the given scheme.
+CompressibilityEstimate
+estimate_compressibility(const char *ptr_buff_in, size_t buff_size,
+                         const CompressionScheme &scheme);
 
 #endif
@@ -0,0 +1,170 @@
+//===-------------------- Target RTLs Implementation -------------- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Control channel of a persistent Spark driver
+//
+//===----------------------------------------------------------------------===//
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cloud_driver.h"
+#include "omptarget.h"
+
+int32_t DriverChannel::start(const std::string &command) {
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    perror("ERROR: Cannot create driver socket");
+    return OFFLOAD_FAIL;
+  }
+
+  // Let the system choose a free port on the loopback interface
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t addrlen = sizeof(addr);
+
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listen_fd, 1) < 0 ||
+      getsockname(listen_fd, (struct sockaddr *)&addr, &addrlen) < 0) {
+    perror("ERROR: Cannot listen on driver socket");
+    return OFFLOAD_FAIL;
+  }
+  std::string port = std::to_string(ntohs(addr.sin_port));
+
+  if (verbose)
+    fprintf(stdout, "Starting persistent driver (port %s): %s\n", port.c_str(),
+            command.c_str());
+
+  pid = fork();
+  if (pid < 0) {
+    perror("ERROR: Cannot start the driver");
+    return OFFLOAD_FAIL;
+  }
+  if (pid == 0) {
+    close(listen_fd);
+    setenv(OMPCLOUD_DRIVER_PORT_ENV, port.c_str(), 1);
+    execl("/bin/sh", "sh", "-c", command.c_str(), (char *)nullptr);
+    _exit(127);
+  }
+
+  // Wait for the driver to connect, as long as it is alive
+  struct pollfd pfd = {listen_fd, POLLIN, 0};
+  while (true) {
+    int rc = poll(&pfd, 1, 1000);
+    if (rc > 0)
+      break;
+    if (rc < 0 && errno != EINTR) {
+      perror("ERROR: Waiting for the driver failed");
+      return OFFLOAD_FAIL;
+    }
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == pid) {
+      fprintf(stderr, "ERROR: The driver exited before connecting\n");
+      pid = -1;
+      return OFFLOAD_FAIL;
+    }
+  }
+
+  conn_fd = accept(listen_fd, nullptr, nullptr);
+  if (conn_fd < 0) {
+    perror("ERROR: Cannot accept the driver connection");
+    return OFFLOAD_FAIL;
+  }
+
+  std::string line;
+  if (recv_line(line) != OFFLOAD_SUCCESS || line != "READY") {
+    fprintf(stderr, "ERROR: Unexpected answer of the driver: '%s'\n",
+            line.c_str());
+    return OFFLOAD_FAIL;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t DriverChannel::run_kernel() {
+  if (conn_fd < 0)
+    return OFFLOAD_FAIL;
+
+  if (send_line("RUN " + std::to_string(kernel_count++)) != OFFLOAD_SUCCESS)
+    return OFFLOAD_FAIL;
+
+  std::string line;
+  if (recv_line(line) != OFFLOAD_SUCCESS) {
+    fprintf(stderr, "ERROR: Lost connection with the driver\n");
+    return OFFLOAD_FAIL;
+  }
+  if (line != "DONE") {
+    fprintf(stderr, "ERROR: Kernel execution failed: %s\n", line.c_str());
+    return OFFLOAD_FAIL;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+void DriverChannel::stop() {
+  if (conn_fd >= 0) {
+    send_line("EXIT");
+    close(conn_fd);
+    conn_fd = -1;
+  }
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    listen_fd = -1;
+  }
+  if (pid > 0) {
+    int status;
+    waitpid(pid, &status, 0);
+    pid = -1;
+  }
+}
+
+int32_t DriverChannel::send_line(const std::string &line) {
+  std::string msg = line + "\n";
+  size_t sent = 0;
+
+  while (sent < msg.size()) {
+    ssize_t n = send(conn_fd, msg.data() + sent, msg.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return OFFLOAD_FAIL;
+    }
+    sent += n;
+  }
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t DriverChannel::recv_line(std::string &line) {
+  line.clear();
+
+  while (true) {
+    char c;
+    ssize_t n = recv(conn_fd, &c, 1, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return OFFLOAD_FAIL;
+    if (c == '\n')
+      break;
+    line += c;
+  }
+  return OFFLOAD_SUCCESS;
+}
@@ -0,0 +1,54 @@
+//===-------- cloud_driver.h ----- - Information ----- C++ -*--------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Control channel of a persistent Spark driver
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _INCLUDE_DRIVER_H_
+#define _INCLUDE_DRIVER_H_
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+// Environment variable giving the driver the port of the control channel
+#define OMPCLOUD_DRIVER_PORT_ENV "OMPCLOUD_DRIVER_PORT"
+
+// The driver is started once and then receives the kernels to execute
+// through a TCP connection on the loopback interface. The protocol is made of
+// text lines:
+//   driver -> plugin: "READY" once the Spark session is created
+//   plugin -> driver: "RUN <n>" to execute the n-th kernel of the session
+//   driver -> plugin: "DONE" or "FAIL <message>" once the kernel is over
+//   plugin -> driver: "EXIT" to stop the driver
+class DriverChannel {
+  int listen_fd = -1;
+  int conn_fd = -1;
+  pid_t pid = -1;
+  uint64_t kernel_count = 0;
+  bool verbose;
+
+  int32_t send_line(const std::string &line);
+  int32_t recv_line(std::string &line);
+
+public:
+  DriverChannel(bool verbose) : verbose(verbose) {}
+  ~DriverChannel() { stop(); }
+
+  // Launch the command in background and wait for the driver to be ready
+  int32_t start(const std::string &command);
+
+  // Execute one kernel and wait for its completion
+  int32_t run_kernel();
+
+  void stop();
+};
+
+#endif
@@ -0,0 +1,112 @@
+//===-------------------- Target RTLs Implementation -------------- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Bounded pool of workers executing data transfers
+//
+//===----------------------------------------------------------------------===//
+
+#include "cloud_queue.h"
+#include "omptarget.h"
+
+TransferQueue::TransferQueue(unsigned num_workers) {
+  if (num_workers == 0)
+    num_workers = 1;
+  for (unsigned i = 0; i < num_workers; i++)
+    Workers.push_back(std::thread(&TransferQueue::worker, this));
+}
+
+TransferQueue::~TransferQueue() {
+  wait_all();
+  {
+    std::lock_guard<std::mutex> lock(Mtx);
+    Stopping = true;
+  }
+  WorkCv.notify_all();
+  for (auto &t : Workers)
+    t.join();
+}
+
+void TransferQueue::hold() {
+  std::lock_guard<std::mutex> lock(Mtx);
+  Held++;
+}
+
+void TransferQueue::release() {
+  {
+    std::lock_guard<std::mutex> lock(Mtx);
+    Held--;
+  }
+  WorkCv.notify_all();
+}
+
+void TransferQueue::worker() {
+  std::unique_lock<std::mutex> lock(Mtx);
+
+  while (true) {
+    WorkCv.wait(lock,
+                [this] { return Stopping || (!Pending.empty() && !Held); });
+    if (Pending.empty())
+      return;
+
+    TransferTy transfer = Pending.top();
+    Pending.pop();
+
+    lock.unlock();
+    int32_t rc = transfer.Fn();
+    lock.lock();
+
+    if (rc != OFFLOAD_SUCCESS)
+      FailedKeys.insert(transfer.Key);
+    if (--InFlight[transfer.Key] == 0)
+      InFlight.erase(transfer.Key);
+    DoneCv.notify_all();
+  }
+}
+
+void TransferQueue::push(void *key, size_t size,
+                         std::function<int32_t()> fn) {
+  {
+    std::lock_guard<std::mutex> lock(Mtx);
+    Pending.push({size, NextSeq++, key, fn});
+    InFlight[key]++;
+  }
+  WorkCv.notify_one();
+}
+
+int32_t TransferQueue::wait(void *key) {
+  std::unique_lock<std::mutex> lock(Mtx);
+  DoneCv.wait(lock, [this, key] { return InFlight.count(key) == 0; });
+
+  if (FailedKeys.erase(key))
+    return OFFLOAD_FAIL;
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t TransferQueue::wait_all() {
+  std::unique_lock<std::mutex> lock(Mtx);
+
+  // Transfers queued later by other threads are theirs to wait for, only the
+  // failures of the keys known now are reported and cleared.
+  std::set<void *> keys(FailedKeys);
+  for (auto &entry : InFlight)
+    keys.insert(entry.first);
+
+  DoneCv.wait(lock, [this, &keys] {
+    for (void *key : keys)
+      if (InFlight.count(key))
+        return false;
+    return true;
+  });
+
+  int32_t rc = OFFLOAD_SUCCESS;
+  for (void *key : keys)
+    if (FailedKeys.erase(key))
+      rc = OFFLOAD_FAIL;
+  return rc;
+}
@@ -0,0 +1,82 @@
+//===-------- cloud_queue.h ----- - Information ------ C++ -*--------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Bounded pool of workers executing data transfers
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _INCLUDE_QUEUE_H_
+#define _INCLUDE_QUEUE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Transfers are executed by a fixed number of workers, largest first. Each
+// transfer is attached to a key (the target pointer) so that the deletion of
+// a buffer can wait for its in-flight transfers.
+class TransferQueue {
+  struct TransferTy {
+    size_t Size;
+    uint64_t Seq;
+    void *Key;
+    std::function<int32_t()> Fn;
+  };
+
+  // Largest transfers first, then in submission order
+  struct TransferCmp {
+    bool operator()(const TransferTy &a, const TransferTy &b) const {
+      return a.Size < b.Size || (a.Size == b.Size && a.Seq > b.Seq);
+    }
+  };
+
+  std::priority_queue<TransferTy, std::vector<TransferTy>, TransferCmp>
+      Pending;
+  // Number of queued or running transfers per key
+  std::map<void *, int> InFlight;
+  // Keys with a failed transfer, until a wait on them reports it
+  std::set<void *> FailedKeys;
+  uint64_t NextSeq = 0;
+  bool Stopping = false;
+  unsigned Held = 0;
+
+  std::mutex Mtx;
+  std::condition_variable WorkCv;
+  std::condition_variable DoneCv;
+  std::vector<std::thread> Workers;
+
+  void worker();
+
+public:
+  TransferQueue(unsigned num_workers);
+  ~TransferQueue();
+
+  void push(void *key, size_t size, std::function<int32_t()> fn);
+
+  // No queued transfer starts between hold and release, so that the
+  // transfers of a batch are ordered together. The caller must not wait for
+  // transfers in between.
+  void hold();
+  void release();
+
+  // Wait for the transfers attached to key, return OFFLOAD_FAIL if one failed
+  int32_t wait(void *key);
+
+  // Wait for the transfers of all the keys queued or failed so far, return
+  // OFFLOAD_FAIL if one failed
+  int32_t wait_all();
+};
+
+#endif
@@ -14,6 +14,9 @@
 #ifndef _INCLUDE_UTIL_H_
 #define _INCLUDE_UTIL_H_
 
+#include <cstdint>
+#include <string>
+
 std::string exec_cmd(const char *cmd);
 
 int32_t execute_command(const char *command, bool print_result, bool print_cmd);
@@ -22,4 +25,9 @@ std::string random_string(size_t length);
 
 int remove_directory(const char *path);
 
+// Fast non-cryptographic 64-bit hash of a buffer (XXH64 algorithm)
+uint64_t hash_buffer(const void *data, size_t size, uint64_t seed);
+
+std::string hash_to_string(uint64_t hash);
+
 #endif
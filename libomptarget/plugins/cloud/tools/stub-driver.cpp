@@ -0,0 +1,85 @@
+//===------------- stub-driver.cpp - Persistent driver stand-in -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Stand-in of the persistent Spark driver, speaking the protocol of the
+// control channel without a Spark installation. Each kernel is executed by
+// running the command given as arguments, if any, with OMPCLOUD_KERNEL_ID set
+// to the number of the kernel. It is only built for the tests, which use it
+// by setting in the [Spark] section:
+//   PersistentDriver=true
+//   DriverCommand=/path/to/ompcloud-stub-driver [command...]
+//
+//===----------------------------------------------------------------------===//
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static bool recv_line(FILE *in, std::string &line) {
+  line.clear();
+  int c;
+  while ((c = fgetc(in)) != EOF && c != '\n')
+    line += char(c);
+  return c != EOF;
+}
+
+int main(int argc, char **argv) {
+  const char *port = getenv("OMPCLOUD_DRIVER_PORT");
+  if (!port) {
+    fprintf(stderr, "stub-driver: OMPCLOUD_DRIVER_PORT is not set\n");
+    return EXIT_FAILURE;
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(atoi(port));
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("stub-driver: cannot connect to the plugin");
+    return EXIT_FAILURE;
+  }
+
+  std::string command;
+  for (int i = 1; i < argc; i++)
+    command += std::string(i > 1 ? " " : "") + argv[i];
+
+  FILE *in = fdopen(fd, "r");
+  FILE *out = fdopen(dup(fd), "w");
+
+  fprintf(out, "READY\n");
+  fflush(out);
+
+  std::string line;
+  while (recv_line(in, line) && line != "EXIT") {
+    if (line.compare(0, 4, "RUN ") != 0) {
+      fprintf(out, "FAIL unknown command '%s'\n", line.c_str());
+    } else if (!command.empty()) {
+      setenv("OMPCLOUD_KERNEL_ID", line.substr(4).c_str(), 1);
+      int rc = system(command.c_str());
+      if (rc == 0)
+        fprintf(out, "DONE\n");
+      else
+        fprintf(out, "FAIL command exited with %d\n", rc);
+    } else {
+      fprintf(out, "DONE\n");
+    }
+    fflush(out);
+  }
+
+  fclose(out);
+  fclose(in);
+  return EXIT_SUCCESS;
+}
@@ -12,17 +12,22 @@
 //===----------------------------------------------------------------------===//
 
 #include <cassert>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <deque>
 #include <dlfcn.h>
 #include <ffi.h>
 #include <gelf.h>
 #ifndef __APPLE__
 #include <link.h>
 #endif
+#include <functional>
 #include <list>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "omptargetplugin.h"
@@ -61,6 +66,93 @@ struct DynLibTy {
   void *Handle;
 };
 
+/// Queue of asynchronous operations, run in order.
+struct AsyncQueueTy {
+  std::deque<std::function<int32_t()>> Ops;
+  // Set while the queue is scheduled or drained by a worker.
+  bool Running;
+  // Error code of the first failed operation.
+  int32_t Rc;
+
+  AsyncQueueTy() : Running(false), Rc(OFFLOAD_SUCCESS) {}
+};
+
+/// Worker threads running the operations of the queues. A queue is drained
+/// by a single worker at a time, different queues run concurrently.
+class AsyncWorkersTy {
+  std::deque<AsyncQueueTy *> Ready;
+  std::vector<std::thread> Threads;
+  std::mutex Mtx;
+  std::condition_variable WorkCv;
+  std::condition_variable DoneCv;
+  bool Stopping;
+
+  void worker() {
+    std::unique_lock<std::mutex> lock(Mtx);
+    while (true) {
+      WorkCv.wait(lock, [this] { return Stopping || !Ready.empty(); });
+      if (Ready.empty())
+        return;
+      AsyncQueueTy *Queue = Ready.front();
+      Ready.pop_front();
+
+      while (!Queue->Ops.empty()) {
+        std::function<int32_t()> Op = std::move(Queue->Ops.front());
+        lock.unlock();
+        int32_t rc = Op();
+        lock.lock();
+        // Popped once done, so that a queue is empty only when it is over.
+        Queue->Ops.pop_front();
+        if (rc != OFFLOAD_SUCCESS && Queue->Rc == OFFLOAD_SUCCESS)
+          Queue->Rc = rc;
+      }
+      Queue->Running = false;
+      DoneCv.notify_all();
+    }
+  }
+
+public:
+  AsyncWorkersTy() : Stopping(false) {}
+
+  ~AsyncWorkersTy() {
+    Mtx.lock();
+    Stopping = true;
+    Mtx.unlock();
+    WorkCv.notify_all();
+    for (auto &T : Threads)
+      T.join();
+  }
+
+  void push(AsyncQueueTy *Queue, std::function<int32_t()> Op) {
+    std::lock_guard<std::mutex> lock(Mtx);
+    if (Threads.empty()) {
+      unsigned NumThreads = std::thread::hardware_concurrency();
+      if (NumThreads == 0)
+        NumThreads = 1;
+      DP("Starting %u asynchronous workers\n", NumThreads);
+      for (unsigned i = 0; i < NumThreads; ++i)
+        Threads.push_back(std::thread(&AsyncWorkersTy::worker, this));
+    }
+    Queue->Ops.push_back(std::move(Op));
+    if (!Queue->Running) {
+      Queue->Running = true;
+      Ready.push_back(Queue);
+      WorkCv.notify_one();
+    }
+  }
+
+  bool query(AsyncQueueTy *Queue) {
+    std::lock_guard<std::mutex> lock(Mtx);
+    return Queue->Ops.empty();
+  }
+
+  int32_t synchronize(AsyncQueueTy *Queue) {
+    std::unique_lock<std::mutex> lock(Mtx);
+    DoneCv.wait(lock, [Queue] { return !Queue->Running; });
+    return Queue->Rc;
+  }
+};
+
 /// Keep entries table per device.
 struct FuncOrGblEntryTy {
   __tgt_target_table Table;
@@ -73,6 +165,17 @@ class RTLDeviceInfoTy {
 public:
   std::list<DynLibTy> DynLibs;
 
+  AsyncWorkersTy AsyncWorkers;
+
+  // Queue an operation, creating the queue of AsyncInfo if needed.
+  int32_t pushAsync(__tgt_async_info *AsyncInfo,
+                    std::function<int32_t()> Op) {
+    if (!AsyncInfo->Queue)
+      AsyncInfo->Queue = new AsyncQueueTy();
+    AsyncWorkers.push((AsyncQueueTy *)AsyncInfo->Queue, std::move(Op));
+    return OFFLOAD_SUCCESS;
+  }
+
   // Record entry point associated with device.
   void createOffloadTable(int32_t device_id, __tgt_offload_entry *begin,
                           __tgt_offload_entry *end) {
@@ -146,6 +249,8 @@ int32_t __tgt_rtl_is_valid_binary(__tgt_device_image *image) {
 
 int32_t __tgt_rtl_number_of_devices() { return NUMBER_OF_DEVICES; }
 
+int32_t __tgt_rtl_has_real_device_ptrs() { return 1; }
+
 int32_t __tgt_rtl_init_device(int32_t device_id) { return OFFLOAD_SUCCESS; }
 
 __tgt_target_table *__tgt_rtl_load_binary(int32_t device_id,
@@ -338,6 +443,58 @@ int32_t __tgt_rtl_run_target_region(int32_t device_id, void *tgt_entry_ptr,
       tgt_offsets, tgt_sizes, arg_num, 1, 1, 0);
 }
 
+int32_t __tgt_rtl_data_submit_async(int32_t device_id, void *tgt_ptr,
+                                    void *hst_ptr, int64_t size,
+                                    __tgt_async_info *async_info) {
+  return DeviceInfo.pushAsync(async_info, [=]() {
+    return __tgt_rtl_data_submit(device_id, tgt_ptr, hst_ptr, size);
+  });
+}
+
+int32_t __tgt_rtl_data_retrieve_async(int32_t device_id, void *hst_ptr,
+                                      void *tgt_ptr, int64_t size,
+                                      __tgt_async_info *async_info) {
+  return DeviceInfo.pushAsync(async_info, [=]() {
+    return __tgt_rtl_data_retrieve(device_id, hst_ptr, tgt_ptr, size);
+  });
+}
+
+int32_t __tgt_rtl_run_target_team_region_async(int32_t device_id,
+    void *tgt_entry_ptr, void **tgt_args, ptrdiff_t *tgt_offsets,
+    int64_t *tgt_sizes, int32_t arg_num, int32_t team_num,
+    int32_t thread_limit, uint64_t loop_tripcount,
+    __tgt_async_info *async_info) {
+  // The arguments are copied, the arrays of the caller may be reused before
+  // the region runs.
+  std::vector<void *> args(tgt_args, tgt_args + arg_num);
+  std::vector<ptrdiff_t> offsets(tgt_offsets, tgt_offsets + arg_num);
+  std::vector<int64_t> sizes(tgt_sizes, tgt_sizes + arg_num);
+
+  return DeviceInfo.pushAsync(async_info, [=]() mutable {
+    return __tgt_rtl_run_target_team_region(device_id, tgt_entry_ptr,
+        args.data(), offsets.data(), sizes.data(), arg_num, team_num,
+        thread_limit, loop_tripcount);
+  });
+}
+
+int32_t __tgt_rtl_synchronize(int32_t device_id,
+                              __tgt_async_info *async_info) {
+  AsyncQueueTy *Queue = (AsyncQueueTy *)async_info->Queue;
+  if (!Queue)
+    return OFFLOAD_SUCCESS;
+
+  int32_t rc = DeviceInfo.AsyncWorkers.synchronize(Queue);
+  delete Queue;
+  async_info->Queue = NULL;
+  return rc;
+}
+
+int32_t __tgt_rtl_query_async(int32_t device_id,
+                              __tgt_async_info *async_info) {
+  AsyncQueueTy *Queue = (AsyncQueueTy *)async_info->Queue;
+  return !Queue || DeviceInfo.AsyncWorkers.query(Queue);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,128 @@
+//===--- RTLs/smartnic/src/protocol.h - SmartNIC wire protocol ---- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.txt for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Wire protocol between the SmartNIC plugin and the device server.
+//
+// Every request starts with a FrameHeader and is answered on the same
+// connection, so that several requests are in flight over a pool of
+// connections. The payload of a write follows its header and is sent in
+// chunks of ChunkSize bytes; the server acknowledges every AckInterval chunks
+// and once the whole payload is received, so that the client only waits for
+// an acknowledgement once per window. The payload of a read follows the DATA
+// header of the answer.
+//
+// Device buffers are allocated by the server, which answers with a handle.
+// The plugin hands out target pointers made of the handle and of an offset
+// in the buffer, so that the pointer arithmetic done by libomptarget on
+// mapped sections keeps addressing the same device buffer.
+//
+// Modules are identified by the hash of their content. A PROGRAM request
+// without payload asks the server to load a module it already holds, and is
+// answered with SMARTNIC_UNKNOWN_MODULE if the payload has to be sent.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SMARTNIC_PROTOCOL_H_
+#define _SMARTNIC_PROTOCOL_H_
+
+#include <cstdint>
+
+#define SMARTNIC_MAGIC 0x43494e53 // "SNIC"
+#define SMARTNIC_VERSION 3
+
+#define SMARTNIC_DEFAULT_HOST "127.0.0.1"
+#define SMARTNIC_DEFAULT_PORT 51717
+#define SMARTNIC_DEFAULT_CONNECTIONS 4
+#define SMARTNIC_DEFAULT_CHUNK_SIZE (256 * 1024)
+#define SMARTNIC_DEFAULT_ACK_INTERVAL 8
+
+// Target pointers hold the buffer handle above the offset, buffers are thus
+// limited to 1TB.
+#define SMARTNIC_HANDLE_SHIFT 40
+#define SMARTNIC_MAX_BUFFER_SIZE (1ULL << SMARTNIC_HANDLE_SHIFT)
+
+static inline void *smartnic_target_ptr(uint64_t handle, uint64_t offset) {
+  return (void *)(uintptr_t)((handle << SMARTNIC_HANDLE_SHIFT) | offset);
+}
+
+static inline uint64_t smartnic_handle(const void *tgt_ptr) {
+  return (uint64_t)(uintptr_t)tgt_ptr >> SMARTNIC_HANDLE_SHIFT;
+}
+
+static inline uint64_t smartnic_offset(const void *tgt_ptr) {
+  return (uint64_t)(uintptr_t)tgt_ptr & (SMARTNIC_MAX_BUFFER_SIZE - 1);
+}
+
+enum SmartNICFrameType : uint8_t {
+  // Requests
+  SMARTNIC_WRITE = 'w',   // payload of Length bytes at Offset of Handle
+  SMARTNIC_READ = 'r',    // Length bytes at Offset of Handle
+  SMARTNIC_PROGRAM = 'p', // load the module of hash Handle, whose content
+                          // is the payload of Length bytes if any
+  SMARTNIC_LAUNCH = 'x',  // run the entry Handle of the module of hash
+                          // Offset, with a LaunchArgsHeader and its
+                          // arguments as payload of Length bytes
+  SMARTNIC_ALLOC = 'l',   // buffer of Length bytes, answered with its Handle
+  SMARTNIC_FREE = 'f',    // release the buffer Handle
+  SMARTNIC_QUIT = 'q',    // close the connection
+  // Answers
+  SMARTNIC_ACK = 'a',  // Length is the number of bytes received so far
+  SMARTNIC_DATA = 'd', // payload of Length bytes follows
+};
+
+enum SmartNICStatus : uint8_t {
+  SMARTNIC_OK = 0,
+  SMARTNIC_ERROR = 1,
+  SMARTNIC_UNKNOWN_MODULE = 2,
+};
+
+struct FrameHeader {
+  uint32_t Magic;
+  uint16_t Version;
+  uint8_t Type;
+  uint8_t Status;
+  uint32_t RequestId;
+  uint32_t ChunkSize;
+  uint32_t AckInterval;
+  uint32_t Reserved;
+  uint64_t Handle;
+  uint64_t Offset;
+  uint64_t Length;
+};
+
+static_assert(sizeof(FrameHeader) == 48, "Unexpected frame header layout");
+
+struct LaunchArgsHeader {
+  uint32_t NumTeams;
+  uint32_t ThreadLimit;
+  uint64_t LoopTripcount;
+  uint64_t NumArgs;
+};
+
+// Followed by NumArgs arguments, target pointers being already offset
+struct LaunchArg {
+  uint64_t Value;
+  int64_t Size;
+};
+
+static_assert(sizeof(LaunchArgsHeader) == 24, "Unexpected launch layout");
+static_assert(sizeof(LaunchArg) == 16, "Unexpected launch argument layout");
+
+// FNV-1a hash identifying the content of a module
+static inline uint64_t smartnic_module_hash(const void *data, uint64_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint64_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+#endif // _SMARTNIC_PROTOCOL_H_
@@ -14,6 +14,7 @@
 #include <cassert>
 #include <cstddef>
 #include <list>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <ffi.h>
@@ -22,20 +23,18 @@
 #include <link.h>
 #endif
 #include <unistd.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <netdb.h>
-#include <arpa/inet.h>
 
 #include "omptarget.h"
+#include "transport.h"
 
 #ifndef TARGET_NAME
 #define TARGET_NAME SMARTNIC
 #endif
 
 #ifdef OMPTARGET_DEBUG
-static int DebugLevel = 0;
+static int DebugLevel = getenv("LIBOMPTARGET_DEBUG")
+                            ? std::stoi(getenv("LIBOMPTARGET_DEBUG"))
+                            : 0;
 
 #define GETNAME2(name) #name
 #define GETNAME(name) GETNAME2(name)
@@ -73,227 +72,97 @@ struct DynLibTy {
   void *Handle;
 };
 
-/// Keep entries table per device.
+/// Keep entries table per image, with the module of the image.
 struct FuncOrGblEntryTy {
   __tgt_target_table Table;
-};
-
-/// Class to handle socket.
-class SocketHandle {
- private:
-  int sockfd;
-  int portno;
-  int conn_status;
-  struct sockaddr_in serv_addr;
-  struct hostent *server;
-
-  inline void send_ack() {
-    if (send(this->sockfd, "ack", 3, 0) < 0) {
-      DP("[smartnic] error writing ack to socket\n");
-      throw -1;
-    }
-  }
-
-  inline void get_ack() {
-    char buffer[3];
-
-    bzero(buffer, 3);
-    if (recv(this->sockfd, buffer, 3, 0) < 0) {
-      DP("[smartnic] error reading ack from socket\n");
-      throw -1;
-    }
-
-    if (buffer[0] != 'a' || buffer[1] != 'c' || buffer[2] != 'k') {
-      DP("[smartnic] error not received ack message\n");
-      throw -1;
-    }
-
-    DP("[smartnic] ack received!\n");
-  }
-
-  inline void send_cmd(char cmd) {
-    char buffer[1];
-
-    buffer[0] = cmd;
-
-    if (send(this->sockfd, buffer, 1, 0) < 0) {
-      DP("[smartnic] error cmd from socket!\n");
-      throw -1;
-    }
-
-    this->get_ack();
-  }
-
-  inline void send_data(void *data, int64_t size) {
-    if (send(this->sockfd, data, size, 0) < 0) {
-      DP("[smartnic] send data error!\n");
-      throw -1;
-    }
-
-    this->get_ack();
-  }
-
-  inline void recv_data(void *data, int64_t size) {
-    ssize_t recv_bytes = 0;
-
-    do {
-      recv_bytes += recv(this->sockfd,
-                         static_cast<char*>(data) + recv_bytes,
-                         size, 0);
-
-      if (recv_bytes < 0) {
-        DP("[smartnic] recv data error!\n");
-        throw -1;
-      }
-    } while(recv_bytes != size);
-
-    this->send_ack();
-  }
-
- public:
-  int conn() {
-    this->sockfd = socket(AF_INET, SOCK_STREAM, 0);
-
-    if (sockfd < 0) {
-      DP("[smartnic] error - opening the socket!");
-      return -1;
-    }
-
-    bzero((char *) &this->serv_addr, sizeof(serv_addr));
-
-    inet_pton(AF_INET, "127.0.0.1", &(this->serv_addr.sin_addr));
-    this->serv_addr.sin_family = AF_INET;
-    this->serv_addr.sin_port = htons(this->portno);
-
-    conn_status = connect(this->sockfd,
-                          (struct sockaddr *) &this->serv_addr,
-                          sizeof(this->serv_addr));
-
-    return conn_status;
-  }
-
-  int write(void *data, int64_t size) {
-    int write_status = 1;
-
-    assert(size > 0);
-
-    try {
-      this->send_cmd('w');
-      this->send_data(reinterpret_cast<void*>(&size), 8);
-      this->send_data(data, size);
-    } catch (int e) {
-      write_status = e;
-    }
-
-    return write_status;
-  }
-
-  int program(void *data, int64_t size) {
-    int program_status = 1;
-
-    assert(size > 0);
-
-    try {
-      this->send_cmd('p');
-      this->send_data(data, size);
-    } catch (int e) {
-      program_status = e;
-    }
-
-    return program_status;
-  }
-
-  int read(void *data, int64_t size) {
-    int read_status = 1;
-
-    assert(size > 0);
-
-    try {
-      this->send_cmd('r');
-      this->send_data(reinterpret_cast<void*>(&size), 8);
-      this->recv_data(data, size);
-    } catch (int e) {
-      read_status = e;
-    }
-
-    return read_status;
-  }
-
-  void disconnect() {
-    this->send_cmd('q');
-    this->send_ack();
-
-    close(this->sockfd);
-  }
-
-  int get_conn_status() {
-    return conn_status;
-  }
-
-  SocketHandle() {
-    this->portno = 51717;
-    this->conn_status = -1;
-
-    this->conn();
-  }
-
-  SocketHandle(int portno) {
-    this->portno = portno;
-    this->conn_status = -1;
-  }
-
-  ~SocketHandle() {
-    DP("[smartnic] socket closed\n");
-    this->send_cmd('q');
-    this->send_ack();
-
-    close(this->sockfd);
-  }
+  std::string Module;
 };
 
 /// Class containing FPGA information
 class FPGAInfo {
 private:
-  SocketHandle *socket_handle;
-  char *last_module;
-  char *module;
+  SmartNICTransport *transport;
+  // Hash of the module loaded on the device, valid if loaded is true
+  uint64_t loaded_hash;
+  bool loaded;
+  // Programming and launching are serialized, so that a module is not
+  // replaced while one of its kernels is launched
+  std::mutex mtx;
+
+  // Load module on the device unless it is already loaded
+  int32_t program_fpga(const std::string &module, uint64_t hash) {
+    if (loaded && loaded_hash == hash)
+      return OFFLOAD_SUCCESS;
+
+    // The server keeps the modules it already received: only send the hash
+    // first, and the content if the server does not know it.
+    FrameHeader answer;
+    int32_t rc = transport->call(SMARTNIC_PROGRAM, hash, 0, 0, nullptr,
+                                 &answer);
+    if (rc != OFFLOAD_SUCCESS && answer.Status == SMARTNIC_UNKNOWN_MODULE)
+      rc = transport->call(SMARTNIC_PROGRAM, hash, 0, module.size(),
+                           module.data());
+
+    if (rc != OFFLOAD_SUCCESS) {
+      DP("[fpga_info] error - programming FPGA - %s\n", module.c_str());
+      loaded = false;
+      return OFFLOAD_FAIL;
+    }
+
+    DP("[fpga_info] programming FPGA - %s\n", module.c_str());
+    loaded_hash = hash;
+    loaded = true;
+    return OFFLOAD_SUCCESS;
+  }
 
 public:
 
-  void set_module(char *module) {
-    this->module = (char*) realloc(last_module, sizeof(module));
-    memcpy(this->module, module, strlen(module));
-  }
+  int32_t program(const std::string &module) {
+    if (module.empty())
+      return OFFLOAD_SUCCESS;
 
-  void program_fpga() {
-    if (strlen(module) == 0)
-      return;
+    std::lock_guard<std::mutex> lock(mtx);
+    return program_fpga(module, hash(module));
+  }
 
-    if (last_module == NULL || strcmp(module, last_module) != 0) {
-      last_module = (char*) realloc(last_module, sizeof(module));
+  // Run the entry entry_id of module, with the arguments already offset
+  int32_t launch(const std::string &module, uint64_t entry_id,
+                 const std::vector<LaunchArg> &args, int32_t team_num,
+                 int32_t thread_limit, uint64_t loop_tripcount) {
+    std::vector<char> payload(sizeof(LaunchArgsHeader) +
+                              args.size() * sizeof(LaunchArg));
+    LaunchArgsHeader header;
+    header.NumTeams = team_num;
+    header.ThreadLimit = thread_limit;
+    header.LoopTripcount = loop_tripcount;
+    header.NumArgs = args.size();
+    memcpy(payload.data(), &header, sizeof(header));
+    if (!args.empty())
+      memcpy(payload.data() + sizeof(header), args.data(),
+             args.size() * sizeof(LaunchArg));
 
-      memcpy(last_module, module, strlen(module));
+    uint64_t module_hash = hash(module);
 
-      this->socket_handle->program(reinterpret_cast<void*>(module),
-                                   strlen(module) + 1);
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!module.empty() &&
+        program_fpga(module, module_hash) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
 
-      DP("[fpga_info] programming FPGA - %s\n", last_module);
-    }
+    return transport->call(SMARTNIC_LAUNCH, entry_id, module_hash,
+                           payload.size(), payload.data());
   }
 
-  FPGAInfo(SocketHandle *socket_handle) {
-    this->last_module = NULL;
-    this->socket_handle = socket_handle;
+  static uint64_t hash(const std::string &module) {
+    return smartnic_module_hash(module.data(), module.size());
   }
 
-  ~FPGAInfo() {
-    free(this->last_module);
-  }
+  FPGAInfo(SmartNICTransport *transport)
+      : transport(transport), loaded_hash(0), loaded(false) {}
 };
 
 /// Class containing all the device information.
 class RTLDeviceInfoTy {
-  std::vector<FuncOrGblEntryTy> FuncGblEntries;
+  std::vector<std::list<FuncOrGblEntryTy>> FuncGblEntries;
 
 public:
 
@@ -301,35 +170,45 @@ public:
 
   // Record entry point associated with device.
   void createOffloadTable(int32_t device_id, __tgt_offload_entry *begin,
-                          __tgt_offload_entry *end) {
+                          __tgt_offload_entry *end,
+                          const std::string &module) {
     assert(device_id < (int32_t)FuncGblEntries.size() &&
            "Unexpected device id!");
-    FuncOrGblEntryTy &E = FuncGblEntries[device_id];
+    FuncGblEntries[device_id].emplace_back();
+    FuncOrGblEntryTy &E = FuncGblEntries[device_id].back();
 
     E.Table.EntriesBegin = begin;
     E.Table.EntriesEnd = end;
+    E.Module = module;
   }
 
-  // Return true if the entry is associated with device.
-  bool findOffloadEntry(int32_t device_id, void *addr) {
+  // Return the entry associated with device, with its index in the table of
+  // its image, or NULL if none.
+  FuncOrGblEntryTy *findOffloadEntry(int32_t device_id, void *addr,
+                                     uint64_t &entry_id) {
     assert(device_id < (int32_t)FuncGblEntries.size() &&
            "Unexpected device id!");
-    FuncOrGblEntryTy &E = FuncGblEntries[device_id];
 
-    for (__tgt_offload_entry *i = E.Table.EntriesBegin, *e = E.Table.EntriesEnd;
-         i < e; ++i) {
-      if (i->addr == addr)
-        return true;
+    for (FuncOrGblEntryTy &E : FuncGblEntries[device_id]) {
+      for (__tgt_offload_entry *i = E.Table.EntriesBegin,
+                               *e = E.Table.EntriesEnd;
+           i < e; ++i) {
+        if (i->addr == addr) {
+          entry_id = i - E.Table.EntriesBegin;
+          return &E;
+        }
+      }
     }
 
-    return false;
+    return NULL;
   }
 
-  // Return the pointer to the target entries table.
+  // Return the pointer to the target entries table of the last image.
   __tgt_target_table *getOffloadEntriesTable(int32_t device_id) {
     assert(device_id < (int32_t)FuncGblEntries.size() &&
            "Unexpected device id!");
-    FuncOrGblEntryTy &E = FuncGblEntries[device_id];
+    assert(!FuncGblEntries[device_id].empty() && "No image loaded!");
+    FuncOrGblEntryTy &E = FuncGblEntries[device_id].back();
 
     return &E.Table;
   }
@@ -348,43 +227,39 @@ public:
 };
 
 static RTLDeviceInfoTy DeviceInfo(NUMBER_OF_DEVICES);
-static SocketHandle    socket_handle;
-static FPGAInfo        fpga_info(&socket_handle);
+static SmartNICTransport transport(
+    getenv("SMARTNIC_HOST") ? getenv("SMARTNIC_HOST") : SMARTNIC_DEFAULT_HOST,
+    getenv("SMARTNIC_PORT") ? std::stoi(getenv("SMARTNIC_PORT"))
+                            : SMARTNIC_DEFAULT_PORT,
+    getenv("SMARTNIC_CONNECTIONS") ? std::stoi(getenv("SMARTNIC_CONNECTIONS"))
+                                   : SMARTNIC_DEFAULT_CONNECTIONS,
+    getenv("SMARTNIC_CHUNK_SIZE") ? std::stoul(getenv("SMARTNIC_CHUNK_SIZE"))
+                                  : SMARTNIC_DEFAULT_CHUNK_SIZE,
+    getenv("SMARTNIC_ACK_INTERVAL")
+        ? std::stoul(getenv("SMARTNIC_ACK_INTERVAL"))
+        : SMARTNIC_DEFAULT_ACK_INTERVAL);
+static FPGAInfo fpga_info(&transport);
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-int32_t __tgt_rtl_is_valid_binary(__tgt_device_image *image) {
-  uint32_t is_valid_binary = elf_check_machine(image, EM_X86_64, 9001);
-
-  // TODO(ciroc): extract struct information
-  if (is_valid_binary) {
-    __tgt_configuration *cfg;
-    int i;
-    char *module = NULL;
-    char *img_begin = (char *)image->ImageStart;
-
-    if (0 != get_tgt_configuration_module(image, &cfg))
-      return is_valid_binary;
-
-    // string constant pointer to .rodata section of elf (img_begin)
-    for(i = 0; *(img_begin + (intptr_t)cfg->module + i) != '\0'; i++) {
-      module = (char*) realloc(module, (i + 1));
-      module[i] = *(img_begin + (intptr_t)cfg->module + i);
-    }
-    module = (char*) realloc(module, (i + 1));
-    module[i] = '\0';
+// Return the name of the module the image is built for, empty if none.
+static std::string get_image_module(__tgt_device_image *image) {
+  __tgt_configuration *cfg;
+  char *img_begin = (char *)image->ImageStart;
 
-    fpga_info.set_module(module);
+  if (0 != get_tgt_configuration_module(image, &cfg))
+    return std::string();
 
-    DP("[smartnic] sub_target_id = %d\n", cfg->sub_target_id);
-    DP("[smartnic] module = %s\n", module);
+  DP("[smartnic] sub_target_id = %d\n", cfg->sub_target_id);
 
-    free(module);
-  }
+  // string constant pointer to .rodata section of elf (img_begin)
+  return std::string(img_begin + (intptr_t)cfg->module);
+}
 
-  return is_valid_binary;
+int32_t __tgt_rtl_is_valid_binary(__tgt_device_image *image) {
+  return elf_check_machine(image, EM_X86_64, 9001);
 }
 
 int32_t __tgt_rtl_number_of_devices() {
@@ -395,12 +270,10 @@ int32_t __tgt_rtl_init_device(int32_t device_id) {
 
   DP("[smartnic] __tgt_rtl_init_device\n");
 
-  if (socket_handle.get_conn_status() < 0) {
+  if (transport.get_conn_status() < 0 && transport.conn() < 0) {
     return OFFLOAD_FAIL;
   }
 
-  fpga_info.program_fpga();
-
   return OFFLOAD_SUCCESS;
 }
 
@@ -416,6 +289,9 @@ __tgt_target_table *__tgt_rtl_load_binary(int32_t device_id,
   size_t NumEntries = (size_t)(image->EntriesEnd - image->EntriesBegin);
   DP("Expecting to have %zd entries defined.\n", NumEntries);
 
+  std::string module = get_image_module(image);
+  DP("[smartnic] module = %s\n", module.c_str());
+
   // Is the library version incompatible with the header file?
   if (elf_version(EV_CURRENT) == EV_NONE) {
     DP("Incompatible ELF library!\n");
@@ -523,67 +399,144 @@ __tgt_target_table *__tgt_rtl_load_binary(int32_t device_id,
 
   DP("Entries table range is (" DPxMOD ")->(" DPxMOD ")\n",
       DPxPTR(entries_begin), DPxPTR(entries_end));
-  DeviceInfo.createOffloadTable(device_id, entries_begin, entries_end);
+  DeviceInfo.createOffloadTable(device_id, entries_begin, entries_end,
+                                module);
 #endif
 
   elf_end(e);
 
+  // Program the device ahead of the first launch
+  if (fpga_info.program(module) != OFFLOAD_SUCCESS)
+    return NULL;
+
   return DeviceInfo.getOffloadEntriesTable(device_id);
 }
 
-void *__tgt_rtl_data_alloc(int32_t device_id, int64_t size) {
-  DP("[smartnic] __tgt_rtl_data_alloc\n");
-  void *ptr = malloc(size);
+void *__tgt_rtl_data_alloc(int32_t device_id, int64_t size, void *hst_ptr,
+                           int64_t type) {
+  DP("[smartnic] __tgt_rtl_data_alloc: %" PRId64 "\n", size);
 
-  return ptr;
+  if ((uint64_t)size >= SMARTNIC_MAX_BUFFER_SIZE) {
+    DP("[smartnic] error - buffer too large for the device\n");
+    return NULL;
+  }
+
+  // The device buffer stays allocated until data_delete, so that it is not
+  // streamed again by the regions mapping it meanwhile.
+  FrameHeader answer;
+  if (transport.call(SMARTNIC_ALLOC, 0, 0, size > 0 ? size : 1, nullptr,
+                     &answer) != OFFLOAD_SUCCESS || answer.Handle == 0) {
+    DP("[smartnic] error - device buffer allocation failed\n");
+    return NULL;
+  }
+
+  DP("[smartnic] allocated device buffer %" PRIu64 "\n", answer.Handle);
+
+  return smartnic_target_ptr(answer.Handle, 0);
 }
 
 int32_t __tgt_rtl_data_submit(int32_t device_id, void *tgt_ptr, void *hst_ptr,
     int64_t size) {
 
-  DP("[smartnic] __tgt_rtl_data_submit: %" PRId64 "\n", size);
+  DP("[smartnic] __tgt_rtl_data_submit: %" PRId64 " bytes to buffer %" PRIu64
+     " at offset %" PRIu64 "\n", size, smartnic_handle(tgt_ptr),
+     smartnic_offset(tgt_ptr));
 
-  socket_handle.write(hst_ptr, size);
-
-  return OFFLOAD_SUCCESS;
+  return transport.write(smartnic_handle(tgt_ptr), smartnic_offset(tgt_ptr),
+                         hst_ptr, size);
 }
 
 int32_t __tgt_rtl_data_retrieve(int32_t device_id, void *hst_ptr, void *tgt_ptr,
     int64_t size) {
 
-  DP("[smartnic] __tgt_rtl_data_retrieve\n");
+  DP("[smartnic] __tgt_rtl_data_retrieve: %" PRId64 " bytes from buffer %"
+     PRIu64 " at offset %" PRIu64 "\n", size, smartnic_handle(tgt_ptr),
+     smartnic_offset(tgt_ptr));
 
-  socket_handle.read(hst_ptr, size);
+  return transport.read(smartnic_handle(tgt_ptr), smartnic_offset(tgt_ptr),
+                        hst_ptr, size);
+}
 
-  return OFFLOAD_SUCCESS;
+static std::vector<BatchEntry> get_batch(int32_t num_buffers, void **tgt_ptrs,
+                                         void **hst_ptrs, int64_t *sizes) {
+  std::vector<BatchEntry> entries;
+  entries.reserve(num_buffers);
+  for (int32_t i = 0; i < num_buffers; ++i) {
+    if (sizes[i] <= 0)
+      continue;
+    entries.push_back({smartnic_handle(tgt_ptrs[i]),
+                       smartnic_offset(tgt_ptrs[i]), (char *)hst_ptrs[i],
+                       (uint64_t)sizes[i]});
+  }
+  return entries;
 }
 
-int32_t __tgt_rtl_data_delete(int32_t device_id, void *tgt_ptr) {
+int32_t __tgt_rtl_data_submit_batch(int32_t device_id, int32_t num_buffers,
+    void **tgt_ptrs, void **hst_ptrs, int64_t *sizes) {
 
-  DP("[smartnic] __tgt_rtl_delete\n");
+  DP("[smartnic] __tgt_rtl_data_submit_batch: %d buffers\n", num_buffers);
 
-  free(tgt_ptr);
+  return transport.write_batch(
+      get_batch(num_buffers, tgt_ptrs, hst_ptrs, sizes));
+}
 
-  return OFFLOAD_SUCCESS;
+int32_t __tgt_rtl_data_retrieve_batch(int32_t device_id, int32_t num_buffers,
+    void **hst_ptrs, void **tgt_ptrs, int64_t *sizes) {
+
+  DP("[smartnic] __tgt_rtl_data_retrieve_batch: %d buffers\n", num_buffers);
+
+  return transport.read_batch(
+      get_batch(num_buffers, tgt_ptrs, hst_ptrs, sizes));
+}
+
+int32_t __tgt_rtl_data_delete(int32_t device_id, void *tgt_ptr) {
+
+  DP("[smartnic] __tgt_rtl_delete: buffer %" PRIu64 "\n",
+     smartnic_handle(tgt_ptr));
+
+  return transport.call(SMARTNIC_FREE, smartnic_handle(tgt_ptr), 0, 0);
 }
 
 int32_t __tgt_rtl_run_target_team_region(int32_t device_id, void *tgt_entry_ptr,
-    void **tgt_args, int32_t arg_num, int32_t team_num, int32_t thread_limit,
+    void **tgt_args, ptrdiff_t *tgt_offsets, int64_t *tgt_sizes,
+    int32_t arg_num, int32_t team_num, int32_t thread_limit,
     uint64_t loop_tripcount) {
 
   DP("[smartnic] __tgt_rtl_run_target_team_region\n");
 
-  return OFFLOAD_SUCCESS;
+  uint64_t entry_id;
+  FuncOrGblEntryTy *E =
+      DeviceInfo.findOffloadEntry(device_id, tgt_entry_ptr, entry_id);
+  if (!E) {
+    DP("[smartnic] error - entry " DPxMOD " not found\n",
+       DPxPTR(tgt_entry_ptr));
+    return OFFLOAD_FAIL;
+  }
+
+  // Target pointers keep their buffer handle, scalars are passed as is
+  std::vector<LaunchArg> args(arg_num);
+  for (int32_t i = 0; i < arg_num; ++i) {
+    args[i].Value = (uint64_t)((intptr_t)tgt_args[i] + tgt_offsets[i]);
+    args[i].Size = tgt_sizes[i];
+  }
+
+  DP("[smartnic] launching entry %" PRIu64 " with %d arguments\n", entry_id,
+     arg_num);
+
+  return fpga_info.launch(E->Module, entry_id, args, team_num, thread_limit,
+                          loop_tripcount);
 }
 
 int32_t __tgt_rtl_run_target_region(int32_t device_id, void *tgt_entry_ptr,
-    void **tgt_args, int32_t arg_num) {
+    void **tgt_args, ptrdiff_t *tgt_offsets, int64_t *tgt_sizes,
+    int32_t arg_num) {
 
   DP("[smartnic] __tgt_rtl_run_target_region\n");
 
   // use one team and one thread.
   return __tgt_rtl_run_target_team_region(device_id, tgt_entry_ptr, tgt_args,
-                                          arg_num, 1, 1, 0);
+                                          tgt_offsets, tgt_sizes, arg_num, 1,
+                                          1, 0);
 }
 
 #ifdef __cplusplus
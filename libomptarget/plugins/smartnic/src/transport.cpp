@@ -0,0 +1,486 @@
+//===-- RTLs/smartnic/src/transport.cpp - SmartNIC connections ---- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.txt for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Pool of connections to the SmartNIC device server.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "omptarget.h"
+#include "transport.h"
+
+#ifndef TARGET_NAME
+#define TARGET_NAME SMARTNIC
+#endif
+
+#ifdef OMPTARGET_DEBUG
+static int DebugLevel = getenv("LIBOMPTARGET_DEBUG")
+                            ? std::stoi(getenv("LIBOMPTARGET_DEBUG"))
+                            : 0;
+
+#define GETNAME2(name) #name
+#define GETNAME(name) GETNAME2(name)
+#define DP(...) \
+  do { \
+    if (DebugLevel > 0) { \
+      DEBUGP("Target " GETNAME(TARGET_NAME) " RTL", __VA_ARGS__); \
+    } \
+  } while (false)
+#else // OMPTARGET_DEBUG
+#define DP(...) {}
+#endif // OMPTARGET_DEBUG
+
+SmartNICTransport::SmartNICTransport(const std::string &host, int portno,
+                                     int num_connections,
+                                     uint32_t chunk_size,
+                                     uint32_t ack_interval)
+    : host(host), portno(portno), num_connections(num_connections),
+      chunk_size(chunk_size), ack_interval(ack_interval), conn_status(-1),
+      next_request_id(0) {
+  if (this->num_connections < 1)
+    this->num_connections = 1;
+  if (this->chunk_size == 0)
+    this->chunk_size = SMARTNIC_DEFAULT_CHUNK_SIZE;
+  if (this->ack_interval == 0)
+    this->ack_interval = 1;
+}
+
+SmartNICTransport::~SmartNICTransport() {
+  this->disconnect();
+}
+
+int SmartNICTransport::conn() {
+  struct sockaddr_in serv_addr;
+
+  bzero((char *) &serv_addr, sizeof(serv_addr));
+  serv_addr.sin_family = AF_INET;
+  serv_addr.sin_port = htons(this->portno);
+  if (inet_pton(AF_INET, this->host.c_str(), &serv_addr.sin_addr) != 1) {
+    DP("[smartnic] error - invalid server address %s\n", this->host.c_str());
+    return this->conn_status;
+  }
+
+  auto close_all = [this]() {
+    for (int sockfd : this->sockets)
+      close(sockfd);
+    this->sockets.clear();
+    this->idle_sockets.clear();
+  };
+
+  for (int i = 0; i < this->num_connections; i++) {
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (sockfd < 0) {
+      DP("[smartnic] error - opening the socket!\n");
+      close_all();
+      return this->conn_status;
+    }
+
+    if (connect(sockfd, (struct sockaddr *) &serv_addr,
+                sizeof(serv_addr)) < 0) {
+      DP("[smartnic] error - connecting to %s:%d\n", this->host.c_str(),
+         this->portno);
+      close(sockfd);
+      close_all();
+      return this->conn_status;
+    }
+
+    // Acknowledgements are small and must not be delayed
+    int flag = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    this->sockets.push_back(sockfd);
+    this->idle_sockets.push_back(sockfd);
+  }
+
+  DP("[smartnic] %d connections to %s:%d\n", this->num_connections,
+     this->host.c_str(), this->portno);
+
+  this->conn_status = 0;
+  return this->conn_status;
+}
+
+void SmartNICTransport::disconnect() {
+  std::lock_guard<std::mutex> lock(this->pool_mtx);
+
+  for (int sockfd : this->sockets) {
+    send_header(sockfd, SMARTNIC_QUIT, next_request_id++, 0, 0, 0);
+    close(sockfd);
+  }
+  if (!this->sockets.empty())
+    DP("[smartnic] socket closed\n");
+
+  this->sockets.clear();
+  this->idle_sockets.clear();
+  this->conn_status = -1;
+}
+
+int SmartNICTransport::acquire() {
+  std::unique_lock<std::mutex> lock(this->pool_mtx);
+
+  this->pool_cv.wait(lock, [this] { return !this->idle_sockets.empty(); });
+  int sockfd = this->idle_sockets.back();
+  this->idle_sockets.pop_back();
+
+  return sockfd;
+}
+
+void SmartNICTransport::release(int sockfd) {
+  {
+    std::lock_guard<std::mutex> lock(this->pool_mtx);
+    this->idle_sockets.push_back(sockfd);
+  }
+  this->pool_cv.notify_one();
+}
+
+int32_t SmartNICTransport::send_all(int sockfd, const void *data,
+                                    size_t size) {
+  const char *ptr = static_cast<const char *>(data);
+
+  while (size > 0) {
+    ssize_t sent = send(sockfd, ptr, size, MSG_NOSIGNAL);
+
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      DP("[smartnic] send data error!\n");
+      return OFFLOAD_FAIL;
+    }
+
+    ptr += sent;
+    size -= sent;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::recv_all(int sockfd, void *data, size_t size) {
+  char *ptr = static_cast<char *>(data);
+
+  while (size > 0) {
+    ssize_t recv_bytes = recv(sockfd, ptr, size, 0);
+
+    if (recv_bytes < 0 && errno == EINTR)
+      continue;
+    if (recv_bytes <= 0) {
+      DP("[smartnic] recv data error!\n");
+      return OFFLOAD_FAIL;
+    }
+
+    ptr += recv_bytes;
+    size -= recv_bytes;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::send_header(int sockfd, uint8_t type,
+                                       uint32_t request_id, uint64_t handle,
+                                       uint64_t offset, uint64_t length) {
+  FrameHeader header;
+
+  memset(&header, 0, sizeof(header));
+  header.Magic = SMARTNIC_MAGIC;
+  header.Version = SMARTNIC_VERSION;
+  header.Type = type;
+  header.Status = SMARTNIC_OK;
+  header.RequestId = request_id;
+  header.ChunkSize = this->chunk_size;
+  header.AckInterval = this->ack_interval;
+  header.Handle = handle;
+  header.Offset = offset;
+  header.Length = length;
+
+  return send_all(sockfd, &header, sizeof(header));
+}
+
+int32_t SmartNICTransport::recv_header(int sockfd, FrameHeader &header,
+                                       uint8_t type, uint32_t request_id) {
+  if (recv_all(sockfd, &header, sizeof(header)) != OFFLOAD_SUCCESS)
+    return OFFLOAD_FAIL;
+
+  if (header.Magic != SMARTNIC_MAGIC || header.Type != type ||
+      header.RequestId != request_id) {
+    DP("[smartnic] error - unexpected answer to request %u\n", request_id);
+    return OFFLOAD_FAIL;
+  }
+
+  if (header.Status != SMARTNIC_OK) {
+    if (header.Status == SMARTNIC_ERROR)
+      DP("[smartnic] error - request %u failed on the device\n", request_id);
+    return OFFLOAD_FAIL;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::write_range(int sockfd, uint64_t handle,
+                                       uint64_t offset, char *data,
+                                       uint64_t size) {
+  uint32_t request_id = this->next_request_id++;
+  uint64_t num_chunks = (size + this->chunk_size - 1) / this->chunk_size;
+  uint64_t acked_chunks = 0;
+  FrameHeader ack;
+
+  if (send_header(sockfd, SMARTNIC_WRITE, request_id, handle, offset, size) !=
+      OFFLOAD_SUCCESS)
+    return OFFLOAD_FAIL;
+
+  // Up to two windows are in flight: the server acknowledges a window while
+  // the next one is being sent.
+  for (uint64_t chunk = 0; chunk < num_chunks; chunk++) {
+    while (chunk - acked_chunks >= 2 * (uint64_t)this->ack_interval) {
+      if (recv_header(sockfd, ack, SMARTNIC_ACK, request_id) !=
+          OFFLOAD_SUCCESS)
+        return OFFLOAD_FAIL;
+      acked_chunks = ack.Length / this->chunk_size;
+    }
+
+    uint64_t chunk_offset = chunk * this->chunk_size;
+    uint64_t length = std::min<uint64_t>(this->chunk_size, size - chunk_offset);
+    if (send_all(sockfd, data + chunk_offset, length) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+  }
+
+  // The last acknowledgement covers the whole payload
+  do {
+    if (recv_header(sockfd, ack, SMARTNIC_ACK, request_id) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+  } while (ack.Length < size);
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::read_range(int sockfd, uint64_t handle,
+                                      uint64_t offset, char *data,
+                                      uint64_t size) {
+  uint32_t request_id = this->next_request_id++;
+  FrameHeader answer;
+
+  if (send_header(sockfd, SMARTNIC_READ, request_id, handle, offset, size) !=
+      OFFLOAD_SUCCESS)
+    return OFFLOAD_FAIL;
+
+  if (recv_header(sockfd, answer, SMARTNIC_DATA, request_id) !=
+      OFFLOAD_SUCCESS)
+    return OFFLOAD_FAIL;
+
+  if (answer.Length != size) {
+    DP("[smartnic] error - received %" PRIu64 " bytes instead of %" PRIu64
+       "\n", answer.Length, size);
+    return OFFLOAD_FAIL;
+  }
+
+  return recv_all(sockfd, data, size);
+}
+
+int32_t SmartNICTransport::transfer(RangeFnTy fn, uint64_t handle,
+                                    uint64_t offset, char *data,
+                                    uint64_t size) {
+  // Transfers smaller than two windows use a single connection
+  uint64_t window = (uint64_t)this->chunk_size * this->ack_interval;
+  uint64_t num_stripes =
+      std::min<uint64_t>(this->num_connections, size / (2 * window));
+
+  if (num_stripes <= 1) {
+    int sockfd = acquire();
+    int32_t rc = (this->*fn)(sockfd, handle, offset, data, size);
+    release(sockfd);
+    return rc;
+  }
+
+  // Stripes are made of whole chunks
+  uint64_t stripe_size = (size + num_stripes - 1) / num_stripes;
+  stripe_size = (stripe_size + this->chunk_size - 1) / this->chunk_size *
+                this->chunk_size;
+
+  std::vector<std::thread> threads;
+  std::vector<int32_t> rcs(num_stripes, OFFLOAD_SUCCESS);
+
+  for (uint64_t i = 0; i < num_stripes; i++) {
+    uint64_t begin = i * stripe_size;
+    if (begin >= size)
+      break;
+    uint64_t length = std::min(stripe_size, size - begin);
+
+    threads.push_back(std::thread([=, &rcs]() {
+      int sockfd = acquire();
+      rcs[i] = (this->*fn)(sockfd, handle, offset + begin, data + begin,
+                           length);
+      release(sockfd);
+    }));
+  }
+
+  for (auto &t : threads)
+    t.join();
+
+  for (int32_t rc : rcs)
+    if (rc != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::write(uint64_t handle, uint64_t offset,
+                                 const void *data, uint64_t size) {
+  assert(size > 0);
+
+  return transfer(&SmartNICTransport::write_range, handle, offset,
+                  const_cast<char *>(static_cast<const char *>(data)), size);
+}
+
+int32_t SmartNICTransport::read(uint64_t handle, uint64_t offset, void *data,
+                                uint64_t size) {
+  assert(size > 0);
+
+  return transfer(&SmartNICTransport::read_range, handle, offset,
+                  static_cast<char *>(data), size);
+}
+
+int32_t SmartNICTransport::write_pipelined(int sockfd,
+                                           const BatchEntry *entries,
+                                           size_t num_entries) {
+  std::vector<uint32_t> request_ids(num_entries);
+  FrameHeader ack;
+
+  // Buffers fit in two windows, the server does not wait for the client to
+  // read acknowledgements before taking the next request.
+  for (size_t i = 0; i < num_entries; i++) {
+    request_ids[i] = this->next_request_id++;
+    if (send_header(sockfd, SMARTNIC_WRITE, request_ids[i], entries[i].handle,
+                    entries[i].offset, entries[i].size) != OFFLOAD_SUCCESS ||
+        send_all(sockfd, entries[i].data, entries[i].size) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+  }
+
+  for (size_t i = 0; i < num_entries; i++) {
+    do {
+      if (recv_header(sockfd, ack, SMARTNIC_ACK, request_ids[i]) !=
+          OFFLOAD_SUCCESS)
+        return OFFLOAD_FAIL;
+    } while (ack.Length < entries[i].size);
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::read_pipelined(int sockfd,
+                                          const BatchEntry *entries,
+                                          size_t num_entries) {
+  std::vector<uint32_t> request_ids(num_entries);
+  FrameHeader answer;
+
+  for (size_t i = 0; i < num_entries; i++) {
+    request_ids[i] = this->next_request_id++;
+    if (send_header(sockfd, SMARTNIC_READ, request_ids[i], entries[i].handle,
+                    entries[i].offset, entries[i].size) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+  }
+
+  // The server answers the requests of a connection in order
+  for (size_t i = 0; i < num_entries; i++) {
+    if (recv_header(sockfd, answer, SMARTNIC_DATA, request_ids[i]) !=
+        OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+
+    if (answer.Length != entries[i].size) {
+      DP("[smartnic] error - received %" PRIu64 " bytes instead of %" PRIu64
+         "\n", answer.Length, entries[i].size);
+      return OFFLOAD_FAIL;
+    }
+
+    if (recv_all(sockfd, entries[i].data, entries[i].size) != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::batch(bool is_write,
+                                 const std::vector<BatchEntry> &entries) {
+  uint64_t window = (uint64_t)this->chunk_size * this->ack_interval;
+  size_t begin = 0;
+
+  while (begin < entries.size()) {
+    const BatchEntry &first = entries[begin];
+    if (first.size > 2 * window) {
+      int32_t rc = is_write ? write(first.handle, first.offset, first.data,
+                                    first.size)
+                            : read(first.handle, first.offset, first.data,
+                                   first.size);
+      if (rc != OFFLOAD_SUCCESS)
+        return OFFLOAD_FAIL;
+      begin++;
+      continue;
+    }
+
+    // Bound the number of requests in flight, so that unread answers do
+    // not fill the socket buffers
+    size_t end = begin;
+    while (end < entries.size() && entries[end].size <= 2 * window &&
+           end - begin < SMARTNIC_MAX_PIPELINED)
+      end++;
+
+    int sockfd = acquire();
+    int32_t rc = is_write ? write_pipelined(sockfd, &entries[begin],
+                                            end - begin)
+                          : read_pipelined(sockfd, &entries[begin],
+                                           end - begin);
+    release(sockfd);
+    if (rc != OFFLOAD_SUCCESS)
+      return OFFLOAD_FAIL;
+    begin = end;
+  }
+
+  return OFFLOAD_SUCCESS;
+}
+
+int32_t SmartNICTransport::write_batch(const std::vector<BatchEntry> &entries) {
+  return batch(true, entries);
+}
+
+int32_t SmartNICTransport::read_batch(const std::vector<BatchEntry> &entries) {
+  return batch(false, entries);
+}
+
+int32_t SmartNICTransport::call(uint8_t type, uint64_t handle,
+                                uint64_t offset, uint64_t length,
+                                const void *payload, FrameHeader *answer) {
+  uint32_t request_id = this->next_request_id++;
+  FrameHeader ack;
+  int32_t rc = OFFLOAD_FAIL;
+
+  memset(&ack, 0, sizeof(ack));
+  int sockfd = acquire();
+  if (send_header(sockfd, type, request_id, handle, offset, length) ==
+          OFFLOAD_SUCCESS &&
+      (!payload || send_all(sockfd, payload, length) == OFFLOAD_SUCCESS) &&
+      recv_header(sockfd, ack, SMARTNIC_ACK, request_id) == OFFLOAD_SUCCESS)
+    rc = OFFLOAD_SUCCESS;
+  release(sockfd);
+
+  if (answer)
+    *answer = ack;
+
+  return rc;
+}
@@ -0,0 +1,112 @@
+//===--- RTLs/smartnic/src/transport.h - SmartNIC connections ----- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.txt for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Pool of connections to the SmartNIC device server.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SMARTNIC_TRANSPORT_H_
+#define _SMARTNIC_TRANSPORT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "protocol.h"
+
+// Maximum number of requests of a batch sent on a connection before reading
+// their answers
+#define SMARTNIC_MAX_PIPELINED 64
+
+/// Buffer of a batched transfer
+struct BatchEntry {
+  uint64_t handle;
+  uint64_t offset;
+  char *data;
+  uint64_t size;
+};
+
+/// Class to handle the connections to the device server. Each request uses
+/// one connection of the pool, so that requests of several host threads are
+/// in flight at the same time. Large transfers are split in stripes sent
+/// concurrently over several connections.
+class SmartNICTransport {
+ private:
+  std::string host;
+  int portno;
+  int num_connections;
+  uint32_t chunk_size;
+  uint32_t ack_interval;
+  int conn_status;
+
+  std::vector<int> sockets;
+  std::vector<int> idle_sockets;
+  std::mutex pool_mtx;
+  std::condition_variable pool_cv;
+  std::atomic<uint32_t> next_request_id;
+
+  int acquire();
+  void release(int sockfd);
+
+  int32_t send_all(int sockfd, const void *data, size_t size);
+  int32_t recv_all(int sockfd, void *data, size_t size);
+  int32_t send_header(int sockfd, uint8_t type, uint32_t request_id,
+                      uint64_t handle, uint64_t offset, uint64_t length);
+  int32_t recv_header(int sockfd, FrameHeader &header, uint8_t type,
+                      uint32_t request_id);
+
+  int32_t write_range(int sockfd, uint64_t handle, uint64_t offset,
+                      char *data, uint64_t size);
+  int32_t read_range(int sockfd, uint64_t handle, uint64_t offset,
+                     char *data, uint64_t size);
+
+  int32_t write_pipelined(int sockfd, const BatchEntry *entries,
+                          size_t num_entries);
+  int32_t read_pipelined(int sockfd, const BatchEntry *entries,
+                         size_t num_entries);
+  int32_t batch(bool is_write, const std::vector<BatchEntry> &entries);
+
+  typedef int32_t (SmartNICTransport::*RangeFnTy)(int, uint64_t, uint64_t,
+                                                  char *, uint64_t);
+  int32_t transfer(RangeFnTy fn, uint64_t handle, uint64_t offset, char *data,
+                   uint64_t size);
+
+ public:
+  SmartNICTransport(const std::string &host, int portno, int num_connections,
+                    uint32_t chunk_size, uint32_t ack_interval);
+  ~SmartNICTransport();
+
+  // Open the connections, return 0 on success
+  int conn();
+  int get_conn_status() { return conn_status; }
+
+  int32_t write(uint64_t handle, uint64_t offset, const void *data,
+                uint64_t size);
+  int32_t read(uint64_t handle, uint64_t offset, void *data, uint64_t size);
+
+  // Transfer several buffers in order. Consecutive buffers of at most two
+  // windows are pipelined on one connection, without waiting for each
+  // other's acknowledgement; larger ones are striped as single transfers.
+  int32_t write_batch(const std::vector<BatchEntry> &entries);
+  int32_t read_batch(const std::vector<BatchEntry> &entries);
+
+  // Send a request, followed by length bytes of payload if not null, and
+  // wait for its acknowledgement, whose header is returned in answer if not
+  // null
+  int32_t call(uint8_t type, uint64_t handle, uint64_t offset,
+               uint64_t length, const void *payload = nullptr,
+               FrameHeader *answer = nullptr);
+
+  void disconnect();
+};
+
+#endif // _SMARTNIC_TRANSPORT_H_
@@ -0,0 +1,295 @@
+//===------------- bench.cpp - SmartNIC transport benchmark ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.txt for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Check the SmartNIC transport against the loopback server and report its
+// throughput for several numbers of connections and acknowledgement
+// intervals, then check batched transfers against single ones, and that
+// modules are cached by the server and kernels are launched with their
+// module loaded. Usage:
+//   smartnic-bench <smartnic-loopback-server> [size in MB]
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "transport.h"
+
+static uint64_t alloc(SmartNICTransport &transport, uint64_t size) {
+  FrameHeader answer;
+  if (transport.call(SMARTNIC_ALLOC, 0, 0, size, nullptr, &answer) != 0)
+    return 0;
+  return answer.Handle;
+}
+
+static bool check(SmartNICTransport &transport, std::vector<char> &in,
+                  std::vector<char> &out, double &write_s, double &read_s) {
+  uint64_t handle = alloc(transport, in.size());
+  if (!handle)
+    return false;
+
+  auto start = std::chrono::steady_clock::now();
+  if (transport.write(handle, 0, in.data(), in.size()) != 0)
+    return false;
+  auto mid = std::chrono::steady_clock::now();
+  if (transport.read(handle, 0, out.data(), out.size()) != 0)
+    return false;
+  auto end = std::chrono::steady_clock::now();
+
+  write_s = std::chrono::duration<double>(mid - start).count();
+  read_s = std::chrono::duration<double>(end - mid).count();
+  if (in != out)
+    return false;
+
+  // A section of the buffer is addressed by its offset
+  uint64_t offset = in.size() / 3;
+  std::vector<char> section(4096, 'x'), back(4096);
+  if (transport.write(handle, offset, section.data(), section.size()) != 0 ||
+      transport.read(handle, offset, back.data(), back.size()) != 0 ||
+      section != back ||
+      transport.read(handle, 0, out.data(), out.size()) != 0 ||
+      !std::equal(in.begin(), in.begin() + offset, out.begin()))
+    return false;
+
+  // Released buffers and out of bounds accesses are rejected
+  if (transport.read(handle, in.size(), back.data(), 1) == 0 ||
+      transport.call(SMARTNIC_FREE, handle, 0, 0) != 0 ||
+      transport.read(handle, 0, back.data(), 1) == 0)
+    return false;
+
+  return true;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static bool check_batch(SmartNICTransport &transport, uint64_t large_size) {
+  const int num_small = 256;
+  const uint64_t small_size = 1024;
+
+  uint64_t handle = alloc(transport, num_small * small_size);
+  uint64_t large_handle = alloc(transport, large_size);
+  if (!handle || !large_handle)
+    return false;
+
+  std::vector<char> in(num_small * small_size), out(in.size());
+  std::vector<char> large_in(large_size), large_out(large_size);
+  for (size_t i = 0; i < in.size(); i++)
+    in[i] = (char)(i * 7 + 1);
+  for (size_t i = 0; i < large_in.size(); i++)
+    large_in[i] = (char)(i * 13 + 5);
+
+  // Small buffers around a large one, then a write overlapping the first
+  // buffer, which must land after it
+  char patch[8] = {'p', 'a', 't', 'c', 'h', 'e', 'd', '!'};
+  std::vector<BatchEntry> writes, reads;
+  for (int i = 0; i < num_small; i++) {
+    if (i == num_small / 2) {
+      writes.push_back({large_handle, 0, large_in.data(), large_size});
+      reads.push_back({large_handle, 0, large_out.data(), large_size});
+    }
+    writes.push_back(
+        {handle, i * small_size, &in[i * small_size], small_size});
+    reads.push_back(
+        {handle, i * small_size, &out[i * small_size], small_size});
+  }
+  writes.push_back({handle, 8, patch, sizeof(patch)});
+  memcpy(&in[8], patch, sizeof(patch));
+
+  if (transport.write_batch(writes) != 0 || transport.read_batch(reads) != 0 ||
+      in != out || large_in != large_out)
+    return false;
+
+  // One request per buffer, waiting for each answer, against the batch
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_small; i++)
+    if (transport.write(handle, i * small_size, &in[i * small_size],
+                        small_size) != 0)
+      return false;
+  double single_s = seconds_since(start);
+
+  writes.clear();
+  for (int i = 0; i < num_small; i++)
+    writes.push_back(
+        {handle, i * small_size, &in[i * small_size], small_size});
+  start = std::chrono::steady_clock::now();
+  if (transport.write_batch(writes) != 0)
+    return false;
+  double batch_s = seconds_since(start);
+
+  printf("%d writes of %" PRIu64 " bytes: %.1f us one by one, %.1f us "
+         "batched\n", num_small, small_size, single_s * 1e6, batch_s * 1e6);
+
+  return transport.call(SMARTNIC_FREE, handle, 0, 0) == 0 &&
+         transport.call(SMARTNIC_FREE, large_handle, 0, 0) == 0;
+}
+
+static int32_t program(SmartNICTransport &transport, const std::string &module,
+                       bool &uploaded) {
+  uint64_t hash = smartnic_module_hash(module.data(), module.size());
+  FrameHeader answer;
+
+  uploaded = false;
+  if (transport.call(SMARTNIC_PROGRAM, hash, 0, 0, nullptr, &answer) == 0)
+    return 0;
+  if (answer.Status != SMARTNIC_UNKNOWN_MODULE)
+    return 1;
+  uploaded = true;
+  return transport.call(SMARTNIC_PROGRAM, hash, 0, module.size(),
+                        module.data());
+}
+
+static int32_t launch(SmartNICTransport &transport, const std::string &module,
+                      const std::vector<LaunchArg> &args) {
+  std::vector<char> payload(sizeof(LaunchArgsHeader) +
+                            args.size() * sizeof(LaunchArg));
+  LaunchArgsHeader header = {1, 1, 0, args.size()};
+  memcpy(payload.data(), &header, sizeof(header));
+  memcpy(payload.data() + sizeof(header), args.data(),
+         args.size() * sizeof(LaunchArg));
+  return transport.call(SMARTNIC_LAUNCH, 0,
+                        smartnic_module_hash(module.data(), module.size()),
+                        payload.size(), payload.data());
+}
+
+static bool check_launch(SmartNICTransport &transport) {
+  std::string modules[] = {"kernel_a.bit", "kernel_b.bit"};
+  bool uploaded;
+
+  uint64_t handle = alloc(transport, 1024);
+  std::vector<LaunchArg> args = {
+      {(uint64_t)(uintptr_t)smartnic_target_ptr(handle, 512), 512}, {42, 0}};
+
+  // Modules are uploaded once, then loaded by hash
+  for (int i = 0; i < 4; i++) {
+    const std::string &module = modules[i % 2];
+    if (program(transport, module, uploaded) != 0 || uploaded != (i < 2) ||
+        launch(transport, module, args) != 0)
+      return false;
+  }
+
+  // Launches of a module not loaded or out of their buffer are rejected
+  std::vector<LaunchArg> bad_args = {
+      {(uint64_t)(uintptr_t)smartnic_target_ptr(handle, 512), 1024}};
+  if (launch(transport, modules[0], args) == 0 ||
+      launch(transport, modules[1], bad_args) == 0)
+    return false;
+
+  return transport.call(SMARTNIC_FREE, handle, 0, 0) == 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <loopback-server> [size in MB]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  uint64_t size = (argc > 2 ? atoll(argv[2]) : 64) << 20;
+  int portno = SMARTNIC_DEFAULT_PORT + getpid() % 1000;
+  std::string port = std::to_string(portno);
+
+  pid_t server = fork();
+  if (server == 0) {
+    execl(argv[1], argv[1], port.c_str(), (char *)nullptr);
+    _exit(127);
+  }
+
+  std::vector<char> in(size), out(size);
+  for (uint64_t i = 0; i < size; i++)
+    in[i] = (char)(i * 2654435761u >> 24);
+
+  struct Config {
+    int connections;
+    uint32_t ack_interval;
+  } configs[] = {{1, 1}, {1, 8}, {4, 8}};
+
+  int rc = EXIT_SUCCESS;
+  printf("%-12s %-12s %12s %12s\n", "connections", "ack-interval",
+         "write MB/s", "read MB/s");
+
+  for (const Config &c : configs) {
+    SmartNICTransport transport(SMARTNIC_DEFAULT_HOST, portno, c.connections,
+                                SMARTNIC_DEFAULT_CHUNK_SIZE, c.ack_interval);
+
+    // Wait for the server to listen
+    for (int i = 0; i < 100 && transport.conn() != 0; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (transport.get_conn_status() != 0) {
+      fprintf(stderr, "smartnic-bench: cannot connect to the server\n");
+      rc = EXIT_FAILURE;
+      break;
+    }
+
+    double write_s, read_s;
+    std::fill(out.begin(), out.end(), 0);
+    if (!check(transport, in, out, write_s, read_s)) {
+      fprintf(stderr, "smartnic-bench: data mismatch\n");
+      rc = EXIT_FAILURE;
+      break;
+    }
+
+    // Small requests of several threads share the pool
+    std::vector<std::thread> threads;
+    std::vector<int> ok(8, 0);
+    for (int t = 0; t < 8; t++)
+      threads.push_back(std::thread([&, t]() {
+        std::vector<char> small(4096, (char)t), back(4096);
+        uint64_t handle = alloc(transport, small.size());
+        ok[t] = handle &&
+                transport.write(handle, 0, small.data(), small.size()) == 0 &&
+                transport.read(handle, 0, back.data(), back.size()) == 0 &&
+                small == back &&
+                transport.call(SMARTNIC_FREE, handle, 0, 0) == 0;
+      }));
+    for (auto &t : threads)
+      t.join();
+    for (int v : ok)
+      if (!v) {
+        fprintf(stderr, "smartnic-bench: concurrent requests failed\n");
+        rc = EXIT_FAILURE;
+      }
+
+    printf("%-12d %-12u %12.1f %12.1f\n", c.connections, c.ack_interval,
+           size / 1048576.0 / write_s, size / 1048576.0 / read_s);
+  }
+
+  if (rc == EXIT_SUCCESS) {
+    SmartNICTransport transport(SMARTNIC_DEFAULT_HOST, portno, 1,
+                                SMARTNIC_DEFAULT_CHUNK_SIZE,
+                                SMARTNIC_DEFAULT_ACK_INTERVAL);
+    if (transport.conn() != 0) {
+      fprintf(stderr, "smartnic-bench: cannot connect to the server\n");
+      rc = EXIT_FAILURE;
+    } else if (!check_batch(transport, std::min<uint64_t>(size, 8 << 20))) {
+      fprintf(stderr, "smartnic-bench: batched transfers failed\n");
+      rc = EXIT_FAILURE;
+    } else if (!check_launch(transport)) {
+      fprintf(stderr, "smartnic-bench: programming or launch failed\n");
+      rc = EXIT_FAILURE;
+    }
+  }
+
+  kill(server, SIGTERM);
+  waitpid(server, nullptr, 0);
+
+  return rc;
+}
@@ -0,0 +1,279 @@
+//===------- loopback-server.cpp - SmartNIC device server stand-in --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.txt for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Stand-in of the SmartNIC device server speaking the protocol of protocol.h.
+// Device buffers are allocated in host memory, programming the device only
+// records the loaded module and launching a kernel checks its module and
+// arguments, so that the plugin and its transport can be tested and
+// benchmarked without the hardware. Usage:
+//   smartnic-loopback-server [port]
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "protocol.h"
+
+typedef std::shared_ptr<std::vector<char>> BufferTy;
+
+static std::map<uint64_t, BufferTy> Buffers;
+static uint64_t NextHandle = 1;
+static std::mutex BuffersMtx;
+
+// Modules received so far by hash, and the loaded one
+static std::map<uint64_t, std::vector<char>> Modules;
+static uint64_t LoadedModule;
+static bool Loaded = false;
+static std::mutex ModulesMtx;
+
+// Return the buffer if [offset, offset + length) lies in it
+static BufferTy find_buffer(uint64_t handle, uint64_t offset,
+                            uint64_t length) {
+  std::lock_guard<std::mutex> lock(BuffersMtx);
+  auto it = Buffers.find(handle);
+  if (it == Buffers.end() || offset > it->second->size() ||
+      length > it->second->size() - offset)
+    return nullptr;
+  return it->second;
+}
+
+static bool send_all(int sockfd, const void *data, size_t size) {
+  const char *ptr = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t sent = send(sockfd, ptr, size, MSG_NOSIGNAL);
+    if (sent <= 0)
+      return false;
+    ptr += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+static bool recv_all(int sockfd, void *data, size_t size) {
+  char *ptr = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t recv_bytes = recv(sockfd, ptr, size, 0);
+    if (recv_bytes <= 0)
+      return false;
+    ptr += recv_bytes;
+    size -= recv_bytes;
+  }
+  return true;
+}
+
+static bool answer(int sockfd, const FrameHeader &request, uint8_t type,
+                   uint8_t status, uint64_t length) {
+  FrameHeader header = request;
+  header.Type = type;
+  header.Status = status;
+  header.Length = length;
+  return send_all(sockfd, &header, sizeof(header));
+}
+
+static bool handle_write(int sockfd, const FrameHeader &request) {
+  uint64_t chunk_size = request.ChunkSize ? request.ChunkSize : request.Length;
+  uint32_t ack_interval = request.AckInterval ? request.AckInterval : 1;
+  BufferTy buffer = find_buffer(request.Handle, request.Offset, request.Length);
+  std::vector<char> discard;
+  uint64_t received = 0;
+  uint32_t chunks = 0;
+
+  // The payload is drained even if the request is invalid
+  if (!buffer)
+    discard.resize(chunk_size);
+
+  while (received < request.Length) {
+    uint64_t length = std::min(chunk_size, request.Length - received);
+    char *dst = buffer ? buffer->data() + request.Offset + received
+                       : discard.data();
+    if (!recv_all(sockfd, dst, length))
+      return false;
+
+    received += length;
+    if (++chunks % ack_interval == 0 || received == request.Length)
+      if (!answer(sockfd, request, SMARTNIC_ACK,
+                  buffer ? SMARTNIC_OK : SMARTNIC_ERROR, received))
+        return false;
+  }
+
+  return true;
+}
+
+static bool handle_read(int sockfd, const FrameHeader &request) {
+  BufferTy buffer = find_buffer(request.Handle, request.Offset, request.Length);
+  if (!buffer)
+    return answer(sockfd, request, SMARTNIC_DATA, SMARTNIC_ERROR, 0);
+
+  return answer(sockfd, request, SMARTNIC_DATA, SMARTNIC_OK, request.Length) &&
+         send_all(sockfd, buffer->data() + request.Offset, request.Length);
+}
+
+static bool handle_alloc(int sockfd, const FrameHeader &request) {
+  FrameHeader header = request;
+  if (request.Length == 0 || request.Length >= SMARTNIC_MAX_BUFFER_SIZE)
+    return answer(sockfd, request, SMARTNIC_ACK, SMARTNIC_ERROR, 0);
+
+  {
+    std::lock_guard<std::mutex> lock(BuffersMtx);
+    header.Handle = NextHandle++;
+    Buffers[header.Handle] = BufferTy(new std::vector<char>(request.Length));
+  }
+
+  return answer(sockfd, header, SMARTNIC_ACK, SMARTNIC_OK, request.Length);
+}
+
+static bool handle_free(int sockfd, const FrameHeader &request) {
+  size_t erased;
+  {
+    std::lock_guard<std::mutex> lock(BuffersMtx);
+    erased = Buffers.erase(request.Handle);
+  }
+
+  return answer(sockfd, request, SMARTNIC_ACK,
+                erased ? SMARTNIC_OK : SMARTNIC_ERROR, 0);
+}
+
+static bool handle_program(int sockfd, const FrameHeader &request) {
+  std::vector<char> payload(request.Length);
+  if (!recv_all(sockfd, payload.data(), payload.size()))
+    return false;
+
+  std::lock_guard<std::mutex> lock(ModulesMtx);
+  if (!payload.empty()) {
+    if (smartnic_module_hash(payload.data(), payload.size()) !=
+        request.Handle)
+      return answer(sockfd, request, SMARTNIC_ACK, SMARTNIC_ERROR, 0);
+    Modules[request.Handle] = payload;
+  } else if (!Modules.count(request.Handle)) {
+    return answer(sockfd, request, SMARTNIC_ACK, SMARTNIC_UNKNOWN_MODULE, 0);
+  }
+
+  LoadedModule = request.Handle;
+  Loaded = true;
+  return answer(sockfd, request, SMARTNIC_ACK, SMARTNIC_OK, request.Length);
+}
+
+static bool handle_launch(int sockfd, const FrameHeader &request) {
+  std::vector<char> payload(request.Length);
+  if (!recv_all(sockfd, payload.data(), payload.size()))
+    return false;
+
+  LaunchArgsHeader header;
+  bool valid = payload.size() >= sizeof(header);
+  if (valid) {
+    memcpy(&header, payload.data(), sizeof(header));
+    valid = payload.size() ==
+            sizeof(header) + header.NumArgs * sizeof(LaunchArg);
+  }
+
+  // Arguments of a mapped size must point in a live buffer
+  for (uint64_t i = 0; valid && i < header.NumArgs; i++) {
+    LaunchArg arg;
+    memcpy(&arg, payload.data() + sizeof(header) + i * sizeof(arg),
+           sizeof(arg));
+    void *ptr = (void *)(uintptr_t)arg.Value;
+    if (arg.Size > 0 &&
+        !find_buffer(smartnic_handle(ptr), smartnic_offset(ptr), arg.Size))
+      valid = false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(ModulesMtx);
+    valid = valid && Loaded && LoadedModule == request.Offset;
+  }
+
+  return answer(sockfd, request, SMARTNIC_ACK,
+                valid ? SMARTNIC_OK : SMARTNIC_ERROR, request.Length);
+}
+
+static void serve(int sockfd) {
+  FrameHeader request;
+  bool alive = true;
+
+  while (alive && recv_all(sockfd, &request, sizeof(request))) {
+    if (request.Magic != SMARTNIC_MAGIC ||
+        request.Version != SMARTNIC_VERSION) {
+      fprintf(stderr, "loopback-server: malformed request\n");
+      break;
+    }
+
+    switch (request.Type) {
+    case SMARTNIC_WRITE:
+      alive = handle_write(sockfd, request);
+      break;
+    case SMARTNIC_READ:
+      alive = handle_read(sockfd, request);
+      break;
+    case SMARTNIC_ALLOC:
+      alive = handle_alloc(sockfd, request);
+      break;
+    case SMARTNIC_FREE:
+      alive = handle_free(sockfd, request);
+      break;
+    case SMARTNIC_PROGRAM:
+      alive = handle_program(sockfd, request);
+      break;
+    case SMARTNIC_LAUNCH:
+      alive = handle_launch(sockfd, request);
+      break;
+    case SMARTNIC_QUIT:
+      alive = false;
+      break;
+    default:
+      fprintf(stderr, "loopback-server: unknown request '%c'\n", request.Type);
+      alive = false;
+      break;
+    }
+  }
+
+  close(sockfd);
+}
+
+int main(int argc, char **argv) {
+  int portno = argc > 1 ? atoi(argv[1]) : SMARTNIC_DEFAULT_PORT;
+
+  int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+  int flag = 1;
+  setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(portno);
+
+  if (bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listenfd, 64) < 0) {
+    perror("loopback-server");
+    return EXIT_FAILURE;
+  }
+
+  while (true) {
+    int sockfd = accept(listenfd, nullptr, nullptr);
+    if (sockfd < 0)
+      continue;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    std::thread(serve, sockfd).detach();
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -13,15 +13,22 @@
 //===----------------------------------------------------------------------===//
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cinttypes>
 #include <climits>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <iterator>
 #include <list>
 #include <map>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
+#include <pthread.h>
 
 // Header file global to this project
 #include "omptarget.h"
@@ -42,6 +49,23 @@ static int DebugLevel = 0;
 #define INF_REF_CNT (LONG_MAX>>1) // leave room for additions/subtractions
 #define CONSIDERED_INF(x) (x > (INF_REF_CNT>>1))
 
+/// Reader/writer lock: lookups hold it shared, updates of the structure
+/// hold it exclusive.
+class RWMutexTy {
+  pthread_rwlock_t RWLock;
+
+public:
+  RWMutexTy() { pthread_rwlock_init(&RWLock, NULL); }
+  ~RWMutexTy() { pthread_rwlock_destroy(&RWLock); }
+  RWMutexTy(const RWMutexTy &) = delete;
+  RWMutexTy &operator=(const RWMutexTy &) = delete;
+
+  void lock() { pthread_rwlock_wrlock(&RWLock); }
+  void unlock() { pthread_rwlock_unlock(&RWLock); }
+  void lock_shared() { pthread_rwlock_rdlock(&RWLock); }
+  void unlock_shared() { pthread_rwlock_unlock(&RWLock); }
+};
+
 // user could choose always the same device even if the number
 // of devices change.
 enum StaticDeviceId {
@@ -66,7 +90,18 @@ static const char *RTLNames[] = {
 struct RTLInfoTy;
 static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
     void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types,
-    int32_t team_num, int32_t thread_limit, int IsTeamConstruct);
+    int32_t team_num, int32_t thread_limit, int IsTeamConstruct,
+    uint64_t loop_tripcount);
+static int target_teams(int64_t device_id, void *host_ptr, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types,
+    int32_t team_num, int32_t thread_limit, uint64_t loop_tripcount);
+static uint64_t pop_loop_tripcount(int64_t device_id);
+static int data_begin_on_device(int64_t device_id, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types);
+static int data_end_on_device(int64_t device_id, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types);
+static int data_update_on_device(int64_t device_id, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types);
 
 /// All begin addresses must be 8-aligned
 static const int64_t alignment = 8;
@@ -79,7 +114,9 @@ struct HostDataToTargetTy {
 
   uintptr_t TgtPtrBegin; // target info.
 
-  long RefCount;
+  // Updated under the shared lock of the map, only its removal needs the
+  // exclusive lock.
+  std::atomic<long> RefCount;
 
   HostDataToTargetTy()
       : HstPtrBase(0), HstPtrBegin(0), HstPtrEnd(0),
@@ -91,9 +128,25 @@ struct HostDataToTargetTy {
       long RF)
       : HstPtrBase(BP), HstPtrBegin(B), HstPtrEnd(E),
         TgtPtrBegin(TB), RefCount(RF) {}
+  HostDataToTargetTy(const HostDataToTargetTy &d)
+      : HstPtrBase(d.HstPtrBase), HstPtrBegin(d.HstPtrBegin),
+        HstPtrEnd(d.HstPtrEnd), TgtPtrBegin(d.TgtPtrBegin),
+        RefCount(d.RefCount.load()) {}
+
+  HostDataToTargetTy& operator=(const HostDataToTargetTy &d) {
+    HstPtrBase = d.HstPtrBase;
+    HstPtrBegin = d.HstPtrBegin;
+    HstPtrEnd = d.HstPtrEnd;
+    TgtPtrBegin = d.TgtPtrBegin;
+    RefCount = d.RefCount.load();
+
+    return *this;
+  }
 };
 
-typedef std::list<HostDataToTargetTy> HostDataToTargetListTy;
+/// Mappings ordered by host begin address. Mapped ranges do not overlap, so
+/// the mapping containing an address is the last one beginning at or before it.
+typedef std::map<uintptr_t, HostDataToTargetTy> HostDataToTargetMapTy;
 
 struct LookupResult {
   struct {
@@ -102,7 +155,7 @@ struct LookupResult {
     unsigned ExtendsAfter  : 1;
   } Flags;
 
-  HostDataToTargetListTy::iterator Entry;
+  HostDataToTargetMapTy::iterator Entry;
 
   LookupResult() : Flags({0,0,0}), Entry() {}
 };
@@ -115,6 +168,165 @@ struct ShadowPtrValTy {
 };
 typedef std::map<void *, ShadowPtrValTy> ShadowPtrListTy;
 
+/// Transfers of a construct in one direction, done at once. The host buffers
+/// must stay valid until then.
+struct TransferBatchTy {
+  std::vector<void *> TgtPtrs;
+  std::vector<void *> HstPtrs;
+  std::vector<int64_t> Sizes;
+  // Contiguous transfers are only merged when the target pointers are real
+  // addresses, see RTLInfoTy::RealDevicePtrs.
+  bool Merge;
+
+  explicit TransferBatchTy(bool Merge) : Merge(Merge) {}
+
+  void add(void *TgtPtr, void *HstPtr, int64_t Size) {
+    // A transfer contiguous to the previous one on both sides extends it,
+    // e.g. adjacent sections of a coalesced mapping.
+    if (Merge && !Sizes.empty()) {
+      char *Tgt = (char *)TgtPtrs.back(), *Hst = (char *)HstPtrs.back();
+      if (Tgt + Sizes.back() == TgtPtr && Hst + Sizes.back() == HstPtr) {
+        Sizes.back() += Size;
+        return;
+      }
+      if ((char *)TgtPtr + Size == Tgt && (char *)HstPtr + Size == Hst) {
+        TgtPtrs.back() = TgtPtr;
+        HstPtrs.back() = HstPtr;
+        Sizes.back() += Size;
+        return;
+      }
+    }
+    TgtPtrs.push_back(TgtPtr);
+    HstPtrs.push_back(HstPtr);
+    Sizes.push_back(Size);
+  }
+  bool empty() const { return Sizes.empty(); }
+  void clear() {
+    TgtPtrs.clear();
+    HstPtrs.clear();
+    Sizes.clear();
+  }
+};
+
+/// Pointer values to write on the device. They are gathered in one update
+/// buffer, the values of consecutive target pointers are transferred at once.
+struct PtrUpdateListTy {
+  std::vector<std::pair<uintptr_t, void *>> Updates; // target address, value
+  std::vector<void *> Vals; // update buffer, must outlive the transfers
+
+  void add(void *TgtPtrAddr, void *TgtPtrVal) {
+    Updates.push_back(std::make_pair((uintptr_t)TgtPtrAddr, TgtPtrVal));
+  }
+
+  /// Fill the update buffer and add its runs to Batch.
+  void flush(TransferBatchTy &Batch) {
+    if (Updates.empty())
+      return;
+    // Later updates of the same pointer win.
+    std::stable_sort(Updates.begin(), Updates.end(),
+        [](const std::pair<uintptr_t, void *> &A,
+           const std::pair<uintptr_t, void *> &B) {
+          return A.first < B.first;
+        });
+    Vals.clear();
+    Vals.reserve(Updates.size());
+    std::vector<std::pair<uintptr_t, size_t>> Runs; // target begin, first val
+    for (size_t i = 0; i < Updates.size(); ++i) {
+      uintptr_t Addr = Updates[i].first;
+      if (i > 0 && Addr == Updates[i - 1].first) {
+        Vals.back() = Updates[i].second;
+        continue;
+      }
+      if (Runs.empty() || Addr != Updates[i - 1].first + sizeof(void *))
+        Runs.push_back(std::make_pair(Addr, Vals.size()));
+      Vals.push_back(Updates[i].second);
+    }
+    for (size_t r = 0; r < Runs.size(); ++r) {
+      size_t End = r + 1 < Runs.size() ? Runs[r + 1].second : Vals.size();
+      Batch.add((void *)Runs[r].first, &Vals[Runs[r].second],
+          (End - Runs[r].second) * sizeof(void *));
+    }
+    Updates.clear();
+  }
+};
+
+/// Cache of device blocks released by deallocTgtPtr, binned by size class so
+/// that a later mapping of a similar size reuses them instead of calling the
+/// RTL. Only used with RTLs which return real device pointers.
+class MemoryPoolTy {
+  std::mutex Mtx;
+  // Free blocks, keyed by their size class.
+  std::map<int64_t, std::vector<void *>> Bins;
+  int64_t CachedBytes;
+
+public:
+  uint64_t NumAllocs;   // allocations requested through the pool
+  uint64_t NumReuses;   // of which served from a bin
+  uint64_t NumReleases; // blocks given back to the RTL
+
+  MemoryPoolTy() : Mtx(), Bins(), CachedBytes(0), NumAllocs(0), NumReuses(0),
+      NumReleases(0) {}
+  // Copies start empty, the blocks belong to the original device.
+  MemoryPoolTy(const MemoryPoolTy &) : MemoryPoolTy() {}
+  MemoryPoolTy &operator=(const MemoryPoolTy &) { return *this; }
+
+  /// Smallest class is 256 bytes, then four classes per power of two so that
+  /// at most a quarter of a block is wasted.
+  static int64_t classSize(int64_t Size) {
+    if (Size <= 256)
+      return 256;
+    int64_t Pow = 256;
+    while (Pow <= Size / 2)
+      Pow *= 2;
+    int64_t Step = Pow / 4;
+    return (Size + Step - 1) / Step * Step;
+  }
+
+  /// Take a cached block of class ClassSize, NULL if the bin is empty.
+  void *get(int64_t ClassSize) {
+    std::lock_guard<std::mutex> lock(Mtx);
+    ++NumAllocs;
+    auto Bin = Bins.find(ClassSize);
+    if (Bin == Bins.end() || Bin->second.empty())
+      return NULL;
+    void *Ptr = Bin->second.back();
+    Bin->second.pop_back();
+    CachedBytes -= ClassSize;
+    ++NumReuses;
+    return Ptr;
+  }
+
+  /// Cache a block of class ClassSize. Return false if it would exceed Limit,
+  /// the caller must then release it.
+  bool put(void *Ptr, int64_t ClassSize, int64_t Limit) {
+    std::lock_guard<std::mutex> lock(Mtx);
+    if (CachedBytes + ClassSize > Limit) {
+      ++NumReleases;
+      return false;
+    }
+    Bins[ClassSize].push_back(Ptr);
+    CachedBytes += ClassSize;
+    return true;
+  }
+
+  /// Empty all bins, the blocks are appended to Blocks for the caller to
+  /// release.
+  void trim(std::vector<void *> &Blocks) {
+    std::lock_guard<std::mutex> lock(Mtx);
+    for (auto &Bin : Bins) {
+      Blocks.insert(Blocks.end(), Bin.second.begin(), Bin.second.end());
+      NumReleases += Bin.second.size();
+    }
+    Bins.clear();
+    CachedBytes = 0;
+  }
+};
+
+/// Upper bound of the bytes cached per device, 0 disables the pool. Set from
+/// LIBOMPTARGET_MEMORY_POOL_LIMIT (in MB) when loading the RTLs.
+static int64_t MemoryPoolLimit = 256 << 20;
+static bool MemoryPoolStats = false;
+
 ///
 struct PendingCtorDtorListsTy {
   std::list<void *> PendingCtors;
@@ -132,20 +344,32 @@ struct DeviceTy {
   std::once_flag InitFlag;
   bool HasPendingGlobals;
 
-  HostDataToTargetListTy HostDataToTargetMap;
+  HostDataToTargetMapTy HostDataToTargetMap;
   PendingCtorsDtorsPerLibrary PendingCtorsDtors;
 
   ShadowPtrListTy ShadowPtrMap;
 
-  std::mutex DataMapMtx, PendingGlobalsMtx, ShadowMtx;
+  RWMutexTy DataMapMtx;
+  std::mutex PendingGlobalsMtx;
+  RWMutexTy ShadowMtx;
 
   uint64_t loopTripCnt;
 
+  MemoryPoolTy MemoryPool;
+
+  // Target blocks shared by the mappings of coalesced sections, by target
+  // begin address. Guarded by DataMapMtx.
+  struct SharedBlockTy {
+    int64_t Size;
+    int32_t NumMappings; // mappings left in the block
+  };
+  std::map<uintptr_t, SharedBlockTy> SharedBlocks;
+
   DeviceTy(RTLInfoTy *RTL)
       : DeviceID(-1), RTL(RTL), RTLDeviceID(-1), IsInit(false), InitFlag(),
         HasPendingGlobals(false), HostDataToTargetMap(),
         PendingCtorsDtors(), ShadowPtrMap(), DataMapMtx(), PendingGlobalsMtx(),
-        ShadowMtx(), loopTripCnt(0) {}
+        ShadowMtx(), loopTripCnt(0), MemoryPool(), SharedBlocks() {}
 
   // The existence of mutexes makes DeviceTy non-copyable. We need to
   // provide a copy constructor and an assignment operator explicitly.
@@ -155,7 +379,8 @@ struct DeviceTy {
         HostDataToTargetMap(d.HostDataToTargetMap),
         PendingCtorsDtors(d.PendingCtorsDtors), ShadowPtrMap(d.ShadowPtrMap),
         DataMapMtx(), PendingGlobalsMtx(),
-        ShadowMtx(), loopTripCnt(d.loopTripCnt) {}
+        ShadowMtx(), loopTripCnt(d.loopTripCnt), MemoryPool(),
+        SharedBlocks(d.SharedBlocks) {}
 
   DeviceTy& operator=(const DeviceTy &d) {
     DeviceID = d.DeviceID;
@@ -167,6 +392,7 @@ struct DeviceTy {
     PendingCtorsDtors = d.PendingCtorsDtors;
     ShadowPtrMap = d.ShadowPtrMap;
     loopTripCnt = d.loopTripCnt;
+    SharedBlocks = d.SharedBlocks;
 
     return *this;
   }
@@ -175,6 +401,8 @@ struct DeviceTy {
   LookupResult lookupMapping(void *HstPtrBegin, int64_t Size);
   void *getOrAllocTgtPtr(void *HstPtrBegin, void *HstPtrBase, int64_t Size,
       int64_t Type, bool &IsNew, bool IsImplicit, bool UpdateRefCount = true);
+  bool allocCoalescedTgtPtrs(const std::vector<int32_t> &Sections,
+      void **HstPtrBases, void **HstPtrBegins, int64_t *Sizes, int64_t Type);
   void *getTgtPtrBegin(void *HstPtrBegin, int64_t Size);
   void *getTgtPtrBegin(void *HstPtrBegin, int64_t Size, bool &IsLast,
       bool UpdateRefCount);
@@ -182,18 +410,44 @@ struct DeviceTy {
   int associatePtr(void *HstPtrBegin, void *TgtPtrBegin, int64_t Size);
   int disassociatePtr(void *HstPtrBegin);
 
+  // Allocate and release the target memory of mappings, through MemoryPool
+  // if the RTL allows it.
+  void *allocData(int64_t Size, void *HstPtrBegin, int64_t Type);
+  void deleteData(void *TgtPtrBegin, int64_t Size);
+  // Release the target memory of a removed mapping, or its reference to a
+  // shared block.
+  void releaseTgtPtr(uintptr_t TgtPtrBegin, int64_t Size);
+  // Release the cached blocks of MemoryPool.
+  void trimMemoryPool();
+
   // calls to RTL
   int32_t initOnce();
   __tgt_target_table *load_binary(void *Img);
 
-  int32_t data_submit(void *TgtPtrBegin, void *HstPtrBegin, int64_t Size);
-  int32_t data_retrieve(void *HstPtrBegin, void *TgtPtrBegin, int64_t Size);
+  // The operations are queued in AsyncInfo if it is set and the RTL supports
+  // asynchronous operations, they are done before returning otherwise.
+  int32_t data_submit(void *TgtPtrBegin, void *HstPtrBegin, int64_t Size,
+      __tgt_async_info *AsyncInfo = NULL);
+  int32_t data_retrieve(void *HstPtrBegin, void *TgtPtrBegin, int64_t Size,
+      __tgt_async_info *AsyncInfo = NULL);
 
   int32_t run_region(void *TgtEntryPtr, void **TgtVarsPtr,
-      ptrdiff_t *TgtOffsets, int64_t *TgtVarsSize, int32_t NumTgtVars);
+      ptrdiff_t *TgtOffsets, int64_t *TgtVarsSize, int32_t NumTgtVars,
+      __tgt_async_info *AsyncInfo = NULL);
   int32_t run_team_region(void *TgtEntryPtr, void **TgtVarsPtr,
       ptrdiff_t *TgtOffsets, int64_t *TgtVarsSize, int32_t NumTgtVars,
-      int32_t NumTeams, int32_t ThreadLimit, uint64_t LoopTripCount);
+      int32_t NumTeams, int32_t ThreadLimit, uint64_t LoopTripCount,
+      __tgt_async_info *AsyncInfo = NULL);
+
+  // Do the transfers of Batch and clear it. They are queued in AsyncInfo as
+  // above, or done with one call to the RTL if it supports batches.
+  int32_t data_submit(TransferBatchTy &Batch,
+      __tgt_async_info *AsyncInfo = NULL);
+  int32_t data_retrieve(TransferBatchTy &Batch,
+      __tgt_async_info *AsyncInfo = NULL);
+
+  // Wait for the operations queued in AsyncInfo.
+  int32_t synchronize(__tgt_async_info *AsyncInfo);
 
 private:
   // Call to RTL
@@ -217,6 +471,20 @@ struct RTLInfoTy {
                                  int64_t *, int32_t);
   typedef int32_t(run_team_region_ty)(int32_t, void *, void **, ptrdiff_t *,
                                       int64_t *, int32_t, int32_t, int32_t, uint64_t);
+  typedef int32_t(data_submit_batch_ty)(int32_t, int32_t, void **, void **,
+                                        int64_t *);
+  typedef int32_t(data_retrieve_batch_ty)(int32_t, int32_t, void **, void **,
+                                          int64_t *);
+  typedef int32_t(data_submit_async_ty)(int32_t, void *, void *, int64_t,
+                                        __tgt_async_info *);
+  typedef int32_t(data_retrieve_async_ty)(int32_t, void *, void *, int64_t,
+                                          __tgt_async_info *);
+  typedef int32_t(run_team_region_async_ty)(int32_t, void *, void **,
+      ptrdiff_t *, int64_t *, int32_t, int32_t, int32_t, uint64_t,
+      __tgt_async_info *);
+  typedef int32_t(synchronize_ty)(int32_t, __tgt_async_info *);
+  typedef int32_t(query_async_ty)(int32_t, __tgt_async_info *);
+  typedef int32_t(has_real_device_ptrs_ty)();
 
   int32_t Idx;                     // RTL index, index is the number of devices
                                    // of other RTLs that were registered before,
@@ -229,6 +497,10 @@ struct RTLInfoTy {
 
   int staticDeviceId;
 
+  // The RTL returns real device pointers, its blocks can be reused for
+  // other mappings or shared between several ones.
+  bool RealDevicePtrs;
+
 #ifdef OMPTARGET_DEBUG
   std::string RTLName;
 #endif
@@ -245,6 +517,17 @@ struct RTLInfoTy {
   run_region_ty *run_region;
   run_team_region_ty *run_team_region;
 
+  // Optional batched transfers.
+  data_submit_batch_ty *data_submit_batch;
+  data_retrieve_batch_ty *data_retrieve_batch;
+
+  // Optional asynchronous functions, either all of them or none are set.
+  data_submit_async_ty *data_submit_async;
+  data_retrieve_async_ty *data_retrieve_async;
+  run_team_region_async_ty *run_team_region_async;
+  synchronize_ty *synchronize;
+  query_async_ty *query_async;
+
   // Are there images associated with this RTL.
   bool isUsed;
 
@@ -257,14 +540,16 @@ struct RTLInfoTy {
   // We need to provide a copy constructor explicitly.
   RTLInfoTy()
       : Idx(-1), NumberOfDevices(-1), Devices(), LibraryHandler(0),
-        staticDeviceId(-1),
+        staticDeviceId(-1), RealDevicePtrs(false),
 #ifdef OMPTARGET_DEBUG
         RTLName(),
 #endif
         is_valid_binary(0), number_of_devices(0), init_device(0),
         load_binary(0), data_alloc(0), data_submit(0), data_retrieve(0),
-        data_delete(0), run_region(0), run_team_region(0), isUsed(false),
-        Mtx() {}
+        data_delete(0), run_region(0), run_team_region(0),
+        data_submit_batch(0), data_retrieve_batch(0), data_submit_async(0),
+        data_retrieve_async(0), run_team_region_async(0), synchronize(0),
+        query_async(0), isUsed(false), Mtx() {}
 
   RTLInfoTy(const RTLInfoTy &r) : Mtx() {
     Idx = r.Idx;
@@ -272,6 +557,7 @@ struct RTLInfoTy {
     Devices = r.Devices;
     LibraryHandler = r.LibraryHandler;
     staticDeviceId = r.staticDeviceId;
+    RealDevicePtrs = r.RealDevicePtrs;
 #ifdef OMPTARGET_DEBUG
     RTLName = r.RTLName;
 #endif
@@ -285,6 +571,13 @@ struct RTLInfoTy {
     data_delete = r.data_delete;
     run_region = r.run_region;
     run_team_region = r.run_team_region;
+    data_submit_batch = r.data_submit_batch;
+    data_retrieve_batch = r.data_retrieve_batch;
+    data_submit_async = r.data_submit_async;
+    data_retrieve_async = r.data_retrieve_async;
+    run_team_region_async = r.run_team_region_async;
+    synchronize = r.synchronize;
+    query_async = r.query_async;
     isUsed = r.isUsed;
   }
 };
@@ -325,6 +618,11 @@ void RTLsTy::LoadRTLs() {
     return;
   }
 
+  if (char *envStr = getenv("LIBOMPTARGET_MEMORY_POOL_LIMIT"))
+    MemoryPoolLimit = std::max(0LL, atoll(envStr)) << 20;
+  if (getenv("LIBOMPTARGET_MEMORY_POOL_STATS"))
+    MemoryPoolStats = true;
+
   DP("Loading RTLs...\n");
 
   // Attempt to open all the plugins and, if they exist, check if the interface
@@ -388,6 +686,41 @@ void RTLsTy::LoadRTLs() {
               dynlib_handle, "__tgt_rtl_run_target_team_region")))
       continue;
 
+    // Optional functions, the transfers are done one by one if missing.
+    *((void**) &R.data_submit_batch) = dlsym(dynlib_handle,
+        "__tgt_rtl_data_submit_batch");
+    *((void**) &R.data_retrieve_batch) = dlsym(dynlib_handle,
+        "__tgt_rtl_data_retrieve_batch");
+
+    // Optional functions, the synchronous ones are used if any is missing.
+    *((void**) &R.data_submit_async) = dlsym(dynlib_handle,
+        "__tgt_rtl_data_submit_async");
+    *((void**) &R.data_retrieve_async) = dlsym(dynlib_handle,
+        "__tgt_rtl_data_retrieve_async");
+    *((void**) &R.run_team_region_async) = dlsym(dynlib_handle,
+        "__tgt_rtl_run_target_team_region_async");
+    *((void**) &R.synchronize) = dlsym(dynlib_handle,
+        "__tgt_rtl_synchronize");
+    *((void**) &R.query_async) = dlsym(dynlib_handle,
+        "__tgt_rtl_query_async");
+    if (!R.data_submit_async || !R.data_retrieve_async ||
+        !R.run_team_region_async || !R.synchronize || !R.query_async) {
+      R.data_submit_async = 0;
+      R.data_retrieve_async = 0;
+      R.run_team_region_async = 0;
+      R.synchronize = 0;
+      R.query_async = 0;
+    } else {
+      DP("RTL supports asynchronous operations\n");
+    }
+
+    // Optional function, the blocks of RTLs which encode handles in their
+    // pointers or keep metadata per allocation are neither reused nor shared.
+    RTLInfoTy::has_real_device_ptrs_ty *has_real_device_ptrs;
+    *((void**) &has_real_device_ptrs) = dlsym(dynlib_handle,
+        "__tgt_rtl_has_real_device_ptrs");
+    R.RealDevicePtrs = has_real_device_ptrs && has_real_device_ptrs();
+
     // No devices are supported by this RTL?
     if (!(R.NumberOfDevices = R.number_of_devices())) {
       DP("No devices supported in this RTL\n");
@@ -455,6 +788,20 @@ typedef std::map<void *, TableMap> HostPtrToTableMapTy;
 static HostPtrToTableMapTy HostPtrToTableMap;
 static std::mutex TblMapMtx;
 
+/// Incremented when a library is unregistered, to invalidate the launch caches
+/// of the host threads.
+static std::atomic<uint64_t> TblMapGeneration(0);
+
+/// Per-thread cache of the table map entry and of the target table of a host
+/// ptr on a device, so that repeated launches do not take the table locks.
+struct LaunchCacheTy {
+  uint64_t Generation;
+  std::map<std::pair<void *, int64_t>,
+      std::pair<TableMap *, __tgt_target_table *>> Entries;
+  LaunchCacheTy() : Generation(0), Entries() {}
+};
+static thread_local LaunchCacheTy LaunchCache;
+
 /// Check whether a device has an associated RTL and initialize it if it's not
 /// already initialized.
 static bool device_is_ready(int64_t device_num) {
@@ -767,42 +1114,33 @@ EXTERN int omp_target_disassociate_ptr(void *host_ptr, int device_num) {
 int DeviceTy::associatePtr(void *HstPtrBegin, void *TgtPtrBegin, int64_t Size) {
   DataMapMtx.lock();
 
-  // Check if entry exists
-  for (auto &HT : HostDataToTargetMap) {
-    if ((uintptr_t)HstPtrBegin == HT.HstPtrBegin) {
-      // Mapping already exists
-      bool isValid = HT.HstPtrBegin == (uintptr_t) HstPtrBegin &&
-                     HT.HstPtrEnd == (uintptr_t) HstPtrBegin + Size &&
-                     HT.TgtPtrBegin == (uintptr_t) TgtPtrBegin;
-      DataMapMtx.unlock();
-      if (isValid) {
-        DP("Attempt to re-associate the same device ptr+offset with the same "
-            "host ptr, nothing to do\n");
-        return OFFLOAD_SUCCESS;
-      } else {
-        DP("Not allowed to re-associate a different device ptr+offset with the "
-            "same host ptr\n");
-        return OFFLOAD_FAIL;
-      }
+  // Add the mapping, refCount must be infinite
+  auto Res = HostDataToTargetMap.insert(std::make_pair((uintptr_t)HstPtrBegin,
+      HostDataToTargetTy((uintptr_t)HstPtrBegin, (uintptr_t)HstPtrBegin,
+          (uintptr_t)HstPtrBegin + Size, (uintptr_t)TgtPtrBegin,
+          INF_REF_CNT)));
+  if (!Res.second) {
+    auto &HT = Res.first->second;
+    // Mapping already exists
+    bool isValid = HT.HstPtrBegin == (uintptr_t) HstPtrBegin &&
+                   HT.HstPtrEnd == (uintptr_t) HstPtrBegin + Size &&
+                   HT.TgtPtrBegin == (uintptr_t) TgtPtrBegin;
+    DataMapMtx.unlock();
+    if (isValid) {
+      DP("Attempt to re-associate the same device ptr+offset with the same "
+          "host ptr, nothing to do\n");
+      return OFFLOAD_SUCCESS;
+    } else {
+      DP("Not allowed to re-associate a different device ptr+offset with the "
+          "same host ptr\n");
+      return OFFLOAD_FAIL;
     }
   }
 
-  // Mapping does not exist, allocate it
-  HostDataToTargetTy newEntry;
-
-  // Set up missing fields
-  newEntry.HstPtrBase = (uintptr_t) HstPtrBegin;
-  newEntry.HstPtrBegin = (uintptr_t) HstPtrBegin;
-  newEntry.HstPtrEnd = (uintptr_t) HstPtrBegin + Size;
-  newEntry.TgtPtrBegin = (uintptr_t) TgtPtrBegin;
-  // refCount must be infinite
-  newEntry.RefCount = INF_REF_CNT;
-
   DP("Creating new map entry: HstBase=" DPxMOD ", HstBegin=" DPxMOD ", HstEnd="
-      DPxMOD ", TgtBegin=" DPxMOD "\n", DPxPTR(newEntry.HstPtrBase),
-      DPxPTR(newEntry.HstPtrBegin), DPxPTR(newEntry.HstPtrEnd),
-      DPxPTR(newEntry.TgtPtrBegin));
-  HostDataToTargetMap.push_front(newEntry);
+      DPxMOD ", TgtBegin=" DPxMOD "\n", DPxPTR(HstPtrBegin),
+      DPxPTR(HstPtrBegin), DPxPTR((uintptr_t)HstPtrBegin + Size),
+      DPxPTR(TgtPtrBegin));
 
   DataMapMtx.unlock();
 
@@ -813,20 +1151,17 @@ int DeviceTy::disassociatePtr(void *HstPtrBegin) {
   DataMapMtx.lock();
 
   // Check if entry exists
-  for (HostDataToTargetListTy::iterator ii = HostDataToTargetMap.begin();
-      ii != HostDataToTargetMap.end(); ++ii) {
-    if ((uintptr_t)HstPtrBegin == ii->HstPtrBegin) {
-      // Mapping exists
-      if (CONSIDERED_INF(ii->RefCount)) {
-        DP("Association found, removing it\n");
-        HostDataToTargetMap.erase(ii);
-        DataMapMtx.unlock();
-        return OFFLOAD_SUCCESS;
-      } else {
-        DP("Trying to disassociate a pointer which was not mapped via "
-            "omp_target_associate_ptr\n");
-        break;
-      }
+  auto It = HostDataToTargetMap.find((uintptr_t)HstPtrBegin);
+  if (It != HostDataToTargetMap.end()) {
+    // Mapping exists
+    if (CONSIDERED_INF(It->second.RefCount)) {
+      DP("Association found, removing it\n");
+      HostDataToTargetMap.erase(It);
+      DataMapMtx.unlock();
+      return OFFLOAD_SUCCESS;
+    } else {
+      DP("Trying to disassociate a pointer which was not mapped via "
+          "omp_target_associate_ptr\n");
     }
   }
 
@@ -838,18 +1173,15 @@ int DeviceTy::disassociatePtr(void *HstPtrBegin) {
 
 // Get ref count of map entry containing HstPtrBegin
 long DeviceTy::getMapEntryRefCnt(void *HstPtrBegin) {
-  uintptr_t hp = (uintptr_t)HstPtrBegin;
   long RefCnt = -1;
 
-  DataMapMtx.lock();
-  for (auto &HT : HostDataToTargetMap) {
-    if (hp >= HT.HstPtrBegin && hp < HT.HstPtrEnd) {
-      DP("DeviceTy::getMapEntry: requested entry found\n");
-      RefCnt = HT.RefCount;
-      break;
-    }
+  DataMapMtx.lock_shared();
+  LookupResult lr = lookupMapping(HstPtrBegin, 0);
+  if (lr.Flags.IsContained) {
+    DP("DeviceTy::getMapEntry: requested entry found\n");
+    RefCnt = lr.Entry->second.RefCount;
   }
-  DataMapMtx.unlock();
+  DataMapMtx.unlock_shared();
 
   if (RefCnt < 0) {
     DP("DeviceTy::getMapEntry: requested entry not found\n");
@@ -864,9 +1196,19 @@ LookupResult DeviceTy::lookupMapping(void *HstPtrBegin, int64_t Size) {
 
   DP("Looking up mapping(HstPtrBegin=" DPxMOD ", Size=%ld)...\n", DPxPTR(hp),
       Size);
-  for (lr.Entry = HostDataToTargetMap.begin();
-      lr.Entry != HostDataToTargetMap.end(); ++lr.Entry) {
-    auto &HT = *lr.Entry;
+
+  // Only the mapping beginning at or before hp may contain it, otherwise the
+  // first mapping beginning after hp is the only one the section may extend
+  // into first.
+  lr.Entry = HostDataToTargetMap.upper_bound(hp);
+  if (lr.Entry != HostDataToTargetMap.begin()) {
+    auto Prev = std::prev(lr.Entry);
+    if (hp < Prev->second.HstPtrEnd)
+      lr.Entry = Prev;
+  }
+
+  if (lr.Entry != HostDataToTargetMap.end()) {
+    auto &HT = lr.Entry->second;
     // Is it contained?
     lr.Flags.IsContained = hp >= HT.HstPtrBegin && hp < HT.HstPtrEnd &&
         (hp+Size) <= HT.HstPtrEnd;
@@ -874,11 +1216,6 @@ LookupResult DeviceTy::lookupMapping(void *HstPtrBegin, int64_t Size) {
     lr.Flags.ExtendsBefore = hp < HT.HstPtrBegin && (hp+Size) > HT.HstPtrBegin;
     // Does it extend beyond the mapped region?
     lr.Flags.ExtendsAfter = hp < HT.HstPtrEnd && (hp+Size) > HT.HstPtrEnd;
-
-    if (lr.Flags.IsContained || lr.Flags.ExtendsBefore ||
-        lr.Flags.ExtendsAfter) {
-      break;
-    }
   }
 
   if (lr.Flags.ExtendsBefore) {
@@ -903,13 +1240,24 @@ void *DeviceTy::getOrAllocTgtPtr(void *HstPtrBegin, void *HstPtrBase,
     int64_t Size, int64_t Type, bool &IsNew, bool IsImplicit,
     bool UpdateRefCount) {
   void *rc = NULL;
-  DataMapMtx.lock();
+  bool Exclusive = false;
+  DataMapMtx.lock_shared();
   LookupResult lr = lookupMapping(HstPtrBegin, Size);
 
+  // Adding a mapping needs the exclusive lock. The lookup is done again since
+  // another thread may have added it meanwhile.
+  if (!lr.Flags.IsContained && !lr.Flags.ExtendsBefore &&
+      !lr.Flags.ExtendsAfter && Size) {
+    DataMapMtx.unlock_shared();
+    DataMapMtx.lock();
+    Exclusive = true;
+    lr = lookupMapping(HstPtrBegin, Size);
+  }
+
   // Check if the pointer is contained.
   if (lr.Flags.IsContained ||
       ((lr.Flags.ExtendsBefore || lr.Flags.ExtendsAfter) && IsImplicit)) {
-    auto &HT = *lr.Entry;
+    auto &HT = lr.Entry->second;
     IsNew = false;
 
     if (UpdateRefCount)
@@ -929,17 +1277,30 @@ void *DeviceTy::getOrAllocTgtPtr(void *HstPtrBegin, void *HstPtrBase,
   } else if (Size) {
     // If it is not contained and Size > 0 we should create a new entry for it.
     IsNew = true;
-    uintptr_t tp = (uintptr_t)RTL->data_alloc(RTLDeviceID, Size, HstPtrBegin,
-        Type);
-    DP("Creating new map entry: HstBase=" DPxMOD ", HstBegin=" DPxMOD ", "
-        "HstEnd=" DPxMOD ", TgtBegin=" DPxMOD "\n", DPxPTR(HstPtrBase),
-        DPxPTR(HstPtrBegin), DPxPTR((uintptr_t)HstPtrBegin + Size), DPxPTR(tp));
-    HostDataToTargetMap.push_front(HostDataToTargetTy((uintptr_t)HstPtrBase,
-        (uintptr_t)HstPtrBegin, (uintptr_t)HstPtrBegin + Size, tp));
-    rc = (void *)tp;
+    auto Res = HostDataToTargetMap.insert(std::make_pair(
+        (uintptr_t)HstPtrBegin, HostDataToTargetTy((uintptr_t)HstPtrBase,
+            (uintptr_t)HstPtrBegin, (uintptr_t)HstPtrBegin + Size, 0)));
+    if (Res.second) {
+      uintptr_t tp = (uintptr_t)allocData(Size, HstPtrBegin, Type);
+      Res.first->second.TgtPtrBegin = tp;
+      DP("Creating new map entry: HstBase=" DPxMOD ", HstBegin=" DPxMOD ", "
+          "HstEnd=" DPxMOD ", TgtBegin=" DPxMOD "\n", DPxPTR(HstPtrBase),
+          DPxPTR(HstPtrBegin), DPxPTR((uintptr_t)HstPtrBegin + Size),
+          DPxPTR(tp));
+      rc = (void *)tp;
+    } else {
+      // The lookup skips a mapping of size 0, which can still begin at
+      // HstPtrBegin. It is not replaced.
+      IsNew = false;
+      DP("A mapping of size 0 already begins at HstPtrBegin=" DPxMOD "\n",
+          DPxPTR(HstPtrBegin));
+    }
   }
 
-  DataMapMtx.unlock();
+  if (Exclusive)
+    DataMapMtx.unlock();
+  else
+    DataMapMtx.unlock_shared();
   return rc;
 }
 
@@ -949,15 +1310,18 @@ void *DeviceTy::getOrAllocTgtPtr(void *HstPtrBegin, void *HstPtrBase,
 void *DeviceTy::getTgtPtrBegin(void *HstPtrBegin, int64_t Size, bool &IsLast,
     bool UpdateRefCount) {
   void *rc = NULL;
-  DataMapMtx.lock();
+  DataMapMtx.lock_shared();
   LookupResult lr = lookupMapping(HstPtrBegin, Size);
 
   if (lr.Flags.IsContained || lr.Flags.ExtendsBefore || lr.Flags.ExtendsAfter) {
-    auto &HT = *lr.Entry;
-    IsLast = !(HT.RefCount > 1);
-
-    if (HT.RefCount > 1 && UpdateRefCount)
-      --HT.RefCount;
+    auto &HT = lr.Entry->second;
+    // Other threads may update the counter under the shared lock too; never
+    // drop the last reference here, deallocTgtPtr does it.
+    long RefCount = HT.RefCount.load();
+    while (RefCount > 1 && UpdateRefCount &&
+           !HT.RefCount.compare_exchange_weak(RefCount, RefCount - 1))
+      ;
+    IsLast = !(RefCount > 1);
 
     uintptr_t tp = HT.TgtPtrBegin + ((uintptr_t)HstPtrBegin - HT.HstPtrBegin);
     DP("Mapping exists with HstPtrBegin=" DPxMOD ", TgtPtrBegin=" DPxMOD ", "
@@ -970,7 +1334,7 @@ void *DeviceTy::getTgtPtrBegin(void *HstPtrBegin, int64_t Size, bool &IsLast,
     IsLast = false;
   }
 
-  DataMapMtx.unlock();
+  DataMapMtx.unlock_shared();
   return rc;
 }
 
@@ -980,7 +1344,7 @@ void *DeviceTy::getTgtPtrBegin(void *HstPtrBegin, int64_t Size) {
   uintptr_t hp = (uintptr_t)HstPtrBegin;
   LookupResult lr = lookupMapping(HstPtrBegin, Size);
   if (lr.Flags.IsContained || lr.Flags.ExtendsBefore || lr.Flags.ExtendsAfter) {
-    auto &HT = *lr.Entry;
+    auto &HT = lr.Entry->second;
     uintptr_t tp = HT.TgtPtrBegin + (hp - HT.HstPtrBegin);
     return (void *)tp;
   }
@@ -994,14 +1358,14 @@ int DeviceTy::deallocTgtPtr(void *HstPtrBegin, int64_t Size, bool ForceDelete) {
   DataMapMtx.lock();
   LookupResult lr = lookupMapping(HstPtrBegin, Size);
   if (lr.Flags.IsContained || lr.Flags.ExtendsBefore || lr.Flags.ExtendsAfter) {
-    auto &HT = *lr.Entry;
+    auto &HT = lr.Entry->second;
     if (ForceDelete)
       HT.RefCount = 1;
     if (--HT.RefCount <= 0) {
       assert(HT.RefCount == 0 && "did not expect a negative ref count");
       DP("Deleting tgt data " DPxMOD " of size %ld\n",
           DPxPTR(HT.TgtPtrBegin), Size);
-      RTL->data_delete(RTLDeviceID, (void *)HT.TgtPtrBegin);
+      releaseTgtPtr(HT.TgtPtrBegin, HT.HstPtrEnd - HT.HstPtrBegin);
       DP("Removing%s mapping with HstPtrBegin=" DPxMOD ", TgtPtrBegin=" DPxMOD
           ", Size=%ld\n", (ForceDelete ? " (forced)" : ""),
           DPxPTR(HT.HstPtrBegin), DPxPTR(HT.TgtPtrBegin), Size);
@@ -1018,6 +1382,128 @@ int DeviceTy::deallocTgtPtr(void *HstPtrBegin, int64_t Size, bool ForceDelete) {
   return rc;
 }
 
+// Used by target_data_begin to map sections which are contiguous on the host
+// to a single target block. Sections holds the indices of the sections, in
+// increasing address order. Return false, without mapping any of them, if one
+// of them is already mapped or the allocation fails. Otherwise every section
+// gets its own mapping, with a reference count of one.
+bool DeviceTy::allocCoalescedTgtPtrs(const std::vector<int32_t> &Sections,
+    void **HstPtrBases, void **HstPtrBegins, int64_t *Sizes, int64_t Type) {
+  uintptr_t Begin = (uintptr_t)HstPtrBegins[Sections.front()];
+  uintptr_t End = (uintptr_t)HstPtrBegins[Sections.back()] +
+      Sizes[Sections.back()];
+  int64_t Size = End - Begin;
+
+  DataMapMtx.lock();
+  LookupResult lr = lookupMapping((void *)Begin, Size);
+  if (lr.Flags.IsContained || lr.Flags.ExtendsBefore || lr.Flags.ExtendsAfter) {
+    DataMapMtx.unlock();
+    return false;
+  }
+
+  // The lookup skips a mapping of size 0 at Begin, and two sections may begin
+  // at the same address. The insertion of their entries then fails: undo it.
+  std::vector<HostDataToTargetMapTy::iterator> Entries;
+  for (int32_t i : Sections) {
+    uintptr_t HstPtrBegin = (uintptr_t)HstPtrBegins[i];
+    auto Res = HostDataToTargetMap.insert(std::make_pair(HstPtrBegin,
+        HostDataToTargetTy((uintptr_t)HstPtrBases[i], HstPtrBegin,
+            HstPtrBegin + Sizes[i], 0)));
+    if (!Res.second) {
+      DP("Cannot coalesce sections, a mapping already begins at HstBegin="
+          DPxMOD "\n", DPxPTR(HstPtrBegin));
+      for (auto &Entry : Entries)
+        HostDataToTargetMap.erase(Entry);
+      DataMapMtx.unlock();
+      return false;
+    }
+    Entries.push_back(Res.first);
+  }
+
+  uintptr_t Tgt = (uintptr_t)allocData(Size, (void *)Begin, Type);
+  if (!Tgt) {
+    for (auto &Entry : Entries)
+      HostDataToTargetMap.erase(Entry);
+    DataMapMtx.unlock();
+    return false;
+  }
+
+  DP("Coalescing %zu sections in tgt data " DPxMOD " of size %ld\n",
+      Sections.size(), DPxPTR(Tgt), Size);
+  for (auto &Entry : Entries) {
+    auto &HT = Entry->second;
+    HT.TgtPtrBegin = Tgt + (HT.HstPtrBegin - Begin);
+    DP("Creating new map entry: HstBase=" DPxMOD ", HstBegin=" DPxMOD ", "
+        "HstEnd=" DPxMOD ", TgtBegin=" DPxMOD "\n", DPxPTR(HT.HstPtrBase),
+        DPxPTR(HT.HstPtrBegin), DPxPTR(HT.HstPtrEnd), DPxPTR(HT.TgtPtrBegin));
+  }
+  SharedBlocks[Tgt] = {Size, (int32_t)Entries.size()};
+
+  DataMapMtx.unlock();
+  return true;
+}
+
+// Called with DataMapMtx held exclusively.
+void DeviceTy::releaseTgtPtr(uintptr_t TgtPtrBegin, int64_t Size) {
+  auto Block = SharedBlocks.upper_bound(TgtPtrBegin);
+  if (Block != SharedBlocks.begin() &&
+      TgtPtrBegin < std::prev(Block)->first + std::prev(Block)->second.Size) {
+    --Block;
+    if (--Block->second.NumMappings == 0) {
+      deleteData((void *)Block->first, Block->second.Size);
+      SharedBlocks.erase(Block);
+    }
+    return;
+  }
+  deleteData((void *)TgtPtrBegin, Size);
+}
+
+void *DeviceTy::allocData(int64_t Size, void *HstPtrBegin, int64_t Type) {
+  if (!RTL->RealDevicePtrs || MemoryPoolLimit == 0)
+    return RTL->data_alloc(RTLDeviceID, Size, HstPtrBegin, Type);
+
+  int64_t ClassSize = MemoryPoolTy::classSize(Size);
+  void *TgtPtr = MemoryPool.get(ClassSize);
+  if (TgtPtr) {
+    DP("Reusing pooled tgt data " DPxMOD " of size %ld for %ld bytes\n",
+        DPxPTR(TgtPtr), ClassSize, Size);
+    return TgtPtr;
+  }
+  return RTL->data_alloc(RTLDeviceID, ClassSize, HstPtrBegin, Type);
+}
+
+void DeviceTy::deleteData(void *TgtPtrBegin, int64_t Size) {
+  if (RTL->RealDevicePtrs && MemoryPoolLimit > 0 &&
+      MemoryPool.put(TgtPtrBegin, MemoryPoolTy::classSize(Size),
+          MemoryPoolLimit)) {
+    DP("Pooled tgt data " DPxMOD "\n", DPxPTR(TgtPtrBegin));
+    return;
+  }
+  RTL->data_delete(RTLDeviceID, TgtPtrBegin);
+}
+
+void DeviceTy::trimMemoryPool() {
+  if (!RTL->RealDevicePtrs || MemoryPoolLimit == 0)
+    return;
+
+  std::vector<void *> Blocks;
+  MemoryPool.trim(Blocks);
+  for (auto *TgtPtr : Blocks)
+    RTL->data_delete(RTLDeviceID, TgtPtr);
+
+  uint64_t Allocs = MemoryPool.NumAllocs;
+  uint64_t Reuses = MemoryPool.NumReuses;
+  double Rate = Allocs ? 100.0 * Reuses / Allocs : 0.0;
+  uint64_t Releases = MemoryPool.NumReleases;
+  DP("Memory pool of device %d: %" PRIu64 " allocations, %" PRIu64 " reused "
+      "(%.1f%%), %" PRIu64 " released\n", DeviceID, Allocs, Reuses, Rate,
+      Releases);
+  if (MemoryPoolStats)
+    fprintf(stderr, "Libomptarget memory pool of device %d: %" PRIu64
+        " allocations, %" PRIu64 " reused (%.1f%%), %" PRIu64 " released\n",
+        DeviceID, Allocs, Reuses, Rate, Releases);
+}
+
 /// Init device, should not be called directly.
 void DeviceTy::init() {
   int32_t rc = RTL->init_device(RTLDeviceID);
@@ -1052,19 +1538,76 @@ __tgt_target_table *DeviceTy::load_binary(void *Img) {
 
 // Submit data to device.
 int32_t DeviceTy::data_submit(void *TgtPtrBegin, void *HstPtrBegin,
-    int64_t Size) {
+    int64_t Size, __tgt_async_info *AsyncInfo) {
+  if (AsyncInfo && RTL->data_submit_async)
+    return RTL->data_submit_async(RTLDeviceID, TgtPtrBegin, HstPtrBegin, Size,
+        AsyncInfo);
   return RTL->data_submit(RTLDeviceID, TgtPtrBegin, HstPtrBegin, Size);
 }
 
 // Retrieve data from device.
 int32_t DeviceTy::data_retrieve(void *HstPtrBegin, void *TgtPtrBegin,
-    int64_t Size) {
+    int64_t Size, __tgt_async_info *AsyncInfo) {
+  if (AsyncInfo && RTL->data_retrieve_async)
+    return RTL->data_retrieve_async(RTLDeviceID, HstPtrBegin, TgtPtrBegin,
+        Size, AsyncInfo);
   return RTL->data_retrieve(RTLDeviceID, HstPtrBegin, TgtPtrBegin, Size);
 }
 
+// Submit a batch of data to device.
+int32_t DeviceTy::data_submit(TransferBatchTy &Batch,
+    __tgt_async_info *AsyncInfo) {
+  int32_t rc = OFFLOAD_SUCCESS;
+  if (Batch.empty())
+    return rc;
+
+  // Queued transfers are already gathered by the RTL, and must stay ordered
+  // with the other operations of the queue.
+  if (RTL->data_submit_batch && !(AsyncInfo && RTL->data_submit_async)) {
+    DP("Submitting a batch of %zu buffers\n", Batch.Sizes.size());
+    rc = RTL->data_submit_batch(RTLDeviceID, Batch.Sizes.size(),
+        &Batch.TgtPtrs[0], &Batch.HstPtrs[0], &Batch.Sizes[0]);
+  } else {
+    for (size_t i = 0; i < Batch.Sizes.size(); ++i)
+      if (data_submit(Batch.TgtPtrs[i], Batch.HstPtrs[i], Batch.Sizes[i],
+              AsyncInfo) != OFFLOAD_SUCCESS)
+        rc = OFFLOAD_FAIL;
+  }
+
+  Batch.clear();
+  return rc;
+}
+
+// Retrieve a batch of data from device.
+int32_t DeviceTy::data_retrieve(TransferBatchTy &Batch,
+    __tgt_async_info *AsyncInfo) {
+  int32_t rc = OFFLOAD_SUCCESS;
+  if (Batch.empty())
+    return rc;
+
+  if (RTL->data_retrieve_batch && !(AsyncInfo && RTL->data_retrieve_async)) {
+    DP("Retrieving a batch of %zu buffers\n", Batch.Sizes.size());
+    rc = RTL->data_retrieve_batch(RTLDeviceID, Batch.Sizes.size(),
+        &Batch.HstPtrs[0], &Batch.TgtPtrs[0], &Batch.Sizes[0]);
+  } else {
+    for (size_t i = 0; i < Batch.Sizes.size(); ++i)
+      if (data_retrieve(Batch.HstPtrs[i], Batch.TgtPtrs[i], Batch.Sizes[i],
+              AsyncInfo) != OFFLOAD_SUCCESS)
+        rc = OFFLOAD_FAIL;
+  }
+
+  Batch.clear();
+  return rc;
+}
+
 // Run region on device
 int32_t DeviceTy::run_region(void *TgtEntryPtr, void **TgtVarsPtr,
-    ptrdiff_t *TgtOffsets, int64_t *TgtVarsSize, int32_t NumTgtVars) {
+    ptrdiff_t *TgtOffsets, int64_t *TgtVarsSize, int32_t NumTgtVars,
+    __tgt_async_info *AsyncInfo) {
+  // A region is a team region with one team of one thread.
+  if (AsyncInfo && RTL->run_team_region_async)
+    return RTL->run_team_region_async(RTLDeviceID, TgtEntryPtr, TgtVarsPtr,
+        TgtOffsets, TgtVarsSize, NumTgtVars, 1, 1, 0, AsyncInfo);
   return RTL->run_region(RTLDeviceID, TgtEntryPtr, TgtVarsPtr, TgtOffsets,
       TgtVarsSize, NumTgtVars);
 }
@@ -1072,11 +1615,23 @@ int32_t DeviceTy::run_region(void *TgtEntryPtr, void **TgtVarsPtr,
 // Run team region on device.
 int32_t DeviceTy::run_team_region(void *TgtEntryPtr, void **TgtVarsPtr,
     ptrdiff_t *TgtOffsets, int64_t *TgtVarsSize, int32_t NumTgtVars,
-    int32_t NumTeams, int32_t ThreadLimit, uint64_t LoopTripCount) {
+    int32_t NumTeams, int32_t ThreadLimit, uint64_t LoopTripCount,
+    __tgt_async_info *AsyncInfo) {
+  if (AsyncInfo && RTL->run_team_region_async)
+    return RTL->run_team_region_async(RTLDeviceID, TgtEntryPtr, TgtVarsPtr,
+        TgtOffsets, TgtVarsSize, NumTgtVars, NumTeams, ThreadLimit,
+        LoopTripCount, AsyncInfo);
   return RTL->run_team_region(RTLDeviceID, TgtEntryPtr, TgtVarsPtr, TgtOffsets,
       TgtVarsSize, NumTgtVars, NumTeams, ThreadLimit, LoopTripCount);
 }
 
+// Wait for the queued operations.
+int32_t DeviceTy::synchronize(__tgt_async_info *AsyncInfo) {
+  if (!AsyncInfo->Queue || !RTL->synchronize)
+    return OFFLOAD_SUCCESS;
+  return RTL->synchronize(RTLDeviceID, AsyncInfo);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Functionality for registering libs
 
@@ -1266,7 +1821,7 @@ EXTERN void __tgt_unregister_lib(__tgt_bin_desc *desc) {
         if (Device.PendingCtorsDtors[desc].PendingCtors.empty()) {
           for (auto &dtor : Device.PendingCtorsDtors[desc].PendingDtors) {
             int rc = target(Device.DeviceID, dtor, 0, NULL, NULL, NULL, NULL, 1,
-                1, true /*team*/);
+                1, true /*team*/, 0);
             if (rc != OFFLOAD_SUCCESS) {
               DP("Running destructor " DPxMOD " failed.\n", DPxPTR(dtor));
             }
@@ -1275,6 +1830,10 @@ EXTERN void __tgt_unregister_lib(__tgt_bin_desc *desc) {
           Device.PendingCtorsDtors.erase(desc);
         }
         Device.PendingGlobalsMtx.unlock();
+
+        // Give the blocks cached for this library back to the device.
+        if (Device.IsInit)
+          Device.trimMemoryPool();
       }
 
       DP("Unregistered image " DPxMOD " from RTL " DPxMOD "!\n",
@@ -1310,6 +1869,7 @@ EXTERN void __tgt_unregister_lib(__tgt_bin_desc *desc) {
         "it has been already removed.\n", DPxPTR(desc->HostEntriesBegin));
   }
 
+  ++TblMapGeneration;
   TblMapMtx.unlock();
 
   // TODO: Remove RTL and the devices it manages if it's not used anymore?
@@ -1394,12 +1954,21 @@ static int InitLibrary(DeviceTy& Device) {
         DP("Add mapping from host " DPxMOD " to device " DPxMOD " with size %zu"
             "\n", DPxPTR(CurrHostEntry->addr), DPxPTR(CurrDeviceEntry->addr),
             CurrDeviceEntry->size);
-        Device.HostDataToTargetMap.push_front(HostDataToTargetTy(
+        HostDataToTargetTy Entry(
             (uintptr_t)CurrHostEntry->addr /*HstPtrBase*/,
             (uintptr_t)CurrHostEntry->addr /*HstPtrBegin*/,
             (uintptr_t)CurrHostEntry->addr + CurrHostEntry->size /*HstPtrEnd*/,
             (uintptr_t)CurrDeviceEntry->addr /*TgtPtrBegin*/,
-            INF_REF_CNT /*RefCount*/));
+            INF_REF_CNT /*RefCount*/);
+        auto Res = Device.HostDataToTargetMap.insert(
+            std::make_pair(Entry.HstPtrBegin, Entry));
+        if (!Res.second) {
+          // Only a mapping of size 0, which the lookup above skips, can begin
+          // at the same address. The global replaces it.
+          DP("Replacing mapping of size 0 at host " DPxMOD "\n",
+              DPxPTR(CurrHostEntry->addr));
+          Res.first->second = Entry;
+        }
       }
     }
     Device.DataMapMtx.unlock();
@@ -1422,7 +1991,7 @@ static int InitLibrary(DeviceTy& Device) {
         for (auto &entry : lib.second.PendingCtors) {
           void *ctor = entry;
           int rc = target(device_id, ctor, 0, NULL, NULL, NULL,
-                          NULL, 1, 1, true /*team*/);
+                          NULL, 1, 1, true /*team*/, 0);
           if (rc != OFFLOAD_SUCCESS) {
             DP("Running ctor " DPxMOD " failed.\n", DPxPTR(ctor));
             Device.PendingGlobalsMtx.unlock();
@@ -1469,9 +2038,66 @@ static int member_of(int64_t type) {
   return ((type & OMP_TGT_MAPTYPE_MEMBER_OF) >> 48) - 1;
 }
 
-/// Internal function to do the mapping and transfer the data to the device
+/// Map the sections of the arguments which are contiguous on the host and not
+/// mapped yet to shared target blocks. Coalesced[i] is set for the arguments
+/// mapped here.
+static void coalesce_sections(DeviceTy &Device, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types,
+    std::vector<bool> &Coalesced) {
+  // The target addresses of the sections are derived from the block.
+  if (!Device.RTL->RealDevicePtrs)
+    return;
+
+  // Plain sections only: pointees, struct members and combined entries are
+  // laid out by the code below.
+  std::vector<int32_t> Candidates;
+  for (int32_t i = 0; i < arg_num; ++i) {
+    if ((arg_types[i] & (OMP_TGT_MAPTYPE_LITERAL | OMP_TGT_MAPTYPE_PRIVATE |
+            OMP_TGT_MAPTYPE_PTR_AND_OBJ | OMP_TGT_MAPTYPE_MEMBER_OF)) ||
+        arg_sizes[i] <= 0)
+      continue;
+    if (i + 1 < arg_num && member_of(arg_types[i + 1]) == i)
+      continue;
+    Candidates.push_back(i);
+  }
+  if (Candidates.size() < 2)
+    return;
+
+  std::sort(Candidates.begin(), Candidates.end(), [&](int32_t A, int32_t B) {
+    return (uintptr_t)args[A] < (uintptr_t)args[B];
+  });
+
+  std::vector<int32_t> Run;
+  for (size_t c = 0; c <= Candidates.size(); ++c) {
+    int32_t i = c < Candidates.size() ? Candidates[c] : -1;
+    if (i >= 0 && !Run.empty() && (uintptr_t)args[i] ==
+        (uintptr_t)args[Run.back()] + arg_sizes[Run.back()]) {
+      Run.push_back(i);
+      continue;
+    }
+    if (Run.size() > 1 && Device.allocCoalescedTgtPtrs(Run, args_base, args,
+            arg_sizes, arg_types[Run.front()]))
+      for (int32_t j : Run)
+        Coalesced[j] = true;
+    Run.clear();
+    if (i >= 0)
+      Run.push_back(i);
+  }
+}
+
+/// Internal function to do the mapping and transfer the data to the device.
+/// The transfers are queued in AsyncInfo, which the caller synchronizes; the
+/// pointer values written on the device are kept in PtrUpdates until then.
 static int target_data_begin(DeviceTy &Device, int32_t arg_num,
-    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types) {
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types,
+    __tgt_async_info *AsyncInfo, PtrUpdateListTy &PtrUpdates) {
+  // Transfers are gathered and done after all the mappings are created.
+  TransferBatchTy Batch(Device.RTL->RealDevicePtrs);
+
+  std::vector<bool> Coalesced(arg_num, false);
+  coalesce_sections(Device, arg_num, args_base, args, arg_sizes, arg_types,
+      Coalesced);
+
   // process each input.
   int rc = OFFLOAD_SUCCESS;
   for (int32_t i = 0; i < arg_num; ++i) {
@@ -1531,8 +2157,12 @@ static int target_data_begin(DeviceTy &Device, int32_t arg_num,
       UpdateRef = true; // subsequently update ref count of pointee
     }
 
+    // Coalesced sections are already mapped and counted, but new.
     void *TgtPtrBegin = Device.getOrAllocTgtPtr(HstPtrBegin, HstPtrBase,
-        data_size, arg_types[i], IsNew, IsImplicit, UpdateRef);
+        data_size, arg_types[i], IsNew, IsImplicit,
+        UpdateRef && !Coalesced[i]);
+    if (Coalesced[i])
+      IsNew = true;
     if (!TgtPtrBegin && data_size) {
       // If data_size==0, then the argument could be a zero-length pointer to
       // NULL, so getOrAlloc() returning NULL is not an error.
@@ -1567,11 +2197,7 @@ static int target_data_begin(DeviceTy &Device, int32_t arg_num,
       if (copy) {
         DP("Moving %" PRId64 " bytes (hst:" DPxMOD ") -> (tgt:" DPxMOD ")\n",
             data_size, DPxPTR(HstPtrBegin), DPxPTR(TgtPtrBegin));
-        int rt = Device.data_submit(TgtPtrBegin, HstPtrBegin, data_size);
-        if (rt != OFFLOAD_SUCCESS) {
-          DP("Copying data to device failed.\n");
-          rc = OFFLOAD_FAIL;
-        }
+        Batch.add(TgtPtrBegin, HstPtrBegin, data_size);
       }
     }
 
@@ -1582,28 +2208,231 @@ static int target_data_begin(DeviceTy &Device, int32_t arg_num,
           DPxPTR(Pointer_TgtPtrBegin), DPxPTR(TgtPtrBegin));
       uint64_t Delta = (uint64_t)HstPtrBegin - (uint64_t)HstPtrBase;
       void *TgtPtrBase = (void *)((uint64_t)TgtPtrBegin - Delta);
-      int rt = Device.data_submit(Pointer_TgtPtrBegin, &TgtPtrBase,
-          sizeof(void *));
-      if (rt != OFFLOAD_SUCCESS) {
-        DP("Copying data to device failed.\n");
-        rc = OFFLOAD_FAIL;
-      }
       // create shadow pointers for this entry
       Device.ShadowMtx.lock();
       Device.ShadowPtrMap[Pointer_HstPtrBegin] = {HstPtrBase,
           Pointer_TgtPtrBegin, TgtPtrBase};
       Device.ShadowMtx.unlock();
+      PtrUpdates.add(Pointer_TgtPtrBegin, TgtPtrBase);
     }
   }
 
+  // The pointers are written after the data, which may contain them.
+  PtrUpdates.flush(Batch);
+  if (Device.data_submit(Batch, AsyncInfo) != OFFLOAD_SUCCESS) {
+    DP("Copying data to device failed.\n");
+    rc = OFFLOAD_FAIL;
+  }
+
+  return rc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Asynchronous execution of nowait constructs.
+//
+// A nowait construct is represented in the host tasking runtime by a proxy
+// task. Its routine only queues the operation; one of the offload threads
+// below runs it with the blocking implementation and then completes the proxy
+// task out of order. Dependences and taskwaits on the construct are thus
+// resolved by libomp while the host threads keep running other tasks.
+
+/// Target operation of a nowait construct. The argument arrays are copied
+/// since those of the compiler do not outlive the call to the entry point.
+struct AsyncTargetOpTy {
+  enum KindTy { DataBegin, DataEnd, DataUpdate, Target, TargetTeams };
+
+  KindTy Kind;
+  int64_t DeviceId;
+  void *HostPtr;
+  std::vector<void *> ArgsBase;
+  std::vector<void *> Args;
+  std::vector<int64_t> ArgSizes;
+  std::vector<int64_t> ArgTypes;
+  int32_t TeamNum;
+  int32_t ThreadLimit;
+  uint64_t LoopTripCount;
+  // Set when the encountering thread waits for the operation and frees it.
+  bool Waited;
+  int Rc;
+
+  int run() {
+    int32_t NumArgs = Args.size();
+    void **ArgsBasePtr = NumArgs ? &ArgsBase[0] : NULL;
+    void **ArgsPtr = NumArgs ? &Args[0] : NULL;
+    int64_t *ArgSizesPtr = NumArgs ? &ArgSizes[0] : NULL;
+    int64_t *ArgTypesPtr = NumArgs ? &ArgTypes[0] : NULL;
+
+    switch (Kind) {
+    case DataBegin:
+      return data_begin_on_device(DeviceId, NumArgs, ArgsBasePtr, ArgsPtr,
+          ArgSizesPtr, ArgTypesPtr);
+    case DataEnd:
+      return data_end_on_device(DeviceId, NumArgs, ArgsBasePtr, ArgsPtr,
+          ArgSizesPtr, ArgTypesPtr);
+    case DataUpdate:
+      return data_update_on_device(DeviceId, NumArgs, ArgsBasePtr, ArgsPtr,
+          ArgSizesPtr, ArgTypesPtr);
+    case Target:
+      return __tgt_target(DeviceId, HostPtr, NumArgs, ArgsBasePtr, ArgsPtr,
+          ArgSizesPtr, ArgTypesPtr);
+    case TargetTeams:
+      return target_teams(DeviceId, HostPtr, NumArgs, ArgsBasePtr, ArgsPtr,
+          ArgSizesPtr, ArgTypesPtr, TeamNum, ThreadLimit, LoopTripCount);
+    }
+    return OFFLOAD_FAIL;
+  }
+};
+
+/// Pool of threads running the operations of nowait constructs.
+class AsyncOffloadQueueTy {
+  typedef std::pair<AsyncTargetOpTy *, kmp_task_t *> ItemTy;
+
+  std::deque<ItemTy> Items;
+  std::vector<std::thread> Threads;
+  std::mutex Mtx;
+  std::condition_variable Cv;
+  bool Stopping;
+
+  void worker() {
+    std::unique_lock<std::mutex> lock(Mtx);
+    while (true) {
+      Cv.wait(lock, [this] { return Stopping || !Items.empty(); });
+      if (Items.empty())
+        return;
+      ItemTy Item = Items.front();
+      Items.pop_front();
+      lock.unlock();
+
+      AsyncTargetOpTy *Op = Item.first;
+      bool Waited = Op->Waited;
+      Op->Rc = Op->run();
+      if (Op->Rc != OFFLOAD_SUCCESS)
+        DP("Asynchronous target operation failed\n");
+      // A waited operation is freed by the encountering thread as soon as the
+      // proxy task is completed, do not touch it afterwards.
+      if (!Waited)
+        delete Op;
+      __kmpc_proxy_task_completed_ooo(Item.second);
+
+      lock.lock();
+    }
+  }
+
+public:
+  AsyncOffloadQueueTy() : Stopping(false) {}
+
+  ~AsyncOffloadQueueTy() {
+    Mtx.lock();
+    Stopping = true;
+    Mtx.unlock();
+    Cv.notify_all();
+    for (auto &T : Threads)
+      T.join();
+  }
+
+  void push(AsyncTargetOpTy *Op, kmp_task_t *Task) {
+    std::lock_guard<std::mutex> lock(Mtx);
+    if (Threads.empty()) {
+      int NumThreads = 4;
+      if (char *envStr = getenv("LIBOMPTARGET_ASYNC_THREADS"))
+        NumThreads = std::max(1, atoi(envStr));
+      DP("Starting %d offload threads for nowait constructs\n", NumThreads);
+      for (int i = 0; i < NumThreads; ++i)
+        Threads.push_back(std::thread(&AsyncOffloadQueueTy::worker, this));
+    }
+    Items.push_back(ItemTy(Op, Task));
+    Cv.notify_one();
+  }
+};
+
+static AsyncOffloadQueueTy AsyncOffloadQueue;
+
+static kmp_int32 async_op_task_entry(kmp_int32 gtid, void *task) {
+  kmp_task_t *Task = (kmp_task_t *)task;
+  AsyncOffloadQueue.push(*(AsyncTargetOpTy **)Task->shareds, Task);
+  return 0;
+}
+
+static AsyncTargetOpTy *new_async_op(AsyncTargetOpTy::KindTy Kind,
+    int64_t device_id, int32_t arg_num, void **args_base, void **args,
+    int64_t *arg_sizes, int64_t *arg_types) {
+  // The device is resolved by the encountering thread, the default device is
+  // one of its ICVs.
+  device_id = translate_device_id(device_id);
+  if (device_id == OFFLOAD_DEVICE_DEFAULT)
+    device_id = omp_get_default_device();
+
+  AsyncTargetOpTy *Op = new AsyncTargetOpTy();
+  Op->Kind = Kind;
+  Op->DeviceId = device_id;
+  Op->HostPtr = NULL;
+  Op->ArgsBase.assign(args_base, args_base + arg_num);
+  Op->Args.assign(args, args + arg_num);
+  Op->ArgSizes.assign(arg_sizes, arg_sizes + arg_num);
+  Op->ArgTypes.assign(arg_types, arg_types + arg_num);
+  Op->TeamNum = 0;
+  Op->ThreadLimit = 0;
+  Op->LoopTripCount = 0;
+  Op->Waited = false;
+  Op->Rc = OFFLOAD_SUCCESS;
+  return Op;
+}
+
+/// Submits an operation as a proxy task depending on the given dependences.
+/// If Wait is set, the encountering thread waits for this task only and gets
+/// the result of the operation. This is what the nowait entry points without
+/// dependences do: the compiler already wraps the construct into a deferred
+/// task, whose completion must imply the one of the operation. The task then
+/// depends on the operation itself, which no other task refers to, and the
+/// wait on that dependence is a task scheduling point, unlike a taskwait it
+/// does not wait for the other children of the encountering task.
+static int submit_async_op(AsyncTargetOpTy *Op, int32_t depNum,
+    void *depList, int32_t noAliasDepNum, void *noAliasDepList, bool Wait) {
+  // Without the host tasking runtime, run the operation synchronously.
+  if (!__kmpc_global_thread_num || !__kmpc_omp_proxy_task_alloc ||
+      !__kmpc_omp_task || !__kmpc_omp_task_with_deps ||
+      !__kmpc_proxy_task_completed_ooo || !__kmpc_omp_wait_deps) {
+    if (depNum + noAliasDepNum > 0 && __kmpc_omp_taskwait)
+      __kmpc_omp_taskwait(NULL, 0);
+    int rc = Op->run();
+    delete Op;
+    return rc;
+  }
+
+  Op->Waited = Wait;
+  kmp_int32 gtid = __kmpc_global_thread_num(NULL);
+  kmp_task_t *Task = __kmpc_omp_proxy_task_alloc(NULL, gtid,
+      sizeof(kmp_task_t), sizeof(AsyncTargetOpTy *), async_op_task_entry);
+  *(AsyncTargetOpTy **)Task->shareds = Op;
+
+  if (!Wait) {
+    if (depNum + noAliasDepNum > 0)
+      __kmpc_omp_task_with_deps(NULL, gtid, Task, depNum, depList,
+          noAliasDepNum, noAliasDepList);
+    else
+      __kmpc_omp_task(NULL, gtid, Task);
+    return OFFLOAD_SUCCESS;
+  }
+
+  assert(depNum + noAliasDepNum == 0 && "Waited operations have no depend");
+  kmp_depend_info_t OpDep;
+  OpDep.base_addr = (intptr_t)Op;
+  OpDep.len = sizeof(AsyncTargetOpTy);
+  OpDep.flags.in = 1;
+  OpDep.flags.out = 1;
+  __kmpc_omp_task_with_deps(NULL, gtid, Task, 1, &OpDep, 0, NULL);
+  __kmpc_omp_wait_deps(NULL, gtid, 1, &OpDep, 0, NULL);
+
+  int rc = Op->Rc;
+  delete Op;
   return rc;
 }
 
 EXTERN void __tgt_target_data_begin_nowait(int64_t device_id, int32_t arg_num,
     void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types) {
-  // Async not yet implemented, just call the blocking version
-  __tgt_target_data_begin(device_id, arg_num, args_base, args, arg_sizes,
-      arg_types);
+  submit_async_op(new_async_op(AsyncTargetOpTy::DataBegin, device_id, arg_num,
+      args_base, args, arg_sizes, arg_types), 0, NULL, 0, NULL,
+      /*Wait=*/true);
 }
 
 EXTERN void __tgt_target_data_begin_depend(int64_t device_id, int32_t arg_num,
@@ -1623,12 +2452,9 @@ EXTERN void __tgt_target_data_begin_nowait_depend(int64_t device_id,
     int32_t arg_num, void **args_base, void **args, int64_t *arg_sizes,
     int64_t *arg_types, int32_t depNum, void *depList, int32_t noAliasDepNum,
     void *noAliasDepList) {
-  if (depNum + noAliasDepNum > 0)
-    __kmpc_omp_taskwait(NULL, 0);
-
-  // Async not yet implemented, just call the blocking version
-  __tgt_target_data_begin(device_id, arg_num, args_base, args, arg_sizes,
-                          arg_types);
+  submit_async_op(new_async_op(AsyncTargetOpTy::DataBegin, device_id, arg_num,
+      args_base, args, arg_sizes, arg_types), depNum, depList, noAliasDepNum,
+      noAliasDepList, /*Wait=*/false);
 }
 
 /// creates host-to-target data mapping, stores it in the
@@ -1647,9 +2473,16 @@ EXTERN void __tgt_target_data_begin(int64_t device_id, int32_t arg_num,
     DP("Use default device id %" PRId64 "\n", device_id);
   }
 
+  data_begin_on_device(device_id, arg_num, args_base, args, arg_sizes,
+      arg_types);
+}
+
+/// Maps the data of a target data begin on a device already resolved.
+static int data_begin_on_device(int64_t device_id, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types) {
   if (CheckDevice(device_id) != OFFLOAD_SUCCESS) {
     DP("Failed to get device %" PRId64 " ready\n", device_id);
-    return;
+    return OFFLOAD_FAIL;
   }
 
   DeviceTy& Device = Devices[device_id];
@@ -1662,13 +2495,38 @@ EXTERN void __tgt_target_data_begin(int64_t device_id, int32_t arg_num,
   }
 #endif
 
-  target_data_begin(Device, arg_num, args_base, args, arg_sizes, arg_types);
+  __tgt_async_info AsyncInfo = {NULL};
+  PtrUpdateListTy PtrUpdates;
+  int rc = target_data_begin(Device, arg_num, args_base, args, arg_sizes,
+      arg_types, &AsyncInfo, PtrUpdates);
+  if (Device.synchronize(&AsyncInfo) != OFFLOAD_SUCCESS)
+    rc = OFFLOAD_FAIL;
+  if (rc != OFFLOAD_SUCCESS)
+    DP("Failed to map or transfer data to device %" PRId64 "\n", device_id);
+
+  return rc;
 }
 
-/// Internal function to undo the mapping and retrieve the data from the device.
+/// Internal function to transfer the data back and undo the mapping. The
+/// transfers are queued in AsyncInfo along with the operations queued by the
+/// caller and waited for at once, before the host pointers are restored and
+/// the device memory is released.
 static int target_data_end(DeviceTy &Device, int32_t arg_num, void **args_base,
-    void **args, int64_t *arg_sizes, int64_t *arg_types) {
+    void **args, int64_t *arg_sizes, int64_t *arg_types,
+    __tgt_async_info *AsyncInfo) {
   int rc = OFFLOAD_SUCCESS;
+
+  // Entries to process once the data are back on the host.
+  struct DeferredEntryTy {
+    void *HstPtrBegin;
+    int64_t Size;
+    bool CopiedBack;
+    bool DelEntry;
+    bool ForceDelete;
+  };
+  std::vector<DeferredEntryTy> DeferredEntries;
+  TransferBatchTy Batch(Device.RTL->RealDevicePtrs);
+
   // process each input.
   for (int32_t i = arg_num - 1; i >= 0; --i) {
     // Ignore private variables and arrays - there is no mapping for them.
@@ -1734,54 +2592,66 @@ static int target_data_end(DeviceTy &Device, int32_t arg_num, void **args_base,
         if (DelEntry || Always || CopyMember) {
           DP("Moving %" PRId64 " bytes (tgt:" DPxMOD ") -> (hst:" DPxMOD ")\n",
               data_size, DPxPTR(TgtPtrBegin), DPxPTR(HstPtrBegin));
-          int rt = Device.data_retrieve(HstPtrBegin, TgtPtrBegin, data_size);
-          if (rt != OFFLOAD_SUCCESS) {
-            DP("Copying data from device failed.\n");
-            rc = OFFLOAD_FAIL;
-          }
+          Batch.add(TgtPtrBegin, HstPtrBegin, data_size);
         }
       }
 
-      // If we copied back to the host a struct/array containing pointers, we
-      // need to restore the original host pointer values from their shadow
-      // copies. If the struct is going to be deallocated, remove any remaining
-      // shadow pointer entries for this struct.
-      uintptr_t lb = (uintptr_t) HstPtrBegin;
-      uintptr_t ub = (uintptr_t) HstPtrBegin + data_size;
-      Device.ShadowMtx.lock();
-      for (ShadowPtrListTy::iterator it = Device.ShadowPtrMap.begin();
-          it != Device.ShadowPtrMap.end(); ++it) {
-        void **ShadowHstPtrAddr = (void**) it->first;
+      DeferredEntries.push_back({HstPtrBegin, data_size,
+          (arg_types[i] & OMP_TGT_MAPTYPE_FROM) != 0, DelEntry, ForceDelete});
+    }
+  }
 
-        // An STL map is sorted on its keys; use this property
-        // to quickly determine when to break out of the loop.
-        if ((uintptr_t) ShadowHstPtrAddr < lb)
-          continue;
-        if ((uintptr_t) ShadowHstPtrAddr >= ub)
-          break;
+  if (Device.data_retrieve(Batch, AsyncInfo) != OFFLOAD_SUCCESS) {
+    DP("Copying data from device failed.\n");
+    rc = OFFLOAD_FAIL;
+  }
 
-        // If we copied the struct to the host, we need to restore the pointer.
-        if (arg_types[i] & OMP_TGT_MAPTYPE_FROM) {
-          DP("Restoring original host pointer value " DPxMOD " for host "
-              "pointer " DPxMOD "\n", DPxPTR(it->second.HstPtrVal),
-              DPxPTR(ShadowHstPtrAddr));
-          *ShadowHstPtrAddr = it->second.HstPtrVal;
-        }
-        // If the struct is to be deallocated, remove the shadow entry.
-        if (DelEntry) {
-          DP("Removing shadow pointer " DPxMOD "\n", DPxPTR(ShadowHstPtrAddr));
-          Device.ShadowPtrMap.erase(it);
-        }
-      }
-      Device.ShadowMtx.unlock();
+  if (Device.synchronize(AsyncInfo) != OFFLOAD_SUCCESS) {
+    DP("Transfers from device failed.\n");
+    rc = OFFLOAD_FAIL;
+  }
 
-      // Deallocate map
+  for (auto &E : DeferredEntries) {
+    void *HstPtrBegin = E.HstPtrBegin;
+    int64_t data_size = E.Size;
+    bool DelEntry = E.DelEntry;
+    // If we copied back to the host a struct/array containing pointers, we
+    // need to restore the original host pointer values from their shadow
+    // copies. If the struct is going to be deallocated, remove any remaining
+    // shadow pointer entries for this struct.
+    uintptr_t lb = (uintptr_t) HstPtrBegin;
+    uintptr_t ub = (uintptr_t) HstPtrBegin + data_size;
+    Device.ShadowMtx.lock();
+    // An STL map is sorted on its keys, the entries of the range follow the
+    // first one not below lb.
+    for (ShadowPtrListTy::iterator it = Device.ShadowPtrMap.lower_bound(
+             (void *)lb);
+         it != Device.ShadowPtrMap.end() && (uintptr_t)it->first < ub;) {
+      void **ShadowHstPtrAddr = (void**) it->first;
+
+      // If we copied the struct to the host, we need to restore the pointer.
+      if (E.CopiedBack) {
+        DP("Restoring original host pointer value " DPxMOD " for host "
+            "pointer " DPxMOD "\n", DPxPTR(it->second.HstPtrVal),
+            DPxPTR(ShadowHstPtrAddr));
+        *ShadowHstPtrAddr = it->second.HstPtrVal;
+      }
+      // If the struct is to be deallocated, remove the shadow entry.
       if (DelEntry) {
-        int rt = Device.deallocTgtPtr(HstPtrBegin, data_size, ForceDelete);
-        if (rt != OFFLOAD_SUCCESS) {
-          DP("Deallocating data from device failed.\n");
-          rc = OFFLOAD_FAIL;
-        }
+        DP("Removing shadow pointer " DPxMOD "\n", DPxPTR(ShadowHstPtrAddr));
+        it = Device.ShadowPtrMap.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    Device.ShadowMtx.unlock();
+
+    // Deallocate map
+    if (DelEntry) {
+      int rt = Device.deallocTgtPtr(HstPtrBegin, data_size, E.ForceDelete);
+      if (rt != OFFLOAD_SUCCESS) {
+        DP("Deallocating data from device failed.\n");
+        rc = OFFLOAD_FAIL;
       }
     }
   }
@@ -1791,9 +2661,9 @@ static int target_data_end(DeviceTy &Device, int32_t arg_num, void **args_base,
 
 EXTERN void __tgt_target_data_end_nowait(int64_t device_id, int32_t arg_num,
     void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types) {
-  // Async not yet implemented, just call the blocking version
-  __tgt_target_data_end(device_id, arg_num, args_base, args, arg_sizes,
-      arg_types);
+  submit_async_op(new_async_op(AsyncTargetOpTy::DataEnd, device_id, arg_num,
+      args_base, args, arg_sizes, arg_types), 0, NULL, 0, NULL,
+      /*Wait=*/true);
 }
 
 EXTERN void __tgt_target_data_end_depend(int64_t device_id, int32_t arg_num,
@@ -1811,12 +2681,9 @@ EXTERN void __tgt_target_data_end_nowait_depend(int64_t device_id,
     int32_t arg_num, void **args_base, void **args, int64_t *arg_sizes,
     int64_t *arg_types, int32_t depNum, void *depList, int32_t noAliasDepNum,
     void *noAliasDepList) {
-  if (depNum + noAliasDepNum > 0)
-    __kmpc_omp_taskwait(NULL, 0);
-
-  // Async not yet implemented, just call the blocking version
-  __tgt_target_data_end(device_id, arg_num, args_base, args, arg_sizes,
-                          arg_types);
+  submit_async_op(new_async_op(AsyncTargetOpTy::DataEnd, device_id, arg_num,
+      args_base, args, arg_sizes, arg_types), depNum, depList, noAliasDepNum,
+      noAliasDepList, /*Wait=*/false);
 }
 
 /// passes data from the target, releases target memory and destroys
@@ -1833,18 +2700,25 @@ EXTERN void __tgt_target_data_end(int64_t device_id, int32_t arg_num,
     device_id = omp_get_default_device();
   }
 
+  data_end_on_device(device_id, arg_num, args_base, args, arg_sizes,
+      arg_types);
+}
+
+/// Unmaps the data of a target data end on a device already resolved.
+static int data_end_on_device(int64_t device_id, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types) {
   RTLsMtx.lock();
   size_t Devices_size = Devices.size();
   RTLsMtx.unlock();
   if (Devices_size <= (size_t)device_id) {
     DP("Device ID  %" PRId64 " does not have a matching RTL.\n", device_id);
-    return;
+    return OFFLOAD_FAIL;
   }
 
   DeviceTy &Device = Devices[device_id];
   if (!Device.IsInit) {
     DP("uninit device: ignore");
-    return;
+    return OFFLOAD_SUCCESS;
   }
 
 #ifdef OMPTARGET_DEBUG
@@ -1855,14 +2729,16 @@ EXTERN void __tgt_target_data_end(int64_t device_id, int32_t arg_num,
   }
 #endif
 
-  target_data_end(Device, arg_num, args_base, args, arg_sizes, arg_types);
+  __tgt_async_info AsyncInfo = {NULL};
+  return target_data_end(Device, arg_num, args_base, args, arg_sizes,
+      arg_types, &AsyncInfo);
 }
 
 EXTERN void __tgt_target_data_update_nowait(int64_t device_id, int32_t arg_num,
     void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types) {
-  // Async not yet implemented, just call the blocking version
-  __tgt_target_data_update(device_id, arg_num, args_base, args, arg_sizes,
-      arg_types);
+  submit_async_op(new_async_op(AsyncTargetOpTy::DataUpdate, device_id, arg_num,
+      args_base, args, arg_sizes, arg_types), 0, NULL, 0, NULL,
+      /*Wait=*/true);
 }
 
 EXTERN void __tgt_target_data_update_depend(int64_t device_id, int32_t arg_num,
@@ -1882,12 +2758,9 @@ EXTERN void __tgt_target_data_update_nowait_depend(int64_t device_id,
     int32_t arg_num, void **args_base, void **args, int64_t *arg_sizes,
     int64_t *arg_types, int32_t depNum, void *depList, int32_t noAliasDepNum,
     void *noAliasDepList) {
-  if (depNum + noAliasDepNum > 0)
-    __kmpc_omp_taskwait(NULL, 0);
-
-  // Async not yet implemented, just call the blocking version
-  __tgt_target_data_update(device_id, arg_num, args_base, args, arg_sizes,
-                          arg_types);
+  submit_async_op(new_async_op(AsyncTargetOpTy::DataUpdate, device_id, arg_num,
+      args_base, args, arg_sizes, arg_types), depNum, depList, noAliasDepNum,
+      noAliasDepList, /*Wait=*/false);
 }
 
 /// passes data to/from the target.
@@ -1903,12 +2776,61 @@ EXTERN void __tgt_target_data_update(int64_t device_id, int32_t arg_num,
     device_id = omp_get_default_device();
   }
 
+  data_update_on_device(device_id, arg_num, args_base, args, arg_sizes,
+      arg_types);
+}
+
+/// Transfers the data of a target update on a device already resolved.
+static int data_update_on_device(int64_t device_id, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types) {
   if (CheckDevice(device_id) != OFFLOAD_SUCCESS) {
     DP("Failed to get device %" PRId64 " ready\n", device_id);
-    return;
+    return OFFLOAD_FAIL;
   }
 
   DeviceTy& Device = Devices[device_id];
+  int rc = OFFLOAD_SUCCESS;
+
+  // Consecutive transfers in the same direction are gathered and done at once,
+  // so that they still happen in the order of the arguments. The host
+  // pointers are restored once the data are back.
+  TransferBatchTy FromBatch(Device.RTL->RealDevicePtrs),
+      ToBatch(Device.RTL->RealDevicePtrs);
+  PtrUpdateListTy PtrUpdates;
+  std::vector<std::pair<uintptr_t, uintptr_t>> FromRanges;
+
+  auto RetrieveBatch = [&]() {
+    if (Device.data_retrieve(FromBatch) != OFFLOAD_SUCCESS) {
+      DP("Copying data from device failed.\n");
+      rc = OFFLOAD_FAIL;
+    }
+    FromBatch.clear();
+
+    for (auto &Range : FromRanges) {
+      Device.ShadowMtx.lock_shared();
+      for (ShadowPtrListTy::iterator it = Device.ShadowPtrMap.lower_bound(
+               (void *)Range.first);
+           it != Device.ShadowPtrMap.end() &&
+           (uintptr_t)it->first < Range.second; ++it) {
+        void **ShadowHstPtrAddr = (void**) it->first;
+        DP("Restoring original host pointer value " DPxMOD " for host pointer "
+            DPxMOD "\n", DPxPTR(it->second.HstPtrVal),
+            DPxPTR(ShadowHstPtrAddr));
+        *ShadowHstPtrAddr = it->second.HstPtrVal;
+      }
+      Device.ShadowMtx.unlock_shared();
+    }
+    FromRanges.clear();
+  };
+
+  auto SubmitBatch = [&]() {
+    PtrUpdates.flush(ToBatch);
+    if (Device.data_submit(ToBatch) != OFFLOAD_SUCCESS) {
+      DP("Copying data to device failed.\n");
+      rc = OFFLOAD_FAIL;
+    }
+    ToBatch.clear();
+  };
 
   // process each input.
   for (int32_t i = 0; i < arg_num; ++i) {
@@ -1923,52 +2845,42 @@ EXTERN void __tgt_target_data_update(int64_t device_id, int32_t arg_num,
         false);
 
     if (arg_types[i] & OMP_TGT_MAPTYPE_FROM) {
+      if (!ToBatch.empty())
+        SubmitBatch();
       DP("Moving %" PRId64 " bytes (tgt:" DPxMOD ") -> (hst:" DPxMOD ")\n",
           arg_sizes[i], DPxPTR(TgtPtrBegin), DPxPTR(HstPtrBegin));
-      Device.data_retrieve(HstPtrBegin, TgtPtrBegin, MapSize);
-
-      uintptr_t lb = (uintptr_t) HstPtrBegin;
-      uintptr_t ub = (uintptr_t) HstPtrBegin + MapSize;
-      Device.ShadowMtx.lock();
-      for (ShadowPtrListTy::iterator it = Device.ShadowPtrMap.begin();
-          it != Device.ShadowPtrMap.end(); ++it) {
-        void **ShadowHstPtrAddr = (void**) it->first;
-        if ((uintptr_t) ShadowHstPtrAddr < lb)
-          continue;
-        if ((uintptr_t) ShadowHstPtrAddr >= ub)
-          break;
-        DP("Restoring original host pointer value " DPxMOD " for host pointer "
-            DPxMOD "\n", DPxPTR(it->second.HstPtrVal),
-            DPxPTR(ShadowHstPtrAddr));
-        *ShadowHstPtrAddr = it->second.HstPtrVal;
-      }
-      Device.ShadowMtx.unlock();
+      FromBatch.add(TgtPtrBegin, HstPtrBegin, MapSize);
+      FromRanges.push_back(std::make_pair((uintptr_t) HstPtrBegin,
+          (uintptr_t) HstPtrBegin + MapSize));
     }
 
     if (arg_types[i] & OMP_TGT_MAPTYPE_TO) {
+      if (!FromBatch.empty())
+        RetrieveBatch();
       DP("Moving %" PRId64 " bytes (hst:" DPxMOD ") -> (tgt:" DPxMOD ")\n",
           arg_sizes[i], DPxPTR(HstPtrBegin), DPxPTR(TgtPtrBegin));
-      Device.data_submit(TgtPtrBegin, HstPtrBegin, MapSize);
+      ToBatch.add(TgtPtrBegin, HstPtrBegin, MapSize);
 
       uintptr_t lb = (uintptr_t) HstPtrBegin;
       uintptr_t ub = (uintptr_t) HstPtrBegin + MapSize;
-      Device.ShadowMtx.lock();
-      for (ShadowPtrListTy::iterator it = Device.ShadowPtrMap.begin();
-          it != Device.ShadowPtrMap.end(); ++it) {
-        void **ShadowHstPtrAddr = (void**) it->first;
-        if ((uintptr_t) ShadowHstPtrAddr < lb)
-          continue;
-        if ((uintptr_t) ShadowHstPtrAddr >= ub)
-          break;
+      Device.ShadowMtx.lock_shared();
+      for (ShadowPtrListTy::iterator it = Device.ShadowPtrMap.lower_bound(
+               (void *)lb);
+           it != Device.ShadowPtrMap.end() && (uintptr_t)it->first < ub;
+           ++it) {
         DP("Restoring original target pointer value " DPxMOD " for target "
             "pointer " DPxMOD "\n", DPxPTR(it->second.TgtPtrVal),
             DPxPTR(it->second.TgtPtrAddr));
-        Device.data_submit(it->second.TgtPtrAddr,
-            &it->second.TgtPtrVal, sizeof(void *));
+        PtrUpdates.add(it->second.TgtPtrAddr, it->second.TgtPtrVal);
       }
-      Device.ShadowMtx.unlock();
+      Device.ShadowMtx.unlock_shared();
     }
   }
+
+  RetrieveBatch();
+  SubmitBatch();
+
+  return rc;
 }
 
 /// performs the same actions as data_begin in case arg_num is
@@ -1979,69 +2891,94 @@ EXTERN void __tgt_target_data_update(int64_t device_id, int32_t arg_num,
 /// integer different from zero otherwise.
 static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
     void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types,
-    int32_t team_num, int32_t thread_limit, int IsTeamConstruct) {
+    int32_t team_num, int32_t thread_limit, int IsTeamConstruct,
+    uint64_t loop_tripcount) {
   DeviceTy &Device = Devices[device_id];
 
-  // Find the table information in the map or look it up in the translation
-  // tables.
   TableMap *TM = 0;
-  TblMapMtx.lock();
-  HostPtrToTableMapTy::iterator TableMapIt = HostPtrToTableMap.find(host_ptr);
-  if (TableMapIt == HostPtrToTableMap.end()) {
-    // We don't have a map. So search all the registered libraries.
-    TrlTblMtx.lock();
-    for (HostEntriesBeginToTransTableTy::iterator
-             ii = HostEntriesBeginToTransTable.begin(),
-             ie = HostEntriesBeginToTransTable.end();
-         !TM && ii != ie; ++ii) {
-      // get the translation table (which contains all the good info).
-      TranslationTable *TransTable = &ii->second;
-      // iterate over all the host table entries to see if we can locate the
-      // host_ptr.
-      __tgt_offload_entry *begin = TransTable->HostTable.EntriesBegin;
-      __tgt_offload_entry *end = TransTable->HostTable.EntriesEnd;
-      __tgt_offload_entry *cur = begin;
-      for (uint32_t i = 0; cur < end; ++cur, ++i) {
-        if (cur->addr != host_ptr)
-          continue;
-        // we got a match, now fill the HostPtrToTableMap so that we
-        // may avoid this search next time.
-        TM = &HostPtrToTableMap[host_ptr];
-        TM->Table = TransTable;
-        TM->Index = i;
-        break;
+  __tgt_target_table *TargetTable = 0;
+
+  // Look the host ptr up in the launch cache of this thread first.
+  uint64_t Generation = TblMapGeneration.load();
+  if (LaunchCache.Generation != Generation) {
+    LaunchCache.Entries.clear();
+    LaunchCache.Generation = Generation;
+  }
+  auto CacheKey = std::make_pair(host_ptr, device_id);
+  auto CacheIt = LaunchCache.Entries.find(CacheKey);
+  if (CacheIt != LaunchCache.Entries.end()) {
+    TM = CacheIt->second.first;
+    TargetTable = CacheIt->second.second;
+  } else {
+    // Find the table information in the map or look it up in the translation
+    // tables.
+    TblMapMtx.lock();
+    HostPtrToTableMapTy::iterator TableMapIt =
+        HostPtrToTableMap.find(host_ptr);
+    if (TableMapIt == HostPtrToTableMap.end()) {
+      // We don't have a map. So search all the registered libraries.
+      TrlTblMtx.lock();
+      for (HostEntriesBeginToTransTableTy::iterator
+               ii = HostEntriesBeginToTransTable.begin(),
+               ie = HostEntriesBeginToTransTable.end();
+           !TM && ii != ie; ++ii) {
+        // get the translation table (which contains all the good info).
+        TranslationTable *TransTable = &ii->second;
+        // iterate over all the host table entries to see if we can locate
+        // the host_ptr.
+        __tgt_offload_entry *begin = TransTable->HostTable.EntriesBegin;
+        __tgt_offload_entry *end = TransTable->HostTable.EntriesEnd;
+        __tgt_offload_entry *cur = begin;
+        for (uint32_t i = 0; cur < end; ++cur, ++i) {
+          if (cur->addr != host_ptr)
+            continue;
+          // we got a match, now fill the HostPtrToTableMap so that we
+          // may avoid this search next time.
+          TM = &HostPtrToTableMap[host_ptr];
+          TM->Table = TransTable;
+          TM->Index = i;
+          break;
+        }
       }
+      TrlTblMtx.unlock();
+    } else {
+      TM = &TableMapIt->second;
     }
+    TblMapMtx.unlock();
+
+    // No map for this host pointer found!
+    if (!TM) {
+      DP("Host ptr " DPxMOD " does not have a matching target pointer.\n",
+         DPxPTR(host_ptr));
+      return OFFLOAD_FAIL;
+    }
+
+    // get target table.
+    TrlTblMtx.lock();
+    assert(TM->Table->TargetsTable.size() > (size_t)device_id &&
+           "Not expecting a device ID outside the table's bounds!");
+    TargetTable = TM->Table->TargetsTable[device_id];
     TrlTblMtx.unlock();
-  } else {
-    TM = &TableMapIt->second;
-  }
-  TblMapMtx.unlock();
+    assert(TargetTable && "Global data has not been mapped\n");
 
-  // No map for this host pointer found!
-  if (!TM) {
-    DP("Host ptr " DPxMOD " does not have a matching target pointer.\n",
-       DPxPTR(host_ptr));
-    return OFFLOAD_FAIL;
+    LaunchCache.Entries[CacheKey] = std::make_pair(TM, TargetTable);
   }
 
-  // get target table.
-  TrlTblMtx.lock();
-  assert(TM->Table->TargetsTable.size() > (size_t)device_id &&
-         "Not expecting a device ID outside the table's bounds!");
-  __tgt_target_table *TargetTable = TM->Table->TargetsTable[device_id];
-  TrlTblMtx.unlock();
-  assert(TargetTable && "Global data has not been mapped\n");
+  // The transfers and the launch are queued and waited for at once at the end
+  // of target_data_end.
+  __tgt_async_info AsyncInfo = {NULL};
+  PtrUpdateListTy PtrUpdates;
 
   // Move data to device.
   int rc = target_data_begin(Device, arg_num, args_base, args, arg_sizes,
-      arg_types);
+      arg_types, &AsyncInfo, PtrUpdates);
 
   if (rc != OFFLOAD_SUCCESS) {
     DP("Call to target_data_begin failed, skipping target execution.\n");
     // Call target_data_end to dealloc whatever target_data_begin allocated
     // and return OFFLOAD_FAIL.
-    target_data_end(Device, arg_num, args_base, args, arg_sizes, arg_types);
+    target_data_end(Device, arg_num, args_base, args, arg_sizes, arg_types,
+        &AsyncInfo);
     return OFFLOAD_FAIL;
   }
 
@@ -2052,6 +2989,11 @@ static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
   // List of (first-)private arrays allocated for this target region
   std::vector<int32_t> privateMaps;
 
+  // Transfers to (first-)private arrays, and pointers submitted to private
+  // parents.
+  TransferBatchTy privateBatch(Device.RTL->RealDevicePtrs);
+  PtrUpdateListTy privatePtrUpdates;
+
   for (int32_t i = 0; i < arg_num; ++i) {
     void *HstPtrBegin = args[i];
     void *HstPtrBase = args_base[i];
@@ -2068,11 +3010,7 @@ static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
       TgtPtrBegin = Device.getTgtPtrBegin(HstPtrBegin, arg_sizes[i], IsLast, /*UpdateRef=*/false);
       TgtBaseOffset = (intptr_t)HstPtrBase - (intptr_t)ParentHstPtrBase;
       ParentTgtPtrBegin = (void*)((intptr_t)ParentTgtPtrBegin + TgtBaseOffset);
-      rc = Device.data_submit(ParentTgtPtrBegin, &TgtPtrBegin, sizeof(void*));
-      if (rc != OFFLOAD_SUCCESS) {
-        DP ("Copying data to device failed.\n");
-        break;
-      }
+      privatePtrUpdates.add(ParentTgtPtrBegin, TgtPtrBegin);
       continue;
     }
     if (!(arg_types[i] & OMP_TGT_MAPTYPE_TARGET_PARAM)) {
@@ -2108,14 +3046,8 @@ static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
             DPxPTR(HstPtrBegin), DPxPTR(TgtPtrBase));
 #endif
         // If first-private, copy data from host
-        if (arg_types[i] & OMP_TGT_MAPTYPE_TO) {
-          int rt = Device.data_submit(TgtPtrBegin, HstPtrBegin, arg_sizes[i]);
-          if (rt != OFFLOAD_SUCCESS) {
-            DP ("Copying data to device failed.\n");
-            rc = OFFLOAD_FAIL;
-            break;
-          }
-        }
+        if (arg_types[i] & OMP_TGT_MAPTYPE_TO)
+          privateBatch.add(TgtPtrBegin, HstPtrBegin, arg_sizes[i]);
       }
     } else if (arg_types[i] & OMP_TGT_MAPTYPE_PTR_AND_OBJ) {
       TgtPtrBegin = Device.getTgtPtrBegin(HstPtrBase, sizeof(void *), IsLast,
@@ -2142,9 +3074,12 @@ static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
   assert(tgt_args.size() == tgt_offsets.size() &&
       "Size mismatch in arguments and offsets");
 
-  // Pop loop trip count
-  uint64_t ltc = Device.loopTripCnt;
-  Device.loopTripCnt = 0;
+  privatePtrUpdates.flush(privateBatch);
+  if (rc == OFFLOAD_SUCCESS &&
+      Device.data_submit(privateBatch, &AsyncInfo) != OFFLOAD_SUCCESS) {
+    DP ("Copying data to device failed.\n");
+    rc = OFFLOAD_FAIL;
+  }
 
   // Launch device execution.
   if (rc == OFFLOAD_SUCCESS) {
@@ -2154,17 +3089,27 @@ static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
     if (IsTeamConstruct) {
       rc = Device.run_team_region(TargetTable->EntriesBegin[TM->Index].addr,
           &tgt_args[0], &tgt_offsets[0], &tgt_sizes[0], tgt_args.size(), team_num,
-          thread_limit, ltc);
+          thread_limit, loop_tripcount, &AsyncInfo);
     } else {
       rc = Device.run_region(TargetTable->EntriesBegin[TM->Index].addr,
-          &tgt_args[0], &tgt_offsets[0], &tgt_sizes[0], tgt_args.size());
+          &tgt_args[0], &tgt_offsets[0], &tgt_sizes[0], tgt_args.size(),
+          &AsyncInfo);
     }
   } else {
     DP("Errors occurred while obtaining target arguments, skipping kernel "
         "execution\n");
   }
 
-  // Deallocate (first-)private arrays
+  // Move data from device.
+  int rt = target_data_end(Device, arg_num, args_base, args, arg_sizes,
+      arg_types, &AsyncInfo);
+
+  if (rt != OFFLOAD_SUCCESS) {
+    DP("Call to target_data_end failed.\n");
+    rc = OFFLOAD_FAIL;
+  }
+
+  // Deallocate (first-)private arrays, the region is over.
   for (int32_t i : privateMaps) {
     void *HstPtrBegin = args[i];
     int rt = Device.deallocTgtPtr(HstPtrBegin, arg_sizes[i], /*ForceDelete=*/true);
@@ -2174,15 +3119,6 @@ static int target(int64_t device_id, void *host_ptr, int32_t arg_num,
     }
   }
 
-  // Move data from device.
-  int rt = target_data_end(Device, arg_num, args_base, args, arg_sizes,
-      arg_types);
-
-  if (rt != OFFLOAD_SUCCESS) {
-    DP("Call to target_data_end failed.\n");
-    rc = OFFLOAD_FAIL;
-  }
-
   return rc;
 }
 
@@ -2211,7 +3147,7 @@ EXTERN int __tgt_target(int64_t device_id, void *host_ptr, int32_t arg_num,
 #endif
 
   int rc = target(device_id, host_ptr, arg_num, args_base, args, arg_sizes,
-      arg_types, 0, 0, false /*team*/);
+      arg_types, 0, 0, false /*team*/, 0);
 
   return rc;
 }
@@ -2219,23 +3155,18 @@ EXTERN int __tgt_target(int64_t device_id, void *host_ptr, int32_t arg_num,
 EXTERN int __tgt_target_nowait(int64_t device_id, void *host_ptr,
     int32_t arg_num, void **args_base, void **args, int64_t *arg_sizes,
     int64_t *arg_types) {
-
-  return __tgt_target(device_id, host_ptr, arg_num, args_base, args, arg_sizes,
-                      arg_types);
+  AsyncTargetOpTy *Op = new_async_op(AsyncTargetOpTy::Target, device_id,
+      arg_num, args_base, args, arg_sizes, arg_types);
+  Op->HostPtr = host_ptr;
+  return submit_async_op(Op, 0, NULL, 0, NULL, /*Wait=*/true);
 }
 
-EXTERN int __tgt_target_teams(int64_t device_id, void *host_ptr,
-    int32_t arg_num, void **args_base, void **args, int64_t *arg_sizes,
-    int64_t *arg_types, int32_t team_num, int32_t thread_limit) {
-  device_id = translate_device_id(device_id);
-
+static int target_teams(int64_t device_id, void *host_ptr, int32_t arg_num,
+    void **args_base, void **args, int64_t *arg_sizes, int64_t *arg_types,
+    int32_t team_num, int32_t thread_limit, uint64_t loop_tripcount) {
   DP("Entering target region with entry point " DPxMOD " and device Id %" PRId64
       " with %d mappings\n", DPxPTR(host_ptr), device_id, arg_num);
 
-  if (device_id == OFFLOAD_DEVICE_DEFAULT) {
-    device_id = omp_get_default_device();
-  }
-
   if (CheckDevice(device_id) != OFFLOAD_SUCCESS) {
     DP("Failed to get device %" PRId64 " ready\n", device_id);
     return OFFLOAD_FAIL;
@@ -2250,19 +3181,43 @@ EXTERN int __tgt_target_teams(int64_t device_id, void *host_ptr,
 #endif
 
   int rc = target(device_id, host_ptr, arg_num, args_base, args, arg_sizes,
-      arg_types, team_num, thread_limit, true /*team*/);
+      arg_types, team_num, thread_limit, true /*team*/, loop_tripcount);
 
   return rc;
 }
 
-EXTERN int __tgt_target_teams_nowait(int64_t device_id, void *host_ptr,
+EXTERN int __tgt_target_teams(int64_t device_id, void *host_ptr,
     int32_t arg_num, void **args_base, void **args, int64_t *arg_sizes,
     int64_t *arg_types, int32_t team_num, int32_t thread_limit) {
+  device_id = translate_device_id(device_id);
+
+  if (device_id == OFFLOAD_DEVICE_DEFAULT) {
+    device_id = omp_get_default_device();
+  }
 
-  return __tgt_target_teams(device_id, host_ptr, arg_num, args_base, args,
-                            arg_sizes, arg_types, team_num, thread_limit);
+  return target_teams(device_id, host_ptr, arg_num, args_base, args, arg_sizes,
+      arg_types, team_num, thread_limit, pop_loop_tripcount(device_id));
 }
 
+EXTERN int __tgt_target_teams_nowait(int64_t device_id, void *host_ptr,
+    int32_t arg_num, void **args_base, void **args, int64_t *arg_sizes,
+    int64_t *arg_types, int32_t team_num, int32_t thread_limit) {
+  device_id = translate_device_id(device_id);
+
+  if (device_id == OFFLOAD_DEVICE_DEFAULT) {
+    device_id = omp_get_default_device();
+  }
+
+  AsyncTargetOpTy *Op = new_async_op(AsyncTargetOpTy::TargetTeams, device_id,
+      arg_num, args_base, args, arg_sizes, arg_types);
+  Op->HostPtr = host_ptr;
+  Op->TeamNum = team_num;
+  Op->ThreadLimit = thread_limit;
+  // The trip count belongs to the construct being encountered, pop it now
+  // rather than when an offload thread runs the region.
+  Op->LoopTripCount = pop_loop_tripcount(device_id);
+  return submit_async_op(Op, 0, NULL, 0, NULL, /*Wait=*/true);
+}
 
 // The trip count mechanism will be revised - this scheme is not thread-safe.
 EXTERN void __kmpc_push_target_tripcount(int64_t device_id,
@@ -2282,6 +3237,19 @@ EXTERN void __kmpc_push_target_tripcount(int64_t device_id,
   Devices[device_id].loopTripCnt = loop_tripcount;
 }
 
+/// Returns the loop trip count pushed for a device and resets it.
+static uint64_t pop_loop_tripcount(int64_t device_id) {
+  RTLsMtx.lock();
+  size_t Devices_size = Devices.size();
+  RTLsMtx.unlock();
+  if (device_id < 0 || Devices_size <= (size_t)device_id)
+    return 0;
+
+  uint64_t ltc = Devices[device_id].loopTripCnt;
+  Devices[device_id].loopTripCnt = 0;
+  return ltc;
+}
+
 EXTERN kmp_task_t *__kmpc_omp_target_task_alloc(ident_t *loc_ref,
     kmp_int32 gtid, kmp_int32 flags, size_t sizeof_kmp_task_t,
     size_t sizeof_shareds, kmp_routine_entry_t task_entry, int64_t device_id) {
@@ -2294,9 +3262,9 @@ EXTERN kmp_task_t *__kmpc_omp_target_task_alloc(ident_t *loc_ref,
     return NULL;
   }
 
-  DP("__kmpc_omp_target_task_alloc(...) not yet implemented, returning NULL");
-//  return Klegacy_TaskAlloc(flag | KLEGACY_TARGET_TASK, sizeOfTaskInclPrivate,
-//    sizeOfSharedTable, sub, device_id, TRUE);
+  // The target task is a regular task; the nowait entry point called from its
+  // body hands the region over to a proxy task run by the offload threads.
+  DP("__kmpc_omp_target_task_alloc(...) allocating a regular task\n");
   return __kmpc_omp_task_alloc(loc_ref, gtid, flags, sizeof_kmp_task_t,
       sizeof_shareds, task_entry);
 }
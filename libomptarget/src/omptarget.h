@@ -100,6 +100,13 @@ struct __tgt_target_table {
       *EntriesEnd; // End of the table with all the entries (non inclusive)
 };
 
+/// This struct identifies a queue of asynchronous operations of a device,
+/// created by the target runtime on first use. Queue is NULL when there is
+/// no pending operation.
+struct __tgt_async_info {
+  void *Queue; // Opaque handle of the queue in the target runtime
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -119,11 +126,32 @@ typedef struct kmp_task {
   kmp_cmplrdata_t data1;
   kmp_cmplrdata_t data2;
 } kmp_task_t;
+typedef struct kmp_depend_info {
+  intptr_t base_addr;
+  size_t len;
+  struct {
+    bool in : 1;
+    bool out : 1;
+  } flags;
+} kmp_depend_info_t;
 int omp_get_default_device(void) __attribute__((weak));
 kmp_int32 __kmpc_omp_taskwait(ident_t *loc_ref, kmp_int32 gtid) __attribute__((weak));
 kmp_task_t *__kmpc_omp_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
     kmp_int32 flags, size_t sizeof_kmp_task_t, size_t sizeof_shareds,
     kmp_routine_entry_t task_entry) __attribute__((weak));
+kmp_int32 __kmpc_global_thread_num(ident_t *loc_ref) __attribute__((weak));
+kmp_int32 __kmpc_omp_task(ident_t *loc_ref, kmp_int32 gtid,
+    kmp_task_t *new_task) __attribute__((weak));
+kmp_int32 __kmpc_omp_task_with_deps(ident_t *loc_ref, kmp_int32 gtid,
+    kmp_task_t *new_task, kmp_int32 ndeps, void *dep_list,
+    kmp_int32 ndeps_noalias, void *noalias_dep_list) __attribute__((weak));
+void __kmpc_proxy_task_completed_ooo(kmp_task_t *ptask) __attribute__((weak));
+kmp_task_t *__kmpc_omp_proxy_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
+    size_t sizeof_kmp_task_t, size_t sizeof_shareds,
+    kmp_routine_entry_t task_entry) __attribute__((weak));
+void __kmpc_omp_wait_deps(ident_t *loc_ref, kmp_int32 gtid, kmp_int32 ndeps,
+    kmp_depend_info_t *dep_list, kmp_int32 ndeps_noalias,
+    kmp_depend_info_t *noalias_dep_list) __attribute__((weak));
 
 int omp_get_num_devices(void);
 int omp_get_initial_device(void);
@@ -85,6 +85,56 @@ int32_t __tgt_rtl_run_target_team_region(int32_t ID, void *Entry, void **Args,
                                          int32_t NumTeams, int32_t ThreadLimit,
                                          uint64_t loop_tripcount);
 
+// Optional. Pass the content of NumBuffers host buffers to the target device,
+// the i-th buffer of HostPtrs being Sizes[i] bytes long and written at
+// TargetPtrs[i]. The buffers are written in order, so that the RTL may pack
+// them into fewer messages or files. In case of success, return zero.
+// Otherwise, return an error code.
+int32_t __tgt_rtl_data_submit_batch(int32_t ID, int32_t NumBuffers,
+                                    void **TargetPtrs, void **HostPtrs,
+                                    int64_t *Sizes);
+
+// Optional. Retrieve the content of NumBuffers buffers from the target device,
+// similarly to __tgt_rtl_data_submit_batch. In case of success, return zero.
+// Otherwise, return an error code.
+int32_t __tgt_rtl_data_retrieve_batch(int32_t ID, int32_t NumBuffers,
+                                      void **HostPtrs, void **TargetPtrs,
+                                      int64_t *Sizes);
+
+// The asynchronous entry points below are optional. They queue the operation
+// in AsyncInfo, creating the queue if AsyncInfo->Queue is NULL, and return
+// without waiting for it. Operations of a queue run in order; host data
+// passed to them must stay valid until the queue is synchronized. In case of
+// success, return zero. Otherwise, return an error code.
+int32_t __tgt_rtl_data_submit_async(int32_t ID, void *TargetPtr, void *HostPtr,
+                                    int64_t Size,
+                                    __tgt_async_info *AsyncInfo);
+
+int32_t __tgt_rtl_data_retrieve_async(int32_t ID, void *HostPtr,
+                                      void *TargetPtr, int64_t Size,
+                                      __tgt_async_info *AsyncInfo);
+
+int32_t __tgt_rtl_run_target_team_region_async(int32_t ID, void *Entry,
+    void **Args, ptrdiff_t *Offsets, int64_t *Sizes, int32_t NumArgs,
+    int32_t NumTeams, int32_t ThreadLimit, uint64_t loop_tripcount,
+    __tgt_async_info *AsyncInfo);
+
+// Wait for all the operations queued in AsyncInfo and release the queue. In
+// case all of them succeeded, return zero. Otherwise, return an error code.
+int32_t __tgt_rtl_synchronize(int32_t ID, __tgt_async_info *AsyncInfo);
+
+// Return an integer different from zero if all the operations queued in
+// AsyncInfo are done, without waiting for them. The queue must still be
+// synchronized to be released.
+int32_t __tgt_rtl_query_async(int32_t ID, __tgt_async_info *AsyncInfo);
+
+// Optional. Return an integer different from zero if the pointers returned by
+// __tgt_rtl_data_alloc are addresses in device memory, which can be offset to
+// reach any byte of the allocation. Freed blocks may then be kept for later
+// allocations, and several host sections mapped into one block. Assumed to be
+// zero when missing.
+int32_t __tgt_rtl_has_real_device_ptrs(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,57 @@
+// RUN: %libomptarget-compile-x86_64-unkown-linux-spark
+// RUN: echo "[Spark]" > %t.ini
+// RUN: echo "VerboseMode=quiet" >> %t.ini
+// RUN: echo "Compression=false" >> %t.ini
+// RUN: env OMPCLOUD_CONF_PATH=%t.ini %libomptarget-run-x86_64-unkown-linux-spark | %fcheck-x86_64-unkown-linux-spark
+// RUN: echo "[Spark]" > %t.ini
+// RUN: echo "VerboseMode=quiet" >> %t.ini
+// RUN: echo "AdaptiveCompression=false" >> %t.ini
+// RUN: echo "PersistentDriver=true" >> %t.ini
+// RUN: echo "DriverCommand=%ompcloud-stub-driver" >> %t.ini
+// RUN: env OMPCLOUD_CONF_PATH=%t.ini %libomptarget-run-x86_64-unkown-linux-spark | %fcheck-x86_64-unkown-linux-spark
+
+// Buffers uploaded to the storage of the local provider, either streamed raw
+// or compressed, are read back unchanged. No target region runs, the data are
+// retrieved from the uploaded objects.
+
+#include <stdio.h>
+
+// Below MIN_SIZE_COMPRESSION, always sent raw
+#define SMALL 1000
+// Above MIN_SIZE_COMPRESSION, compressed unless disabled
+#define LARGE (1 << 20)
+
+static int Small[SMALL];
+static int Large[LARGE];
+
+int main(void) {
+  int Errors = 0;
+
+  for (int i = 0; i < SMALL; ++i)
+    Small[i] = i;
+  for (int i = 0; i < LARGE; ++i)
+    Large[i] = i % 1000;
+
+#pragma omp target enter data map(to: Small[0:SMALL], Large[0:LARGE])
+
+  for (int i = 0; i < SMALL; ++i)
+    Small[i] = -1;
+  for (int i = 0; i < LARGE; ++i)
+    Large[i] = -1;
+
+#pragma omp target update from(Small[0:SMALL], Large[0:LARGE])
+
+  for (int i = 0; i < SMALL; ++i)
+    if (Small[i] != i)
+      Errors++;
+  for (int i = 0; i < LARGE; ++i)
+    if (Large[i] != i % 1000)
+      Errors++;
+
+#pragma omp target exit data map(delete: Small[0:SMALL], Large[0:LARGE])
+
+  // CHECK: Round trip done with 0 errors
+  printf("Round trip done with %d errors\n", Errors);
+
+  return Errors != 0;
+}
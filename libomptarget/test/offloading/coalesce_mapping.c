@@ -0,0 +1,65 @@
+// RUN: %libomptarget-compile-run-and-check-aarch64-unknown-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64le-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-x86_64-pc-linux-gnu
+
+// Adjacent slices share one device block, pointers of a struct are updated
+// from one buffer. Each slice keeps its own reference count.
+// coalesce_mapping_release.c checks that the block is released at unmap.
+
+#include <stdio.h>
+
+#define N 1024
+
+struct Pair {
+  int *X;
+  int *Y;
+};
+
+int main(void) {
+  int A[N], B[N], X[N], Y[N];
+  struct Pair P = {X, Y};
+  int Errors = 0;
+
+  for (int i = 0; i < N; ++i) {
+    A[i] = i;
+    B[i] = i;
+    X[i] = i;
+    Y[i] = 0;
+  }
+
+#pragma omp target data map(tofrom: A[N/4:N/4])
+  {
+#pragma omp target map(tofrom: A[0:N/4], A[N/4:N/4], A[N/2:N/4], A[3*N/4:N/4])
+    for (int i = 0; i < N; ++i)
+      A[i] += 1;
+    // The slice mapped by the enclosing region is not copied back yet.
+    for (int i = N/4; i < N/2; ++i)
+      if (A[i] != i)
+        Errors++;
+  }
+
+  // None of the slices is mapped yet, they are coalesced in one block.
+#pragma omp target map(to: B[0:N/4]) map(tofrom: B[N/4:N/4], B[N/2:N/2])
+  for (int i = 0; i < N; ++i)
+    B[i] *= 3;
+
+#pragma omp target map(to: P, P.X[0:N]) map(from: P.Y[0:N])
+  for (int i = 0; i < N; ++i)
+    P.Y[i] = 2 * P.X[i];
+
+  for (int i = 0; i < N; ++i)
+    if (A[i] != i + 1 || Y[i] != 2 * i)
+      Errors++;
+  // The slice mapped to only is not copied back.
+  for (int i = 0; i < N; ++i)
+    if (B[i] != (i < N/4 ? i : 3 * i))
+      Errors++;
+  if (P.X != X || P.Y != Y)
+    Errors++;
+
+  // CHECK: Coalesced mappings done
+  printf("Coalesced mappings %s\n", Errors ? "failed" : "done");
+
+  return Errors;
+}
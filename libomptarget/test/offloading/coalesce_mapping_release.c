@@ -0,0 +1,36 @@
+// RUN: %libomptarget-compile-aarch64-unknown-linux-gnu && env LIBOMPTARGET_DEBUG=1 %libomptarget-run-aarch64-unknown-linux-gnu 2>&1 | %fcheck-aarch64-unknown-linux-gnu
+// RUN: %libomptarget-compile-powerpc64-ibm-linux-gnu && env LIBOMPTARGET_DEBUG=1 %libomptarget-run-powerpc64-ibm-linux-gnu 2>&1 | %fcheck-powerpc64-ibm-linux-gnu
+// RUN: %libomptarget-compile-powerpc64le-ibm-linux-gnu && env LIBOMPTARGET_DEBUG=1 %libomptarget-run-powerpc64le-ibm-linux-gnu 2>&1 | %fcheck-powerpc64le-ibm-linux-gnu
+// RUN: %libomptarget-compile-x86_64-pc-linux-gnu && env LIBOMPTARGET_DEBUG=1 %libomptarget-run-x86_64-pc-linux-gnu 2>&1 | %fcheck-x86_64-pc-linux-gnu
+// REQUIRES: libomptarget-debug
+
+// The device block shared by coalesced slices is released, here to the
+// memory pool, once the last of them is unmapped.
+
+#include <stdio.h>
+
+#define N 1024
+
+int main(void) {
+  int A[N];
+  int Errors = 0;
+
+  for (int i = 0; i < N; ++i)
+    A[i] = i;
+
+#pragma omp target map(tofrom: A[0:N/2], A[N/2:N/2])
+  for (int i = 0; i < N; ++i)
+    A[i] += 1;
+
+  for (int i = 0; i < N; ++i)
+    if (A[i] != i + 1)
+      Errors++;
+
+  // CHECK: Coalescing 2 sections in tgt data [[BLOCK:0x[0-9a-f]+]]
+  // CHECK: Pooled tgt data [[BLOCK]]
+  // CHECK: Coalesced release done
+  printf("Coalesced release %s\n", Errors ? "failed" : "done");
+  fflush(stdout);
+
+  return Errors;
+}
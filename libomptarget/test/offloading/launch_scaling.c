@@ -0,0 +1,52 @@
+// RUN: %libomptarget-compile-run-and-check-aarch64-unknown-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64le-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-x86_64-pc-linux-gnu
+
+// Microbenchmark of concurrent launches: host threads launch target regions
+// on data mapped by an enclosing target data region, so that launches only
+// look mappings up. The launch rate should grow with the number of threads.
+
+#include <stdio.h>
+#include <omp.h>
+
+#define MAX_THREADS 8
+#define LAUNCHES 2000
+
+int main(void) {
+  int Counters[MAX_THREADS * 16] = {0};
+  int Errors = 0;
+
+#pragma omp target data map(tofrom: Counters[0:MAX_THREADS * 16])
+  {
+    for (int NumThreads = 1; NumThreads <= MAX_THREADS; NumThreads *= 2) {
+      double Start = omp_get_wtime();
+#pragma omp parallel num_threads(NumThreads)
+      {
+        int *C = &Counters[omp_get_thread_num() * 16];
+        for (int l = 0; l < LAUNCHES; ++l) {
+#pragma omp target map(tofrom: C[0:1])
+          { C[0]++; }
+        }
+      }
+      double Elapsed = omp_get_wtime() - Start;
+
+      fprintf(stderr, "%d threads: %.0f target regions per second\n",
+              NumThreads, NumThreads * LAUNCHES / Elapsed);
+    }
+  }
+
+  // Thread t took part in the runs with more than t threads
+  for (int t = 0; t < MAX_THREADS; ++t) {
+    int Runs = 0;
+    for (int NumThreads = 1; NumThreads <= MAX_THREADS; NumThreads *= 2)
+      Runs += t < NumThreads;
+    if (Counters[t * 16] != Runs * LAUNCHES)
+      Errors++;
+  }
+
+  // CHECK: Launches are correct
+  printf("Launches are %s\n", Errors ? "incorrect" : "correct");
+
+  return Errors;
+}
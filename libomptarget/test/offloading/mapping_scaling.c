@@ -0,0 +1,69 @@
+// RUN: %libomptarget-compile-run-and-check-aarch64-unknown-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64le-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-x86_64-pc-linux-gnu
+
+// Microbenchmark of the lookup of mapped data: the cost of a target region
+// using a few mapped objects is measured while the number of other mapped
+// objects grows. It should not grow linearly with the number of mappings.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#define MAX_MAPPINGS 40000
+#define LAUNCHES 1000
+
+int main(void) {
+  static int *Objects[MAX_MAPPINGS];
+  int Sizes[] = {1000, 10000, MAX_MAPPINGS};
+  int Mapped = 0;
+  int Errors = 0;
+
+  for (int i = 0; i < MAX_MAPPINGS; ++i) {
+    Objects[i] = (int *)malloc(4 * sizeof(int));
+    Objects[i][0] = i;
+  }
+
+  for (int s = 0; s < 3; ++s) {
+    // Map small objects until Sizes[s] are mapped
+    for (; Mapped < Sizes[s]; ++Mapped) {
+      int *Obj = Objects[Mapped];
+#pragma omp target enter data map(to: Obj[0:4])
+    }
+
+    int *A = Objects[0];
+    int *B = Objects[Mapped / 2];
+    int *C = Objects[Mapped - 1];
+    double Start = omp_get_wtime();
+    for (int l = 0; l < LAUNCHES; ++l) {
+#pragma omp target map(tofrom: A[0:4], B[0:4], C[0:4])
+      {
+        A[1]++;
+        B[1]++;
+        C[1]++;
+      }
+    }
+    double Elapsed = omp_get_wtime() - Start;
+
+#pragma omp target update from(A[0:4], B[0:4], C[0:4])
+    if (A[1] < LAUNCHES || B[1] < LAUNCHES || C[1] < LAUNCHES)
+      Errors++;
+    A[1] = B[1] = C[1] = 0;
+#pragma omp target update to(A[0:4], B[0:4], C[0:4])
+
+    fprintf(stderr, "%d mappings: %.2f us per target region\n", Mapped,
+            Elapsed / LAUNCHES * 1e6);
+  }
+
+  for (int i = 0; i < MAX_MAPPINGS; ++i) {
+    int *Obj = Objects[i];
+#pragma omp target exit data map(delete: Obj[0:4])
+    free(Obj);
+  }
+
+  // CHECK: Mapped data is correct
+  printf("Mapped data is %s\n", Errors ? "incorrect" : "correct");
+
+  return Errors;
+}
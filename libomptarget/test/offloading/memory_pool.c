@@ -0,0 +1,38 @@
+// RUN: %libomptarget-compile-aarch64-unknown-linux-gnu && env LIBOMPTARGET_MEMORY_POOL_STATS=1 %libomptarget-run-aarch64-unknown-linux-gnu 2>&1 | %fcheck-aarch64-unknown-linux-gnu
+// RUN: %libomptarget-compile-powerpc64-ibm-linux-gnu && env LIBOMPTARGET_MEMORY_POOL_STATS=1 %libomptarget-run-powerpc64-ibm-linux-gnu 2>&1 | %fcheck-powerpc64-ibm-linux-gnu
+// RUN: %libomptarget-compile-powerpc64le-ibm-linux-gnu && env LIBOMPTARGET_MEMORY_POOL_STATS=1 %libomptarget-run-powerpc64le-ibm-linux-gnu 2>&1 | %fcheck-powerpc64le-ibm-linux-gnu
+// RUN: %libomptarget-compile-x86_64-pc-linux-gnu && env LIBOMPTARGET_MEMORY_POOL_STATS=1 %libomptarget-run-x86_64-pc-linux-gnu 2>&1 | %fcheck-x86_64-pc-linux-gnu
+
+// Repeated mappings of similar sizes are served from the device memory pool
+// once the first iteration has released its blocks.
+
+#include <stdio.h>
+
+#define ITERS 64
+#define N 1000
+
+int main(void) {
+  int A[N + ITERS];
+  int Errors = 0;
+
+  for (int it = 0; it < ITERS; ++it) {
+    int Size = N + it % 8;
+    for (int i = 0; i < Size; ++i)
+      A[i] = i;
+#pragma omp target map(tofrom: A[0:Size])
+    for (int i = 0; i < Size; ++i)
+      A[i] += it;
+    for (int i = 0; i < Size; ++i)
+      if (A[i] != i + it)
+        Errors++;
+  }
+
+  // CHECK: Memory pool done
+  printf("Memory pool %s\n", Errors ? "failed" : "done");
+  // The statistics are printed when the library is unregistered at exit.
+  fflush(stdout);
+
+  return Errors;
+}
+
+// CHECK: memory pool of device 0: {{[0-9]+}} allocations, {{[0-9]+}} reused
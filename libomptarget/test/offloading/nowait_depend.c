@@ -0,0 +1,53 @@
+// RUN: %libomptarget-compile-run-and-check-aarch64-unknown-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-powerpc64le-ibm-linux-gnu
+// RUN: %libomptarget-compile-run-and-check-x86_64-pc-linux-gnu
+
+// Chains of nowait target constructs ordered by dependences. Independent
+// chains may run concurrently, the dependences within a chain must hold.
+
+#include <stdio.h>
+#include <omp.h>
+
+#define CHAINS 4
+#define N 1024
+
+int main(void) {
+  int A[CHAINS][N];
+  int Errors = 0;
+
+  for (int c = 0; c < CHAINS; ++c)
+    for (int i = 0; i < N; ++i)
+      A[c][i] = c;
+
+  double Start = omp_get_wtime();
+#pragma omp parallel num_threads(CHAINS)
+#pragma omp single
+  {
+    for (int c = 0; c < CHAINS; ++c) {
+      int *P = A[c];
+#pragma omp target enter data map(to: P[0:N]) nowait depend(out: P[0])
+#pragma omp target nowait depend(inout: P[0])
+      for (int i = 0; i < N; ++i)
+        P[i] += 1;
+#pragma omp target nowait depend(inout: P[0])
+      for (int i = 0; i < N; ++i)
+        P[i] *= 2;
+#pragma omp target exit data map(from: P[0:N]) nowait depend(in: P[0])
+    }
+#pragma omp taskwait
+  }
+  double Time = omp_get_wtime() - Start;
+
+  for (int c = 0; c < CHAINS; ++c)
+    for (int i = 0; i < N; ++i)
+      if (A[c][i] != (c + 1) * 2)
+        Errors++;
+
+  fprintf(stderr, "%d chains of nowait regions: %f s\n", CHAINS, Time);
+
+  // CHECK: Nowait regions done
+  printf("Nowait regions %s\n", Errors ? "failed" : "done");
+
+  return Errors;
+}
@@ -2023,6 +2023,21 @@ typedef enum kmp_tasking_mode {
 extern kmp_tasking_mode_t
     __kmp_tasking_mode; /* determines how/when to execute tasks */
 extern kmp_int32 __kmp_task_stealing_constraint;
+
+typedef enum kmp_task_deque_kind {
+  task_deque_locked = 0, /* ring buffer protected by td_deque_lock */
+  task_deque_lock_free = 1 /* Chase-Lev deque, lock-free for the owner */
+} kmp_task_deque_kind_t;
+
+extern kmp_task_deque_kind_t __kmp_task_deque_kind; /* set by KMP_TASK_DEQUE */
+
+typedef enum kmp_task_steal_order {
+  task_steal_random = 0, /* random victim, then the last one stolen from */
+  task_steal_topology = 1 /* nearest victims in the machine hierarchy first */
+} kmp_task_steal_order_t;
+
+extern kmp_task_steal_order_t
+    __kmp_task_steal_order; /* set by KMP_TASK_STEAL_ORDER */
 #if OMP_40_ENABLED
 extern kmp_int32 __kmp_default_device; // Set via OMP_DEFAULT_DEVICE if
 // specified, defaults to 0 otherwise
@@ -2139,22 +2154,58 @@ union KMP_ALIGN_CACHE kmp_depnode {
   kmp_base_depnode_t dn;
 };
 
+// Entries are stored inline in the open addressing table of kmp_dephash. A
+// slot is free when its addr is 0, the entry of address 0 itself is kept aside
+// in kmp_dephash.null_entry.
 struct kmp_dephash_entry {
   kmp_intptr_t addr;
   kmp_depnode_t *last_out;
   kmp_depnode_list_t *last_ins;
-  kmp_dephash_entry_t *next_in_bucket;
 };
 
 typedef struct kmp_dephash {
-  kmp_dephash_entry_t **buckets;
+  kmp_dephash_entry_t *entries; // linear probing, size is a power of two
   size_t size;
+  size_t nelements;
+  kmp_dephash_entry_t null_entry;
 #ifdef KMP_DEBUG
-  kmp_uint32 nelements;
   kmp_uint32 nconflicts;
 #endif
 } kmp_dephash_t;
 
+#if OMP_45_ENABLED
+// Task captured by the recording of a task graph, see __kmpc_taskgraph_begin.
+typedef struct kmp_taskgraph_task {
+  kmp_depnode_t node; // must stay first, the recorded successors point to it
+  kmp_int32 index; // position in kmp_taskgraph.tasks
+  kmp_int32 npredecessors;
+  kmp_int32 nsuccessors;
+  kmp_int32 *successors; // indices of the successor tasks
+  kmp_taskdata_t *task; // copy of the task as it was created
+} kmp_taskgraph_task_t;
+
+typedef enum kmp_taskgraph_state {
+  taskgraph_recording = 0, /* the first region creates and records the tasks */
+  taskgraph_ready, /* the next regions replay the recorded tasks */
+  taskgraph_disabled /* the region cannot be replayed, it always runs */
+} kmp_taskgraph_state_t;
+
+typedef struct kmp_taskgraph {
+  kmp_int32 id;
+  kmp_int32 gtid; // graphs are recorded and replayed by a single thread
+  kmp_taskdata_t *parent; // task which recorded the graph
+  void *frame; // where the stack of the caller of the region ended
+  void *site; // return address of the call starting the region
+  kmp_int32 nested; // regions started inside the recording of the graph
+  volatile kmp_int32 state; // kmp_taskgraph_state_t
+  kmp_int32 ntasks;
+  kmp_int32 max_tasks;
+  kmp_taskgraph_task_t **tasks; // recorded tasks, in creation order
+  kmp_dephash_t *dephash; // dependences of the recorded tasks while recording
+  struct kmp_taskgraph *next;
+} kmp_taskgraph_t;
+#endif
+
 #endif
 
 #ifdef BUILD_TIED_TASK_STACK
@@ -2210,7 +2261,8 @@ typedef struct kmp_tasking_flags { /* Total struct must be exactly 32 bits */
   unsigned complete : 1; /* 1==complete, 0==not complete   */
   unsigned freed : 1; /* 1==freed, 0==allocateed        */
   unsigned native : 1; /* 1==gcc-compiled task, 0==intel */
-  unsigned reserved31 : 7; /* reserved for library use */
+  unsigned recorded : 1; /* 1==captured by a task graph recording */
+  unsigned reserved31 : 6; /* reserved for library use */
 
 } kmp_tasking_flags_t;
 
@@ -2242,6 +2294,9 @@ struct kmp_taskdata { /* aligned during dynamic allocation       */
       *td_dephash; // Dependencies for children tasks are tracked from here
   kmp_depnode_t
       *td_depnode; // Pointer to graph node if this task has dependencies
+#if OMP_45_ENABLED
+  kmp_taskgraph_t *td_taskgraph; // Task graph recorded from the child tasks
+#endif
 #endif
 #if OMPT_SUPPORT
   ompt_task_info_t ompt_task_info;
@@ -2255,6 +2310,16 @@ struct kmp_taskdata { /* aligned during dynamic allocation       */
 // Make sure padding above worked
 KMP_BUILD_ASSERT(sizeof(kmp_taskdata_t) % sizeof(void *) == 0);
 
+// Array of a lock-free task deque. An array replaced by a larger one is kept
+// in prev until the deque is freed since thieves may still read it.
+typedef struct kmp_task_deque_array {
+  struct kmp_task_deque_array *prev;
+  kmp_int64 mask; // size - 1, the size is a power of two
+  kmp_taskdata_t *volatile tasks[1]; // indexed by position & mask
+} kmp_task_deque_array_t;
+
+#define INITIAL_TASK_DEQUE_ARRAY_SIZE (1 << 8)
+
 // Data for task team but per thread
 typedef struct kmp_base_thread_data {
   kmp_info_p *td_thr; // Pointer back to thread info
@@ -2269,6 +2334,22 @@ typedef struct kmp_base_thread_data {
   kmp_int32 td_deque_ntasks; // Number of tasks in deque
   // GEH: shouldn't this be volatile since used in while-spin?
   kmp_int32 td_deque_last_stolen; // Thread number of last successful steal
+  // Chase-Lev deque used with KMP_TASK_DEQUE=lock_free: the owner pushes and
+  // pops at the bottom, thieves take from the top with a CAS. The locked deque
+  // above then only receives the proxy tasks given by other threads.
+  kmp_task_deque_array_t *volatile td_lf_array;
+  volatile kmp_int64 td_lf_top; // next position to steal
+  volatile kmp_int64 td_lf_bottom; // next position to push
+  volatile kmp_int32 td_lf_thieves; // finished threads stealing from it
+  // Steal order used with KMP_TASK_STEAL_ORDER=topology: the other threads
+  // sorted by distance in the machine hierarchy, and the distance of each
+  // thread by tid. Built by the owner for the team and place it was in.
+  kmp_int32 *td_steal_order;
+  kmp_uint32 *td_steal_dist;
+  kmp_int32 td_steal_nproc; // team size the order was built for
+  kmp_uint32 td_steal_depth; // steals at this distance are remote
+  kmp_team_p *td_steal_team; // team the order was built for
+  int td_steal_place; // place of the owner when the order was built
 #ifdef BUILD_TIED_TASK_STACK
   kmp_task_stack_t td_susp_tied_tasks; // Stack of suspended tied tasks for task
 // scheduling constraint
@@ -2287,6 +2368,17 @@ typedef union KMP_ALIGN_CACHE kmp_thread_data {
   char td_pad[KMP_PAD(kmp_base_thread_data_t, CACHE_LINE)];
 } kmp_thread_data_t;
 
+#if OMP_45_ENABLED
+// Shared deque of the tasks with a given priority, the deques of a task team
+// are kept in a list sorted by decreasing priority. Only td_deque_lock and the
+// deque fields of td are used.
+typedef struct kmp_task_pri {
+  kmp_thread_data_t td;
+  kmp_int32 priority;
+  struct kmp_task_pri *next;
+} kmp_task_pri_t;
+#endif
+
 // Data for task teams which are used when tasking is enabled for the team
 typedef struct kmp_base_task_team {
   kmp_bootstrap_lock_t
@@ -2305,6 +2397,9 @@ typedef struct kmp_base_task_team {
 #if OMP_45_ENABLED
   kmp_int32
       tt_found_proxy_tasks; /* Have we found proxy tasks since last barrier */
+  kmp_bootstrap_lock_t
+      tt_task_pri_lock; /* Lock used to insert in the priority deque list */
+  kmp_task_pri_t *tt_task_pri_list; /* Priority deques, highest first */
 #endif
 
   KMP_ALIGN_CACHE
@@ -2313,6 +2408,11 @@ typedef struct kmp_base_task_team {
   KMP_ALIGN_CACHE
   volatile kmp_uint32
       tt_active; /* is the team still actively executing tasks */
+
+#if OMP_45_ENABLED
+  KMP_ALIGN_CACHE
+  volatile kmp_int32 tt_num_task_pri; /* #tasks in the priority deques */
+#endif
 } kmp_base_task_team_t;
 
 union KMP_ALIGN_CACHE kmp_task_team {
@@ -3248,6 +3348,10 @@ extern int kmp_set_thread_affinity_mask_initial(void);
 
 extern void __kmp_cleanup_hierarchy();
 extern void __kmp_get_hierarchy(kmp_uint32 nproc, kmp_bstate_t *thr_bar);
+extern kmp_uint32 __kmp_get_hierarchy_distance(kmp_info_t *th_a,
+                                               kmp_info_t *th_b,
+                                               kmp_uint32 nproc,
+                                               kmp_uint32 *depth);
 
 #if KMP_USE_FUTEX
 
@@ -3632,6 +3736,20 @@ KMP_EXPORT void __kmpc_omp_wait_deps(ident_t *loc_ref, kmp_int32 gtid,
 extern void __kmp_release_deps(kmp_int32 gtid, kmp_taskdata_t *task);
 extern void __kmp_dephash_free_entries(kmp_info_t *thread, kmp_dephash_t *h);
 extern void __kmp_dephash_free(kmp_info_t *thread, kmp_dephash_t *h);
+#if OMP_45_ENABLED
+KMP_EXPORT kmp_int32 __kmpc_taskgraph_begin(ident_t *loc, kmp_int32 gtid,
+                                            kmp_int32 graph_id);
+KMP_EXPORT void __kmpc_taskgraph_end(ident_t *loc, kmp_int32 gtid,
+                                     kmp_int32 graph_id);
+extern void __kmp_taskgraph_record(kmp_int32 gtid,
+                                   kmp_taskdata_t *current_task,
+                                   kmp_task_t *new_task, kmp_int32 ndeps,
+                                   kmp_depend_info_t *dep_list,
+                                   kmp_int32 ndeps_noalias,
+                                   kmp_depend_info_t *noalias_dep_list);
+extern void __kmp_taskgraph_disable(kmp_taskgraph_t *graph);
+extern void __kmp_taskgraph_cleanup(void);
+#endif
 
 extern kmp_int32 __kmp_omp_task(kmp_int32 gtid, kmp_task_t *new_task,
                                 bool serialize_immediate);
@@ -3647,6 +3765,9 @@ KMP_EXPORT int __kmp_get_cancellation_status(int cancel_kind);
 
 KMP_EXPORT void __kmpc_proxy_task_completed(kmp_int32 gtid, kmp_task_t *ptask);
 KMP_EXPORT void __kmpc_proxy_task_completed_ooo(kmp_task_t *ptask);
+KMP_EXPORT kmp_task_t *__kmpc_omp_proxy_task_alloc(
+    ident_t *loc_ref, kmp_int32 gtid, size_t sizeof_kmp_task_t,
+    size_t sizeof_shareds, kmp_routine_entry_t task_entry);
 KMP_EXPORT void __kmpc_taskloop(ident_t *loc, kmp_int32 gtid, kmp_task_t *task,
                                 kmp_int32 if_val, kmp_uint64 *lb,
                                 kmp_uint64 *ub, kmp_int64 st, kmp_int32 nogroup,
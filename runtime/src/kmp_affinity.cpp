@@ -3778,6 +3778,9 @@ static int __kmp_affinity_max_proc_per_core(const AddrUnsPair *address2os,
 static AddrUnsPair *address2os = NULL;
 static int *procarr = NULL;
 static int __kmp_aff_depth = 0;
+#if OMP_40_ENABLED
+static int *place2addr = NULL; // address2os index of the first proc of places
+#endif
 
 #define KMP_EXIT_AFF_NONE                                                      \
   KMP_ASSERT(__kmp_affinity_type == affinity_none);                            \
@@ -4309,6 +4312,22 @@ static void __kmp_aux_affinity_initialize(void) {
 
   KMP_CPU_FREE_ARRAY(osId2Mask, maxIndex + 1);
   machine_hierarchy.init(address2os, __kmp_avail_proc);
+
+#if OMP_40_ENABLED
+  // Map the places to the topology for __kmp_get_hierarchy_distance(), now
+  // that address2os is in its final order.
+  place2addr = (int *)__kmp_allocate(__kmp_affinity_num_masks * sizeof(int));
+  for (unsigned p = 0; p < __kmp_affinity_num_masks; ++p) {
+    int osId = KMP_CPU_INDEX(__kmp_affinity_masks, p)->begin();
+    place2addr[p] = -1;
+    for (int i = 0; i < __kmp_avail_proc; ++i) {
+      if (address2os[i].second == (unsigned)osId) {
+        place2addr[p] = i;
+        break;
+      }
+    }
+  }
+#endif
 }
 #undef KMP_EXIT_AFF_NONE
 
@@ -4360,6 +4379,12 @@ void __kmp_affinity_uninitialize(void) {
     __kmp_free(procarr);
     procarr = NULL;
   }
+#if OMP_40_ENABLED
+  if (place2addr != NULL) {
+    __kmp_free(place2addr);
+    place2addr = NULL;
+  }
+#endif
 #if KMP_USE_HWLOC
   if (__kmp_hwloc_topology != NULL) {
     hwloc_topology_destroy(__kmp_hwloc_topology);
@@ -5034,3 +5059,38 @@ extern "C"
 #endif
 
 #endif // KMP_AFFINITY_SUPPORTED
+
+// __kmp_get_hierarchy_distance: return the level of the smallest subtree of the
+// machine hierarchy containing both threads, 0 if they share a leaf. *depth is
+// set to the distance of threads under different children of the root. When
+// the places of the threads are known, the levels are those of the detected
+// topology (e.g. 1 for threads of the same core, 2 for the same package).
+// Otherwise the threads are assumed to be placed by thread number, as for the
+// hierarchical barrier.
+kmp_uint32 __kmp_get_hierarchy_distance(kmp_info_t *th_a, kmp_info_t *th_b,
+                                        kmp_uint32 nproc, kmp_uint32 *depth) {
+#if OMP_40_ENABLED && KMP_AFFINITY_SUPPORTED
+  int place_a = th_a->th.th_current_place;
+  int place_b = th_b->th.th_current_place;
+  if (place2addr != NULL && place_a >= 0 && place_b >= 0 &&
+      place2addr[place_a] >= 0 && place2addr[place_b] >= 0) {
+    const Address &a = address2os[place2addr[place_a]].first;
+    const Address &b = address2os[place2addr[place_b]].first;
+    kmp_uint32 level = 0;
+    while (!a.isClose(b, level))
+      ++level;
+    *depth = a.depth;
+    return level;
+  }
+#endif
+  kmp_bstate_t thr_bar;
+  __kmp_get_hierarchy(nproc, &thr_bar);
+  kmp_uint32 tid_a = th_a->th.th_info.ds.ds_tid;
+  kmp_uint32 tid_b = th_b->th.th_info.ds.ds_tid;
+  kmp_uint32 level = 0;
+  while (level < thr_bar.depth && tid_a / thr_bar.skip_per_level[level] !=
+                                      tid_b / thr_bar.skip_per_level[level])
+    ++level;
+  *depth = thr_bar.depth - 1;
+  return level;
+}
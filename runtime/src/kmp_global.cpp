@@ -315,6 +315,8 @@ KMP_BUILD_ASSERT(sizeof(kmp_tasking_flags_t) == 4);
 
 kmp_int32 __kmp_task_stealing_constraint =
     1; /* Constrain task stealing by default */
+kmp_task_deque_kind_t __kmp_task_deque_kind = task_deque_locked;
+kmp_task_steal_order_t __kmp_task_steal_order = task_steal_random;
 
 #ifdef DEBUG_SUSPEND
 int __kmp_suspend_count = 0;
@@ -838,6 +838,10 @@ void xexpand(KMP_API_NAME_GOMP_TASK)(void (*func)(void *), void *data,
 #if OMP_40_ENABLED
                                      ,
                                      void **depend
+#endif
+#if OMP_45_ENABLED
+                                     ,
+                                     int priority
 #endif
                                      ) {
   MKLOC(loc, "GOMP_task");
@@ -855,6 +859,12 @@ void xexpand(KMP_API_NAME_GOMP_TASK)(void (*func)(void *), void *data,
   if (gomp_flags & 2) {
     input_flags->final = 1;
   }
+#if OMP_45_ENABLED
+  // The fifth low-order bit is the "priority" flag
+  if (gomp_flags & 16) {
+    input_flags->priority_specified = 1;
+  }
+#endif
   input_flags->native = 1;
   // __kmp_task_alloc() sets up all other flags
 
@@ -879,6 +889,11 @@ void xexpand(KMP_API_NAME_GOMP_TASK)(void (*func)(void *), void *data,
       KMP_MEMCPY(task->shareds, data, arg_size);
     }
   }
+#if OMP_45_ENABLED
+  if (input_flags->priority_specified) {
+    task->data2.priority = priority;
+  }
+#endif
 
   if (if_cond) {
 #if OMP_40_ENABLED
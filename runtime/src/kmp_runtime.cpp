@@ -7343,6 +7343,10 @@ void __kmp_cleanup(void) {
   __kmp_cleanup_user_locks();
 #endif
 
+#if OMP_45_ENABLED
+  __kmp_taskgraph_cleanup();
+#endif
+
 #if KMP_AFFINITY_SUPPORTED
   KMP_INTERNAL_FREE(CCAST(char *, __kmp_cpuinfo_file));
   __kmp_cpuinfo_file = NULL;
@@ -1157,6 +1157,46 @@ static void __kmp_stg_print_task_stealing(kmp_str_buf_t *buffer,
   __kmp_stg_print_int(buffer, name, __kmp_task_stealing_constraint);
 } // __kmp_stg_print_task_stealing
 
+static void __kmp_stg_parse_task_deque(char const *name, char const *value,
+                                       void *data) {
+  if (__kmp_str_match("locked", 1, value)) {
+    __kmp_task_deque_kind = task_deque_locked;
+  } else if (__kmp_str_match("lock_free", 5, value) ||
+             __kmp_str_match("chase_lev", 1, value)) {
+    __kmp_task_deque_kind = task_deque_lock_free;
+  } else {
+    KMP_WARNING(StgInvalidValue, name, value);
+  }
+} // __kmp_stg_parse_task_deque
+
+static void __kmp_stg_print_task_deque(kmp_str_buf_t *buffer, char const *name,
+                                       void *data) {
+  __kmp_stg_print_str(buffer, name,
+                      __kmp_task_deque_kind == task_deque_lock_free
+                          ? "lock_free"
+                          : "locked");
+} // __kmp_stg_print_task_deque
+
+static void __kmp_stg_parse_task_steal_order(char const *name,
+                                             char const *value, void *data) {
+  if (__kmp_str_match("random", 1, value)) {
+    __kmp_task_steal_order = task_steal_random;
+  } else if (__kmp_str_match("topology", 1, value) ||
+             __kmp_str_match("hierarchical", 1, value)) {
+    __kmp_task_steal_order = task_steal_topology;
+  } else {
+    KMP_WARNING(StgInvalidValue, name, value);
+  }
+} // __kmp_stg_parse_task_steal_order
+
+static void __kmp_stg_print_task_steal_order(kmp_str_buf_t *buffer,
+                                             char const *name, void *data) {
+  __kmp_stg_print_str(buffer, name,
+                      __kmp_task_steal_order == task_steal_topology
+                          ? "topology"
+                          : "random");
+} // __kmp_stg_print_task_steal_order
+
 static void __kmp_stg_parse_max_active_levels(char const *name,
                                               char const *value, void *data) {
   __kmp_stg_parse_int(name, value, 0, KMP_MAX_ACTIVE_LEVELS_LIMIT,
@@ -4400,6 +4440,10 @@ static kmp_setting_t __kmp_stg_table[] = {
      0},
     {"KMP_TASK_STEALING_CONSTRAINT", __kmp_stg_parse_task_stealing,
      __kmp_stg_print_task_stealing, NULL, 0, 0},
+    {"KMP_TASK_DEQUE", __kmp_stg_parse_task_deque, __kmp_stg_print_task_deque,
+     NULL, 0, 0},
+    {"KMP_TASK_STEAL_ORDER", __kmp_stg_parse_task_steal_order,
+     __kmp_stg_print_task_steal_order, NULL, 0, 0},
     {"OMP_MAX_ACTIVE_LEVELS", __kmp_stg_parse_max_active_levels,
      __kmp_stg_print_max_active_levels, NULL, 0, 0},
 #if OMP_40_ENABLED
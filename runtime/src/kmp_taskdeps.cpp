@@ -70,12 +70,42 @@ static inline void __kmp_node_deref(kmp_info_t *thread, kmp_depnode_t *node) {
 
 static void __kmp_depnode_list_free(kmp_info_t *thread, kmp_depnode_list *list);
 
-enum { KMP_DEPHASH_OTHER_SIZE = 97, KMP_DEPHASH_MASTER_SIZE = 997 };
+// Initial number of slots of the hash tables, they must be powers of two. The
+// tables grow as soon as they are more than KMP_DEPHASH_MAX_LOAD percent full.
+enum {
+  KMP_DEPHASH_OTHER_SIZE = 32,
+  KMP_DEPHASH_MASTER_SIZE = 1024,
+  KMP_DEPHASH_MAX_LOAD = 75
+};
+
+static inline size_t __kmp_dephash_hash(kmp_intptr_t addr, size_t hsize) {
+  // Fibonacci hashing, the folded product spreads addresses with a large
+  // alignment over the whole table.
+  kmp_uint64 h = (kmp_uint64)addr * 0x9E3779B97F4A7C15ULL;
+  return (size_t)(h ^ (h >> 32)) & (hsize - 1);
+}
+
+static kmp_dephash_entry_t *__kmp_dephash_alloc_entries(kmp_info_t *thread,
+                                                        size_t h_size) {
+  size_t size = h_size * sizeof(kmp_dephash_entry_t);
+  kmp_dephash_entry_t *entries;
+
+#if USE_FAST_MEMORY
+  entries = (kmp_dephash_entry_t *)__kmp_fast_allocate(thread, size);
+#else
+  entries = (kmp_dephash_entry_t *)__kmp_thread_malloc(thread, size);
+#endif
+  memset(entries, 0, size);
+  return entries;
+}
 
-static inline kmp_int32 __kmp_dephash_hash(kmp_intptr_t addr, size_t hsize) {
-  // TODO alternate to try: set = (((Addr64)(addrUsefulBits * 9.618)) %
-  // m_num_sets );
-  return ((addr >> 6) ^ (addr >> 2)) % hsize;
+static void __kmp_dephash_free_table(kmp_info_t *thread,
+                                     kmp_dephash_entry_t *entries) {
+#if USE_FAST_MEMORY
+  __kmp_fast_free(thread, entries);
+#else
+  __kmp_thread_free(thread, entries);
+#endif
 }
 
 static kmp_dephash_t *__kmp_dephash_create(kmp_info_t *thread,
@@ -89,49 +119,48 @@ static kmp_dephash_t *__kmp_dephash_create(kmp_info_t *thread,
   else
     h_size = KMP_DEPHASH_OTHER_SIZE;
 
-  kmp_int32 size =
-      h_size * sizeof(kmp_dephash_entry_t *) + sizeof(kmp_dephash_t);
-
 #if USE_FAST_MEMORY
-  h = (kmp_dephash_t *)__kmp_fast_allocate(thread, size);
+  h = (kmp_dephash_t *)__kmp_fast_allocate(thread, sizeof(kmp_dephash_t));
 #else
-  h = (kmp_dephash_t *)__kmp_thread_malloc(thread, size);
+  h = (kmp_dephash_t *)__kmp_thread_malloc(thread, sizeof(kmp_dephash_t));
 #endif
   h->size = h_size;
-
-#ifdef KMP_DEBUG
   h->nelements = 0;
+  h->null_entry.addr = 0;
+  h->null_entry.last_out = NULL;
+  h->null_entry.last_ins = NULL;
+#ifdef KMP_DEBUG
   h->nconflicts = 0;
 #endif
-  h->buckets = (kmp_dephash_entry **)(h + 1);
-
-  for (size_t i = 0; i < h_size; i++)
-    h->buckets[i] = 0;
+  h->entries = __kmp_dephash_alloc_entries(thread, h_size);
 
   return h;
 }
 
+static inline void __kmp_dephash_free_entry(kmp_info_t *thread,
+                                            kmp_dephash_entry_t *entry) {
+  __kmp_depnode_list_free(thread, entry->last_ins);
+  __kmp_node_deref(thread, entry->last_out);
+  entry->addr = 0;
+  entry->last_out = NULL;
+  entry->last_ins = NULL;
+}
+
+// The table keeps its size so that it does not have to grow again when the
+// implicit task creates as many dependences in the next parallel region.
 void __kmp_dephash_free_entries(kmp_info_t *thread, kmp_dephash_t *h) {
-  for (size_t i = 0; i < h->size; i++) {
-    if (h->buckets[i]) {
-      kmp_dephash_entry_t *next;
-      for (kmp_dephash_entry_t *entry = h->buckets[i]; entry; entry = next) {
-        next = entry->next_in_bucket;
-        __kmp_depnode_list_free(thread, entry->last_ins);
-        __kmp_node_deref(thread, entry->last_out);
-#if USE_FAST_MEMORY
-        __kmp_fast_free(thread, entry);
-#else
-        __kmp_thread_free(thread, entry);
-#endif
-      }
-      h->buckets[i] = 0;
-    }
+  if (h->nelements) {
+    for (size_t i = 0; i < h->size; i++)
+      if (h->entries[i].addr)
+        __kmp_dephash_free_entry(thread, &h->entries[i]);
+    h->nelements = 0;
   }
+  __kmp_dephash_free_entry(thread, &h->null_entry);
 }
 
 void __kmp_dephash_free(kmp_info_t *thread, kmp_dephash_t *h) {
   __kmp_dephash_free_entries(thread, h);
+  __kmp_dephash_free_table(thread, h->entries);
 #if USE_FAST_MEMORY
   __kmp_fast_free(thread, h);
 #else
@@ -139,35 +168,84 @@ void __kmp_dephash_free(kmp_info_t *thread, kmp_dephash_t *h) {
 #endif
 }
 
+#if OMP_45_ENABLED
+// Free the entries of the table if none of them refers to a task which is not
+// finished, they cannot create dependences anymore. Only the owner of the
+// table calls this, a finished task stays finished.
+static bool __kmp_dephash_clear_finished(kmp_info_t *thread,
+                                         kmp_dephash_t *h) {
+  for (size_t i = 0; i <= h->size; i++) {
+    kmp_dephash_entry_t *entry = i < h->size ? &h->entries[i] : &h->null_entry;
+    if (entry->last_out && entry->last_out->dn.task)
+      return false;
+    for (kmp_depnode_list_t *p = entry->last_ins; p; p = p->next)
+      if (p->node->dn.task)
+        return false;
+  }
+  __kmp_dephash_free_entries(thread, h);
+  return true;
+}
+#endif
+
+// Double the size of the table and move the entries to their new slots.
+static void __kmp_dephash_grow(kmp_info_t *thread, kmp_dephash_t *h) {
+  size_t old_size = h->size;
+  size_t new_size = old_size * 2;
+  kmp_dephash_entry_t *old_entries = h->entries;
+  kmp_dephash_entry_t *new_entries =
+      __kmp_dephash_alloc_entries(thread, new_size);
+
+  KA_TRACE(40, ("__kmp_dephash_grow: T#%d growing dependence hash %p from %d "
+                "to %d entries\n",
+                __kmp_gtid_from_thread(thread), h, (int)old_size,
+                (int)new_size));
+
+  for (size_t i = 0; i < old_size; i++) {
+    if (old_entries[i].addr == 0)
+      continue;
+    size_t slot = __kmp_dephash_hash(old_entries[i].addr, new_size);
+    while (new_entries[slot].addr)
+      slot = (slot + 1) & (new_size - 1);
+    new_entries[slot] = old_entries[i];
+  }
+
+  h->entries = new_entries;
+  h->size = new_size;
+  __kmp_dephash_free_table(thread, old_entries);
+}
+
+// The returned entry is only valid until the next lookup, which may move the
+// entries when the table grows.
 static kmp_dephash_entry *
 __kmp_dephash_find(kmp_info_t *thread, kmp_dephash_t *h, kmp_intptr_t addr) {
-  kmp_int32 bucket = __kmp_dephash_hash(addr, h->size);
+  if (addr == 0)
+    return &h->null_entry;
+
+  size_t mask = h->size - 1;
+  size_t slot = __kmp_dephash_hash(addr, h->size);
 
   kmp_dephash_entry_t *entry;
-  for (entry = h->buckets[bucket]; entry; entry = entry->next_in_bucket)
+  for (entry = &h->entries[slot]; entry->addr; entry = &h->entries[slot]) {
     if (entry->addr == addr)
-      break;
+      return entry;
+    slot = (slot + 1) & mask;
+  }
 
-  if (entry == NULL) {
-// create entry. This is only done by one thread so no locking required
-#if USE_FAST_MEMORY
-    entry = (kmp_dephash_entry_t *)__kmp_fast_allocate(
-        thread, sizeof(kmp_dephash_entry_t));
-#else
-    entry = (kmp_dephash_entry_t *)__kmp_thread_malloc(
-        thread, sizeof(kmp_dephash_entry_t));
-#endif
-    entry->addr = addr;
-    entry->last_out = NULL;
-    entry->last_ins = NULL;
-    entry->next_in_bucket = h->buckets[bucket];
-    h->buckets[bucket] = entry;
+  // create entry. This is only done by one thread so no locking required
+  if ((h->nelements + 1) * 100 > h->size * KMP_DEPHASH_MAX_LOAD) {
+    __kmp_dephash_grow(thread, h);
+    mask = h->size - 1;
+    slot = __kmp_dephash_hash(addr, h->size);
+    while (h->entries[slot].addr)
+      slot = (slot + 1) & mask;
+    entry = &h->entries[slot];
+  }
 #ifdef KMP_DEBUG
-    h->nelements++;
-    if (entry->next_in_bucket)
-      h->nconflicts++;
+  if (slot != __kmp_dephash_hash(addr, h->size))
+    h->nconflicts++;
 #endif
-  }
+  entry->addr = addr;
+  h->nelements++;
   return entry;
 }
 
@@ -319,6 +397,21 @@ __kmp_process_deps(kmp_int32 gtid, kmp_depnode_t *node, kmp_dephash_t *hash,
 #define NO_DEP_BARRIER (false)
 #define DEP_BARRIER (true)
 
+// Merge the flags of the items of dep_list with the same address into the
+// first one and mark the others as void
+static void __kmp_filter_deps(kmp_int32 ndeps, kmp_depend_info_t *dep_list) {
+  // TODO: Different algorithm for large dep_list ( > 10 ? )
+  for (kmp_int32 i = 0; i < ndeps; i++) {
+    if (dep_list[i].base_addr != 0)
+      for (kmp_int32 j = i + 1; j < ndeps; j++)
+        if (dep_list[i].base_addr == dep_list[j].base_addr) {
+          dep_list[i].flags.in |= dep_list[j].flags.in;
+          dep_list[i].flags.out |= dep_list[j].flags.out;
+          dep_list[j].base_addr = 0; // Mark j element as void
+        }
+  }
+}
+
 // returns true if the task has any outstanding dependence
 static bool __kmp_check_deps(kmp_int32 gtid, kmp_depnode_t *node,
                              kmp_task_t *task, kmp_dephash_t *hash,
@@ -326,8 +419,6 @@ static bool __kmp_check_deps(kmp_int32 gtid, kmp_depnode_t *node,
                              kmp_depend_info_t *dep_list,
                              kmp_int32 ndeps_noalias,
                              kmp_depend_info_t *noalias_dep_list) {
-  int i;
-
 #if KMP_DEBUG
   kmp_taskdata_t *taskdata = KMP_TASK_TO_TASKDATA(task);
 #endif
@@ -337,16 +428,7 @@ static bool __kmp_check_deps(kmp_int32 gtid, kmp_depnode_t *node,
                 gtid, taskdata, ndeps, ndeps_noalias, dep_barrier));
 
   // Filter deps in dep_list
-  // TODO: Different algorithm for large dep_list ( > 10 ? )
-  for (i = 0; i < ndeps; i++) {
-    if (dep_list[i].base_addr != 0)
-      for (int j = i + 1; j < ndeps; j++)
-        if (dep_list[i].base_addr == dep_list[j].base_addr) {
-          dep_list[i].flags.in |= dep_list[j].flags.in;
-          dep_list[i].flags.out |= dep_list[j].flags.out;
-          dep_list[j].base_addr = 0; // Mark j element as void
-        }
-  }
+  __kmp_filter_deps(ndeps, dep_list);
 
   // doesn't need to be atomic as no other thread is going to be accessing this
   // node just yet.
@@ -472,6 +554,15 @@ kmp_int32 __kmpc_omp_task_with_deps(ident_t *loc_ref, kmp_int32 gtid,
   kmp_info_t *thread = __kmp_threads[gtid];
   kmp_taskdata_t *current_task = thread->th.th_current_task;
 
+#if OMP_45_ENABLED
+  if (current_task->td_taskgraph) {
+    // record the task before it can be released by its predecessors
+    __kmp_taskgraph_record(gtid, current_task, new_task, ndeps, dep_list,
+                           ndeps_noalias, noalias_dep_list);
+    new_taskdata->td_flags.recorded = 1;
+  }
+#endif
+
 #if OMPT_SUPPORT && OMPT_TRACE
   /* OMPT grab all dependences if requested by the tool */
   if (ompt_enabled && ndeps + ndeps_noalias > 0 &&
@@ -588,6 +679,11 @@ void __kmpc_omp_wait_deps(ident_t *loc_ref, kmp_int32 gtid, kmp_int32 ndeps,
   kmp_info_t *thread = __kmp_threads[gtid];
   kmp_taskdata_t *current_task = thread->th.th_current_task;
 
+#if OMP_45_ENABLED
+  if (current_task->td_taskgraph)
+    __kmp_taskgraph_disable(current_task->td_taskgraph);
+#endif
+
   // We can return immediately as:
   // - dependences are not computed in serial teams (except with proxy tasks)
   // - if the dephash is not yet created it means we have nothing to wait for
@@ -633,4 +729,363 @@ void __kmpc_omp_wait_deps(ident_t *loc_ref, kmp_int32 gtid, kmp_int32 ndeps,
                 gtid, loc_ref));
 }
 
+#if OMP_45_ENABLED
+// Task graphs
+//
+// __kmpc_taskgraph_begin and __kmpc_taskgraph_end delimit a region that creates
+// the same tasks with the same dependences each time it is executed, like the
+// timesteps of an iterative solver. The first execution of a graph runs the
+// region and records a copy of each task created by the encountering task,
+// together with the dependences between them. The next executions skip the
+// region and instantiate the recorded tasks with their predecessor counts and
+// successors already resolved, without going through the dependence hash.
+//
+// The recorded tasks keep the values of their private data and of their
+// shareds at the time of the recording. A region that also waits for tasks or
+// creates tasks in another way than with __kmpc_omp_task(_with_deps) is never
+// replayed.
+//
+// A graph belongs to the thread which recorded it, and is recorded again when
+// the region is encountered by another task, from another frame or from
+// another call site, where the shareds or the tasks are not the same. It is
+// not replayed either while tasks created before the region may still be
+// predecessors of its tasks, since the replayed tasks do not go through the
+// dependence hash of their parent.
+
+static kmp_taskgraph_t *__kmp_taskgraphs = NULL;
+static kmp_bootstrap_lock_t __kmp_taskgraph_lock =
+    KMP_BOOTSTRAP_LOCK_INITIALIZER(__kmp_taskgraph_lock);
+
+static void __kmp_taskgraph_free_tasks(kmp_taskgraph_t *graph) {
+  for (kmp_int32 i = 0; i < graph->ntasks; i++) {
+    kmp_taskgraph_task_t *t = graph->tasks[i];
+    if (t->successors)
+      __kmp_free(t->successors);
+    __kmp_free(t->task);
+    __kmp_free(t);
+  }
+  if (graph->tasks)
+    __kmp_free(graph->tasks);
+  graph->tasks = NULL;
+  graph->ntasks = 0;
+  graph->max_tasks = 0;
+}
+
+void __kmp_taskgraph_disable(kmp_taskgraph_t *graph) {
+  KA_TRACE(20, ("__kmp_taskgraph_disable: graph %d cannot be replayed\n",
+                graph->id));
+  TCW_4(graph->state, taskgraph_disabled);
+}
+
+// Called for each task created by a task recording a graph, before the task
+// can be scheduled
+void __kmp_taskgraph_record(kmp_int32 gtid, kmp_taskdata_t *current_task,
+                            kmp_task_t *new_task, kmp_int32 ndeps,
+                            kmp_depend_info_t *dep_list,
+                            kmp_int32 ndeps_noalias,
+                            kmp_depend_info_t *noalias_dep_list) {
+  kmp_info_t *thread = __kmp_threads[gtid];
+  kmp_taskgraph_t *graph = current_task->td_taskgraph;
+  kmp_taskdata_t *new_taskdata = KMP_TASK_TO_TASKDATA(new_task);
+
+  if (graph->state != taskgraph_recording)
+    return;
+
+  // the copy of a task cannot run the destructors of the private data of the
+  // task a second time
+  if (new_taskdata->td_flags.destructors_thunk ||
+      new_taskdata->td_flags.proxy == TASK_PROXY) {
+    __kmp_taskgraph_disable(graph);
+    return;
+  }
+
+  if (graph->ntasks == graph->max_tasks) {
+    kmp_int32 max_tasks = graph->max_tasks ? 2 * graph->max_tasks : 64;
+    kmp_taskgraph_task_t **tasks = (kmp_taskgraph_task_t **)__kmp_allocate(
+        max_tasks * sizeof(kmp_taskgraph_task_t *));
+    if (graph->tasks) {
+      KMP_MEMCPY(tasks, graph->tasks,
+                 graph->ntasks * sizeof(kmp_taskgraph_task_t *));
+      __kmp_free(graph->tasks);
+    }
+    graph->tasks = tasks;
+    graph->max_tasks = max_tasks;
+  }
+
+  // __kmp_allocate clears the memory
+  kmp_taskgraph_task_t *t =
+      (kmp_taskgraph_task_t *)__kmp_allocate(sizeof(kmp_taskgraph_task_t));
+  t->index = graph->ntasks;
+  t->task = (kmp_taskdata_t *)__kmp_allocate(new_taskdata->td_size_alloc);
+  KMP_MEMCPY(t->task, new_taskdata, new_taskdata->td_size_alloc);
+  kmp_task_t *task = KMP_TASKDATA_TO_TASK(t->task);
+  if (new_task->shareds != NULL)
+    task->shareds =
+        (char *)t->task + ((char *)new_task->shareds - (char *)new_taskdata);
+  graph->tasks[graph->ntasks++] = t;
+
+  // The node of a recorded task never completes, so all the dependences
+  // between the recorded tasks are found whatever tasks already finished.
+  __kmp_init_node(&t->node);
+  t->node.dn.task = task;
+
+  if (ndeps + ndeps_noalias > 0) {
+    if (graph->dephash == NULL)
+      graph->dephash = __kmp_dephash_create(thread, current_task);
+    __kmp_filter_deps(ndeps, dep_list);
+    t->npredecessors =
+        __kmp_process_deps<true>(gtid, &t->node, graph->dephash,
+                                 NO_DEP_BARRIER, ndeps, dep_list, task) +
+        __kmp_process_deps<false>(gtid, &t->node, graph->dephash,
+                                  NO_DEP_BARRIER, ndeps_noalias,
+                                  noalias_dep_list, task);
+  }
+  KA_TRACE(40, ("__kmp_taskgraph_record: T#%d recorded task %p as %d in graph "
+                "%d with %d predecessors\n",
+                gtid, new_taskdata, t->index, graph->id, t->npredecessors));
+}
+
+// Turn the successors lists of the recorded nodes into arrays of indices
+static void __kmp_taskgraph_finish_recording(kmp_int32 gtid,
+                                             kmp_taskgraph_t *graph) {
+  kmp_info_t *thread = __kmp_threads[gtid];
+
+  if (graph->dephash) {
+    __kmp_dephash_free(thread, graph->dephash);
+    graph->dephash = NULL;
+  }
+
+  bool keep = graph->state == taskgraph_recording;
+  for (kmp_int32 i = 0; i < graph->ntasks; i++) {
+    kmp_taskgraph_task_t *t = graph->tasks[i];
+    kmp_depnode_list_t *p;
+    kmp_int32 n = 0;
+    for (p = t->node.dn.successors; p; p = p->next)
+      n++;
+    if (keep && n > 0) {
+      t->successors = (kmp_int32 *)__kmp_allocate(n * sizeof(kmp_int32));
+      // the node is the first field of kmp_taskgraph_task_t
+      for (p = t->node.dn.successors; p; p = p->next)
+        t->successors[t->nsuccessors++] =
+            ((kmp_taskgraph_task_t *)p->node)->index;
+    }
+    __kmp_depnode_list_free(thread, t->node.dn.successors);
+    t->node.dn.successors = NULL;
+  }
+
+  if (!keep)
+    __kmp_taskgraph_free_tasks(graph);
+}
+
+// Create the recorded tasks again and schedule those without predecessors
+static void __kmp_taskgraph_replay(kmp_int32 gtid, kmp_taskgraph_t *graph) {
+  kmp_info_t *thread = __kmp_threads[gtid];
+  kmp_taskdata_t *current_task = thread->th.th_current_task;
+  kmp_int32 ntasks = graph->ntasks;
+  kmp_int32 i;
+
+  KA_TRACE(20, ("__kmp_taskgraph_replay: T#%d replaying %d tasks of graph %d\n",
+                gtid, ntasks, graph->id));
+
+  // dependences are ignored in the same cases as in __kmpc_omp_task_with_deps,
+  // the tasks then run in the order of their creation
+  bool serial = current_task->td_flags.team_serial ||
+                current_task->td_flags.tasking_ser ||
+                current_task->td_flags.final;
+  kmp_task_team_t *task_team = thread->th.th_task_team;
+  serial = serial && !(task_team && task_team->tt.tt_found_proxy_tasks);
+
+  kmp_task_t **tasks =
+      (kmp_task_t **)__kmp_thread_malloc(thread, ntasks * sizeof(kmp_task_t *));
+
+  for (i = 0; i < ntasks; i++) {
+    kmp_taskgraph_task_t *t = graph->tasks[i];
+    kmp_task_t *task_src = KMP_TASKDATA_TO_TASK(t->task);
+    kmp_tasking_flags_t flags = t->task->td_flags;
+    size_t size = t->task->td_size_alloc - sizeof(kmp_taskdata_t);
+
+    // the private data and the shareds are copied with the task
+    kmp_task_t *task = __kmp_task_alloc(t->task->td_ident, gtid, &flags, size,
+                                        0, task_src->routine);
+    kmp_taskdata_t *taskdata = KMP_TASK_TO_TASKDATA(task);
+    KMP_MEMCPY(task, task_src, size);
+    if (task_src->shareds != NULL)
+      task->shareds =
+          (char *)taskdata + ((char *)task_src->shareds - (char *)t->task);
+
+    if (!serial && (t->npredecessors > 0 || t->nsuccessors > 0)) {
+#if USE_FAST_MEMORY
+      kmp_depnode_t *node =
+          (kmp_depnode_t *)__kmp_fast_allocate(thread, sizeof(kmp_depnode_t));
+#else
+      kmp_depnode_t *node =
+          (kmp_depnode_t *)__kmp_thread_malloc(thread, sizeof(kmp_depnode_t));
+#endif
+      __kmp_init_node(node);
+      // hold the task until all the nodes are linked, see __kmp_check_deps
+      node->dn.npredecessors = t->npredecessors + 1;
+      node->dn.task = task;
+      taskdata->td_depnode = node;
+    }
+    tasks[i] = task;
+  }
+
+  if (!serial) {
+    for (i = 0; i < ntasks; i++) {
+      kmp_taskgraph_task_t *t = graph->tasks[i];
+      kmp_depnode_t *node = KMP_TASK_TO_TASKDATA(tasks[i])->td_depnode;
+      for (kmp_int32 j = 0; j < t->nsuccessors; j++)
+        node->dn.successors = __kmp_add_node(
+            thread, node->dn.successors,
+            KMP_TASK_TO_TASKDATA(tasks[t->successors[j]])->td_depnode);
+    }
+    KMP_MB();
+  }
+
+  for (i = 0; i < ntasks; i++) {
+    kmp_depnode_t *node = KMP_TASK_TO_TASKDATA(tasks[i])->td_depnode;
+    // release the hold, the task may still wait for its predecessors
+    if (node != NULL &&
+        KMP_TEST_THEN_DEC32(CCAST(kmp_int32 *, &node->dn.npredecessors)) - 1 >
+            0)
+      continue;
+    __kmp_omp_task(gtid, tasks[i], true);
+  }
+
+  __kmp_thread_free(thread, tasks);
+}
+
+/*!
+@ingroup TASKING
+@param loc source location information
+@param gtid global thread number
+@param graph_id identifier of the task graph
+@return 1 if the region must be executed, 0 if its tasks were created from the
+recorded graph
+
+Start a region of the current task that creates the same tasks each time it is
+executed, and which is also a taskgroup. The first time a graph is seen, the
+tasks created by the region are recorded; the next times the region does not
+have to be executed as the recorded tasks are created again. The region is
+closed with __kmpc_taskgraph_end in both cases.
+*/
+kmp_int32 __kmpc_taskgraph_begin(ident_t *loc, kmp_int32 gtid,
+                                 kmp_int32 graph_id) {
+  kmp_info_t *thread = __kmp_threads[gtid];
+  kmp_taskdata_t *current_task = thread->th.th_current_task;
+  // The frame of the caller is told apart by the address where its stack ends
+  // at the call, that is where the frame of this function begins. Unlike
+  // __builtin_frame_address(1), this does not need the caller to keep a frame
+  // pointer. The return address tells apart the call sites of a frame.
+  void *frame = __builtin_frame_address(0);
+  void *site = __builtin_return_address(0);
+  kmp_taskgraph_t *graph;
+  kmp_int32 state;
+
+  KA_TRACE(10, ("__kmpc_taskgraph_begin(enter): T#%d loc=%p graph=%d\n", gtid,
+                loc, graph_id));
+
+  // a region nested in the recording of a graph is part of it, the taskgroup
+  // prevents the replay of that graph
+  __kmpc_taskgroup(loc, gtid);
+  if (current_task->td_taskgraph) {
+    current_task->td_taskgraph->nested++;
+    KA_TRACE(10, ("__kmpc_taskgraph_begin(exit): T#%d graph %d nested in the "
+                  "recording of graph %d\n",
+                  gtid, graph_id, current_task->td_taskgraph->id));
+    return TRUE;
+  }
+
+  __kmp_acquire_bootstrap_lock(&__kmp_taskgraph_lock);
+  for (graph = __kmp_taskgraphs; graph; graph = graph->next)
+    if (graph->id == graph_id && graph->gtid == gtid)
+      break;
+  if (graph == NULL) {
+    graph = (kmp_taskgraph_t *)__kmp_allocate(sizeof(kmp_taskgraph_t));
+    graph->id = graph_id;
+    graph->gtid = gtid;
+    graph->state = taskgraph_disabled;
+    graph->next = __kmp_taskgraphs;
+    __kmp_taskgraphs = graph;
+  }
+  __kmp_release_bootstrap_lock(&__kmp_taskgraph_lock);
+
+  state = graph->state;
+  if (state == taskgraph_recording) {
+    // recorded by an enclosing frame of this thread, run the region
+    state = taskgraph_disabled;
+  } else if (graph->parent != current_task || graph->frame != frame ||
+             graph->site != site) {
+    __kmp_taskgraph_free_tasks(graph);
+    graph->parent = current_task;
+    graph->frame = frame;
+    graph->site = site;
+    graph->nested = 0;
+    graph->state = state = taskgraph_recording;
+    current_task->td_taskgraph = graph;
+  } else if (state == taskgraph_ready && current_task->td_dephash &&
+             !__kmp_dephash_clear_finished(thread, current_task->td_dephash)) {
+    // earlier tasks of the current task may be predecessors of the region
+    state = taskgraph_disabled;
+  }
+
+  if (state != taskgraph_ready) {
+    KA_TRACE(10, ("__kmpc_taskgraph_begin(exit): T#%d %s graph %d\n", gtid,
+                  current_task->td_taskgraph ? "recording" : "not replaying",
+                  graph_id));
+    return TRUE;
+  }
+
+  __kmp_taskgraph_replay(gtid, graph);
+
+  KA_TRACE(10, ("__kmpc_taskgraph_begin(exit): T#%d replayed graph %d\n", gtid,
+                graph_id));
+  return FALSE;
+}
+
+/*!
+@ingroup TASKING
+@param loc source location information
+@param gtid global thread number
+@param graph_id identifier of the task graph
+
+End a region started with __kmpc_taskgraph_begin and wait for its tasks.
+*/
+void __kmpc_taskgraph_end(ident_t *loc, kmp_int32 gtid, kmp_int32 graph_id) {
+  kmp_info_t *thread = __kmp_threads[gtid];
+  kmp_taskdata_t *current_task = thread->th.th_current_task;
+  kmp_taskgraph_t *graph = current_task->td_taskgraph;
+
+  KA_TRACE(10, ("__kmpc_taskgraph_end(enter): T#%d loc=%p graph=%d\n", gtid,
+                loc, graph_id));
+
+  if (graph && graph->nested > 0) {
+    graph->nested--;
+  } else if (graph) {
+    KMP_DEBUG_ASSERT(graph->id == graph_id);
+    current_task->td_taskgraph = NULL;
+    __kmp_taskgraph_finish_recording(gtid, graph);
+    KMP_MB();
+    __kmp_acquire_bootstrap_lock(&__kmp_taskgraph_lock);
+    if (graph->state == taskgraph_recording)
+      graph->state = taskgraph_ready;
+    __kmp_release_bootstrap_lock(&__kmp_taskgraph_lock);
+    KA_TRACE(20, ("__kmpc_taskgraph_end: T#%d recorded %d tasks in graph %d\n",
+                  gtid, graph->ntasks, graph_id));
+  }
+
+  __kmpc_end_taskgroup(loc, gtid);
+}
+
+void __kmp_taskgraph_cleanup(void) {
+  kmp_taskgraph_t *next;
+  for (kmp_taskgraph_t *graph = __kmp_taskgraphs; graph; graph = next) {
+    next = graph->next;
+    __kmp_taskgraph_free_tasks(graph);
+    __kmp_free(graph);
+  }
+  __kmp_taskgraphs = NULL;
+}
+#endif /* OMP_45_ENABLED */
+
 #endif /* OMP_40_ENABLED */
@@ -30,6 +30,8 @@ static void __kmp_enable_tasking(kmp_task_team_t *task_team,
                                  kmp_info_t *this_thr);
 static void __kmp_alloc_task_deque(kmp_info_t *thread,
                                    kmp_thread_data_t *thread_data);
+static void __kmp_realloc_task_deque(kmp_info_t *thread,
+                                     kmp_thread_data_t *thread_data);
 static int __kmp_realloc_task_threads_data(kmp_info_t *thread,
                                            kmp_task_team_t *task_team);
 
@@ -252,6 +254,217 @@ static void __kmp_pop_task_stack(kmp_int32 gtid, kmp_info_t *thread,
 }
 #endif /* BUILD_TIED_TASK_STACK */
 
+// __kmp_task_is_allowed: check the task scheduling constraint, only
+// descendants of the current task can be scheduled by a thread executing a
+// tied task.
+static inline bool __kmp_task_is_allowed(kmp_taskdata_t *current,
+                                         kmp_taskdata_t *taskdata) {
+  kmp_int32 level = current->td_level;
+  kmp_taskdata_t *parent = taskdata->td_parent;
+  while (parent != current && parent->td_level > level) {
+    parent = parent->td_parent; // check generation up to the level of the
+    // current task
+    KMP_DEBUG_ASSERT(parent != NULL);
+  }
+  return parent == current;
+}
+
+// Lock-free task deque, selected with KMP_TASK_DEQUE=lock_free. This is the
+// Chase-Lev dynamic circular work-stealing deque, with the fences of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models". Only the owner
+// pushes and pops at the bottom, thieves take the top with a CAS. Instead of
+// refusing tasks when it is full, the array is replaced by one twice as large.
+// Positions grow monotonically, so a stale top fails its CAS.
+
+static kmp_task_deque_array_t *__kmp_lf_deque_alloc_array(kmp_int64 size) {
+  // __kmp_allocate zeroes the array, prev is NULL
+  kmp_task_deque_array_t *array = (kmp_task_deque_array_t *)__kmp_allocate(
+      sizeof(kmp_task_deque_array_t) + (size - 1) * sizeof(array->tasks[0]));
+  array->mask = size - 1;
+  return array;
+}
+
+// __kmp_lf_deque_grow: replace the array of the deque, called by the owner
+// when it is full. Tasks [top, bottom) are copied at the same positions.
+static kmp_task_deque_array_t *
+__kmp_lf_deque_grow(kmp_thread_data_t *thread_data,
+                    kmp_task_deque_array_t *array, kmp_int64 top,
+                    kmp_int64 bottom) {
+  kmp_int64 size =
+      array ? 2 * (array->mask + 1) : (kmp_int64)INITIAL_TASK_DEQUE_ARRAY_SIZE;
+  kmp_task_deque_array_t *new_array = __kmp_lf_deque_alloc_array(size);
+
+  KE_TRACE(10, ("__kmp_lf_deque_grow: growing deque to %d entries for "
+                "thread_data %p\n",
+                (int)size, thread_data));
+
+  for (kmp_int64 i = top; i < bottom; ++i)
+    new_array->tasks[i & new_array->mask] = array->tasks[i & array->mask];
+  new_array->prev = array;
+  KMP_MB(); // the array must be complete before thieves can see it
+  TCW_PTR(thread_data->td.td_lf_array, new_array);
+  return new_array;
+}
+
+// __kmp_lf_deque_ntasks: number of tasks in the lock-free deque. It may be
+// stale when read by another thread.
+static inline kmp_int32 __kmp_lf_deque_ntasks(kmp_thread_data_t *thread_data) {
+  kmp_int64 ntasks =
+      TCR_8(thread_data->td.td_lf_bottom) - TCR_8(thread_data->td.td_lf_top);
+  return ntasks > 0 ? (kmp_int32)ntasks : 0;
+}
+
+// __kmp_deque_ntasks: number of tasks queued in the deques of a thread
+static inline kmp_int32 __kmp_deque_ntasks(kmp_thread_data_t *thread_data) {
+  kmp_int32 ntasks = TCR_4(thread_data->td.td_deque_ntasks);
+  if (__kmp_task_deque_kind == task_deque_lock_free)
+    ntasks += __kmp_lf_deque_ntasks(thread_data);
+  return ntasks;
+}
+
+// __kmp_lf_deque_push: push a task at the bottom, owner only
+static void __kmp_lf_deque_push(kmp_thread_data_t *thread_data,
+                                kmp_taskdata_t *taskdata) {
+  kmp_int64 bottom = TCR_8(thread_data->td.td_lf_bottom);
+  kmp_int64 top = TCR_8(thread_data->td.td_lf_top);
+  kmp_task_deque_array_t *array =
+      (kmp_task_deque_array_t *)TCR_PTR(thread_data->td.td_lf_array);
+
+  if (array == NULL || bottom - top > array->mask)
+    array = __kmp_lf_deque_grow(thread_data, array, top, bottom);
+
+  TCW_PTR(array->tasks[bottom & array->mask], taskdata);
+  KMP_MB(); // the task must be visible before the new bottom
+  TCW_8(thread_data->td.td_lf_bottom, bottom + 1);
+}
+
+// __kmp_lf_deque_pop: pop the task at the bottom, owner only
+static kmp_taskdata_t *__kmp_lf_deque_pop(kmp_thread_data_t *thread_data) {
+  // Only thieves move the top, so an empty deque stays empty here.
+  if (__kmp_lf_deque_ntasks(thread_data) == 0)
+    return NULL;
+
+  kmp_int64 bottom = TCR_8(thread_data->td.td_lf_bottom) - 1;
+  kmp_task_deque_array_t *array =
+      (kmp_task_deque_array_t *)TCR_PTR(thread_data->td.td_lf_array);
+  // The store of bottom must be globally visible before top is read: the
+  // exchange is a full barrier on x86, KMP_MB() is one elsewhere.
+  (void)KMP_XCHG_FIXED64(&thread_data->td.td_lf_bottom, bottom);
+  KMP_MB();
+  kmp_int64 top = TCR_8(thread_data->td.td_lf_top);
+
+  kmp_taskdata_t *taskdata = NULL;
+  if (top <= bottom) {
+    taskdata = (kmp_taskdata_t *)TCR_PTR(array->tasks[bottom & array->mask]);
+    if (top == bottom) {
+      // Last task, race with the thieves for it.
+      if (!KMP_COMPARE_AND_STORE_ACQ64(&thread_data->td.td_lf_top, top,
+                                       top + 1))
+        taskdata = NULL;
+      TCW_8(thread_data->td.td_lf_bottom, bottom + 1);
+    }
+  } else {
+    TCW_8(thread_data->td.td_lf_bottom, bottom + 1);
+  }
+  return taskdata;
+}
+
+// __kmp_lf_deque_steal: take the task at the top, any thread. When current is
+// not NULL, the task is only taken if it obeys the task scheduling constraint
+// for current. As with the locked deque, no other task in the deque can then
+// be a descendant of current, and the task is left in place.
+static kmp_taskdata_t *__kmp_lf_deque_steal(kmp_thread_data_t *victim_td,
+                                            kmp_taskdata_t *current) {
+  kmp_int64 top = TCR_8(victim_td->td.td_lf_top);
+  for (;;) {
+    KMP_MB();
+    kmp_int64 bottom = TCR_8(victim_td->td.td_lf_bottom);
+    if (top >= bottom)
+      return NULL;
+    kmp_task_deque_array_t *array =
+        (kmp_task_deque_array_t *)TCR_PTR(victim_td->td.td_lf_array);
+    kmp_taskdata_t *taskdata =
+        (kmp_taskdata_t *)TCR_PTR(array->tasks[top & array->mask]);
+    if (current != NULL) {
+      // Only look at the task while it is still at the top.
+      kmp_int64 new_top = TCR_8(victim_td->td.td_lf_top);
+      if (new_top != top) {
+        top = new_top;
+        continue;
+      }
+      if (!__kmp_task_is_allowed(current, taskdata))
+        return NULL;
+    }
+    if (KMP_COMPARE_AND_STORE_ACQ64(&victim_td->td.td_lf_top, top, top + 1))
+      return taskdata;
+    // Another thief or the owner got the task.
+    top = TCR_8(victim_td->td.td_lf_top);
+  }
+}
+
+#if OMP_45_ENABLED
+// __kmp_get_priority_deque: find the shared deque for a priority, inserting a
+// new one in the sorted list of the task team if needed. The list is only
+// freed with the task team, so it can be walked without the lock.
+static kmp_task_pri_t *__kmp_get_priority_deque(kmp_info_t *thread,
+                                                kmp_task_team_t *task_team,
+                                                kmp_int32 pri) {
+  kmp_task_pri_t *list =
+      (kmp_task_pri_t *)TCR_PTR(task_team->tt.tt_task_pri_list);
+  for (; list != NULL && list->priority >= pri; list = list->next)
+    if (list->priority == pri)
+      return list;
+
+  __kmp_acquire_bootstrap_lock(&task_team->tt.tt_task_pri_lock);
+  kmp_task_pri_t **prev = &task_team->tt.tt_task_pri_list;
+  while (*prev != NULL && (*prev)->priority > pri)
+    prev = &(*prev)->next;
+  if (*prev == NULL || (*prev)->priority != pri) {
+    kmp_task_pri_t *deque =
+        (kmp_task_pri_t *)__kmp_allocate(sizeof(kmp_task_pri_t));
+    __kmp_alloc_task_deque(thread, &deque->td);
+    deque->priority = pri;
+    deque->next = *prev;
+    KMP_MB(); // the deque must be complete before other threads can see it
+    TCW_PTR(*prev, deque);
+    KE_TRACE(10, ("__kmp_get_priority_deque: T#%d added deque %p for "
+                  "priority %d to task_team %p\n",
+                  __kmp_gtid_from_thread(thread), deque, pri, task_team));
+  }
+  kmp_task_pri_t *deque = *prev;
+  __kmp_release_bootstrap_lock(&task_team->tt.tt_task_pri_lock);
+  return deque;
+}
+
+// __kmp_push_priority_task: add a task to the shared deque of its priority.
+// Unlike the per-thread deques, these never refuse a task.
+static kmp_int32 __kmp_push_priority_task(kmp_int32 gtid, kmp_info_t *thread,
+                                          kmp_taskdata_t *taskdata,
+                                          kmp_task_team_t *task_team,
+                                          kmp_int32 pri) {
+  kmp_task_pri_t *deque = __kmp_get_priority_deque(thread, task_team, pri);
+  kmp_thread_data_t *thread_data = &deque->td;
+
+  __kmp_acquire_bootstrap_lock(&thread_data->td.td_deque_lock);
+  if (TCR_4(thread_data->td.td_deque_ntasks) >=
+      TASK_DEQUE_SIZE(thread_data->td))
+    __kmp_realloc_task_deque(thread, thread_data);
+  thread_data->td.td_deque[thread_data->td.td_deque_tail] = taskdata;
+  // Wrap index.
+  thread_data->td.td_deque_tail =
+      (thread_data->td.td_deque_tail + 1) & TASK_DEQUE_MASK(thread_data->td);
+  TCW_4(thread_data->td.td_deque_ntasks,
+        TCR_4(thread_data->td.td_deque_ntasks) + 1);
+  KMP_TEST_THEN_INC32(&task_team->tt.tt_num_task_pri);
+  __kmp_release_bootstrap_lock(&thread_data->td.td_deque_lock);
+
+  KA_TRACE(20, ("__kmp_push_priority_task: T#%d returning "
+                "TASK_SUCCESSFULLY_PUSHED: task=%p priority=%d ntasks=%d\n",
+                gtid, taskdata, pri, thread_data->td.td_deque_ntasks));
+  return TASK_SUCCESSFULLY_PUSHED;
+}
+#endif // OMP_45_ENABLED
+
 //  __kmp_push_task: Add a task to the thread's deque
 static kmp_int32 __kmp_push_task(kmp_int32 gtid, kmp_task_t *task) {
   kmp_info_t *thread = __kmp_threads[gtid];
@@ -290,6 +503,16 @@ static kmp_int32 __kmp_push_task(kmp_int32 gtid, kmp_task_t *task) {
   KMP_DEBUG_ASSERT(TCR_4(task_team->tt.tt_found_tasks) == TRUE);
   KMP_DEBUG_ASSERT(TCR_PTR(task_team->tt.tt_threads_data) != NULL);
 
+#if OMP_45_ENABLED
+  // Tasks with a priority go to the shared deques of the task team, which
+  // every thread checks before its own deque. Priority 0 is the default.
+  if (taskdata->td_flags.priority_specified && __kmp_max_task_priority > 0 &&
+      task->data2.priority > 0) {
+    kmp_int32 pri = KMP_MIN(task->data2.priority, __kmp_max_task_priority);
+    return __kmp_push_priority_task(gtid, thread, taskdata, task_team, pri);
+  }
+#endif
+
   // Find tasking deque specific to encountering thread
   thread_data = &task_team->tt.tt_threads_data[tid];
 
@@ -298,6 +521,14 @@ static kmp_int32 __kmp_push_task(kmp_int32 gtid, kmp_task_t *task) {
     __kmp_alloc_task_deque(thread, thread_data);
   }
 
+  if (__kmp_task_deque_kind == task_deque_lock_free) {
+    __kmp_lf_deque_push(thread_data, taskdata);
+    KA_TRACE(20, ("__kmp_push_task: T#%d returning TASK_SUCCESSFULLY_PUSHED: "
+                  "task=%p lock-free ntasks=%d\n",
+                  gtid, taskdata, __kmp_lf_deque_ntasks(thread_data)));
+    return TASK_SUCCESSFULLY_PUSHED;
+  }
+
   // Check if deque is full
   if (TCR_4(thread_data->td.td_deque_ntasks) >=
       TASK_DEQUE_SIZE(thread_data->td)) {
@@ -489,6 +720,12 @@ void __kmpc_omp_task_begin_if0(ident_t *loc_ref, kmp_int32 gtid,
                 "current_task=%p\n",
                 gtid, loc_ref, taskdata, current_task));
 
+#if OMP_45_ENABLED
+  // an undeferred task cannot be recorded
+  if (current_task->td_taskgraph)
+    __kmp_taskgraph_disable(current_task->td_taskgraph);
+#endif
+
   if (taskdata->td_flags.tiedness == TASK_UNTIED) {
     // untied task needs to increment counter so that the task structure is not
     // freed prematurely
@@ -861,6 +1098,9 @@ void __kmp_init_implicit_task(ident_t *loc_ref, kmp_info_t *this_thr,
 
 #if OMP_40_ENABLED
   task->td_depnode = NULL;
+#if OMP_45_ENABLED
+  task->td_taskgraph = NULL;
+#endif
 #endif
 
   if (set_curr_task) { // only do this init first time thread is created
@@ -1061,6 +1301,7 @@ kmp_task_t *__kmp_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
 #endif // OMP_40_ENABLED
 #if OMP_45_ENABLED
   taskdata->td_flags.proxy = flags->proxy;
+  taskdata->td_flags.priority_specified = flags->priority_specified;
   taskdata->td_task_team = thread->th.th_task_team;
   taskdata->td_size_alloc = shareds_offset + sizeof_shareds;
 #endif
@@ -1086,6 +1327,7 @@ kmp_task_t *__kmp_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
   taskdata->td_flags.freed = 0;
 
   taskdata->td_flags.native = flags->native;
+  taskdata->td_flags.recorded = 0;
 
   taskdata->td_incomplete_child_tasks = 0;
   taskdata->td_allocated_child_tasks = 1; // start at one because counts current
@@ -1095,6 +1337,9 @@ kmp_task_t *__kmp_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
       parent_task->td_taskgroup; // task inherits taskgroup from the parent task
   taskdata->td_dephash = NULL;
   taskdata->td_depnode = NULL;
+#if OMP_45_ENABLED
+  taskdata->td_taskgraph = NULL;
+#endif
 #endif
 
 // Only need to keep track of child task counts if team parallel and tasking not
@@ -1160,6 +1405,35 @@ kmp_task_t *__kmpc_omp_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
   return retval;
 }
 
+#if OMP_45_ENABLED
+/*!
+@ingroup TASKING
+@param loc_ref location of the construct the task stands for
+@param gtid global thread number
+@param sizeof_kmp_task_t size of the task structure and its private data
+@param sizeof_shareds size of the shareds of the task
+@param task_entry routine of the task
+@return the allocated proxy task
+
+Allocate a tied proxy task, for libraries such as the offloading one which run
+the work of a construct outside of the team. The routine of the task only hands
+the work over, the task is then completed with __kmpc_proxy_task_completed_ooo.
+*/
+kmp_task_t *__kmpc_omp_proxy_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
+                                        size_t sizeof_kmp_task_t,
+                                        size_t sizeof_shareds,
+                                        kmp_routine_entry_t task_entry) {
+  kmp_int32 flags = 0;
+  kmp_tasking_flags_t *input_flags = (kmp_tasking_flags_t *)&flags;
+
+  input_flags->tiedness = TASK_TIED;
+  input_flags->proxy = TASK_PROXY;
+
+  return __kmpc_omp_task_alloc(loc_ref, gtid, flags, sizeof_kmp_task_t,
+                               sizeof_shareds, task_entry);
+}
+#endif
+
 //  __kmp_invoke_task: invoke the specified task
 //
 // gtid: global thread ID of caller
@@ -1354,6 +1628,12 @@ kmp_int32 __kmpc_omp_task_parts(ident_t *loc_ref, kmp_int32 gtid,
   KA_TRACE(10, ("__kmpc_omp_task_parts(enter): T#%d loc=%p task=%p\n", gtid,
                 loc_ref, new_taskdata));
 
+#if OMP_45_ENABLED
+  kmp_taskdata_t *parent_task = __kmp_threads[gtid]->th.th_current_task;
+  if (parent_task->td_taskgraph)
+    __kmp_taskgraph_disable(parent_task->td_taskgraph);
+#endif
+
   /* Should we execute the new task or queue it? For now, let's just always try
      to queue it.  If the queue fills up, then we'll execute it.  */
 
@@ -1438,12 +1718,16 @@ kmp_int32 __kmpc_omp_task(ident_t *loc_ref, kmp_int32 gtid,
   kmp_int32 res;
   KMP_SET_THREAD_STATE_BLOCK(EXPLICIT_TASK);
 
-#if KMP_DEBUG
   kmp_taskdata_t *new_taskdata = KMP_TASK_TO_TASKDATA(new_task);
-#endif
   KA_TRACE(10, ("__kmpc_omp_task(enter): T#%d loc=%p task=%p\n", gtid, loc_ref,
                 new_taskdata));
 
+#if OMP_45_ENABLED
+  kmp_taskdata_t *current_task = __kmp_threads[gtid]->th.th_current_task;
+  if (current_task->td_taskgraph && !new_taskdata->td_flags.recorded)
+    __kmp_taskgraph_record(gtid, current_task, new_task, 0, NULL, 0, NULL);
+#endif
+
   res = __kmp_omp_task(gtid, new_task, true);
 
   KA_TRACE(10, ("__kmpc_omp_task(exit): T#%d returning "
@@ -1465,6 +1749,10 @@ kmp_int32 __kmpc_omp_taskwait(ident_t *loc_ref, kmp_int32 gtid) {
   if (__kmp_tasking_mode != tskm_immediate_exec) {
     thread = __kmp_threads[gtid];
     taskdata = thread->th.th_current_task;
+#if OMP_45_ENABLED
+    if (taskdata->td_taskgraph)
+      __kmp_taskgraph_disable(taskdata->td_taskgraph);
+#endif
 #if OMPT_SUPPORT && OMPT_TRACE
     ompt_task_id_t my_task_id;
     ompt_parallel_id_t my_parallel_id;
@@ -1802,6 +2090,11 @@ void __kmpc_taskgroup(ident_t *loc, int gtid) {
   kmp_taskgroup_t *tg_new =
       (kmp_taskgroup_t *)__kmp_thread_malloc(thread, sizeof(kmp_taskgroup_t));
   KA_TRACE(10, ("__kmpc_taskgroup: T#%d loc=%p group=%p\n", gtid, loc, tg_new));
+#if OMP_45_ENABLED
+  // the recorded tasks are replayed without nested taskgroups
+  if (taskdata->td_taskgraph)
+    __kmp_taskgraph_disable(taskdata->td_taskgraph);
+#endif
   tg_new->count = 0;
   tg_new->cancel_request = cancel_noreq;
   tg_new->parent = taskdata->td_taskgroup;
@@ -1891,6 +2184,27 @@ static kmp_task_t *__kmp_remove_my_task(kmp_info_t *thread, kmp_int32 gtid,
                 gtid, thread_data->td.td_deque_ntasks,
                 thread_data->td.td_deque_head, thread_data->td.td_deque_tail));
 
+  if (__kmp_task_deque_kind == task_deque_lock_free) {
+    taskdata = __kmp_lf_deque_pop(thread_data);
+    if (taskdata != NULL) {
+      if (is_constrained && (taskdata->td_flags.tiedness == TASK_TIED) &&
+          !__kmp_task_is_allowed(thread->th.th_current_task, taskdata)) {
+        // Put it back; as with the locked deque, no other child can be
+        // further in the deque.
+        __kmp_lf_deque_push(thread_data, taskdata);
+        KA_TRACE(10, ("__kmp_remove_my_task: T#%d lock-free deque has no "
+                      "allowed task: lock-free ntasks=%d\n",
+                      gtid, __kmp_lf_deque_ntasks(thread_data)));
+      } else {
+        KA_TRACE(10, ("__kmp_remove_my_task(exit #4): T#%d task %p removed: "
+                      "lock-free ntasks=%d\n",
+                      gtid, taskdata, __kmp_lf_deque_ntasks(thread_data)));
+        return KMP_TASKDATA_TO_TASK(taskdata);
+      }
+    }
+    // Proxy tasks given by other threads are in the locked deque.
+  }
+
   if (TCR_4(thread_data->td.td_deque_ntasks) == 0) {
     KA_TRACE(10,
              ("__kmp_remove_my_task(exit #1): T#%d No tasks to remove: "
@@ -1919,15 +2233,7 @@ static kmp_task_t *__kmp_remove_my_task(kmp_info_t *thread, kmp_int32 gtid,
   if (is_constrained && (taskdata->td_flags.tiedness == TASK_TIED)) {
     // we need to check if the candidate obeys task scheduling constraint:
     // only child of current task can be scheduled
-    kmp_taskdata_t *current = thread->th.th_current_task;
-    kmp_int32 level = current->td_level;
-    kmp_taskdata_t *parent = taskdata->td_parent;
-    while (parent != current && parent->td_level > level) {
-      parent = parent->td_parent; // check generation up to the level of the
-      // current task
-      KMP_DEBUG_ASSERT(parent != NULL);
-    }
-    if (parent != current) {
+    if (!__kmp_task_is_allowed(thread->th.th_current_task, taskdata)) {
       // If the tail task is not a child, then no other child can appear in the
       // deque.
       __kmp_release_bootstrap_lock(&thread_data->td.td_deque_lock);
@@ -1954,18 +2260,191 @@ static kmp_task_t *__kmp_remove_my_task(kmp_info_t *thread, kmp_int32 gtid,
   return task;
 }
 
+#if OMP_45_ENABLED
+// __kmp_get_priority_task: remove the oldest task of the highest priority from
+// the shared deques of the task team. As when stealing, a finished thread is
+// un-marked before the task leaves its deque.
+static kmp_task_t *
+__kmp_get_priority_task(kmp_int32 gtid, kmp_task_team_t *task_team,
+                        volatile kmp_int32 *unfinished_threads,
+                        int *thread_finished, kmp_int32 is_constrained) {
+  kmp_taskdata_t *current = __kmp_threads[gtid]->th.th_current_task;
+  kmp_task_pri_t *list =
+      (kmp_task_pri_t *)TCR_PTR(task_team->tt.tt_task_pri_list);
+
+  for (; list != NULL && TCR_4(task_team->tt.tt_num_task_pri) != 0;
+       list = list->next) {
+    kmp_thread_data_t *thread_data = &list->td;
+    if (TCR_4(thread_data->td.td_deque_ntasks) == 0)
+      continue;
+
+    __kmp_acquire_bootstrap_lock(&thread_data->td.td_deque_lock);
+    if (TCR_4(thread_data->td.td_deque_ntasks) == 0) {
+      __kmp_release_bootstrap_lock(&thread_data->td.td_deque_lock);
+      continue;
+    }
+    kmp_uint32 target = thread_data->td.td_deque_head;
+    kmp_taskdata_t *taskdata = thread_data->td.td_deque[target];
+    if (is_constrained && !__kmp_task_is_allowed(current, taskdata)) {
+      // Unlike a thread's own deque, this one mixes the tasks of all threads:
+      // descendants of the current task may be queued behind the head, and
+      // may be runnable by no other thread. Search the rest of the deque.
+      kmp_int32 ntasks = TCR_4(thread_data->td.td_deque_ntasks), i;
+      for (i = 1; i < ntasks; ++i) {
+        target = (target + 1) & TASK_DEQUE_MASK(thread_data->td);
+        taskdata = thread_data->td.td_deque[target];
+        if (__kmp_task_is_allowed(current, taskdata))
+          break;
+      }
+      if (i == ntasks) {
+        __kmp_release_bootstrap_lock(&thread_data->td.td_deque_lock);
+        continue;
+      }
+      // Close the gap left by the task, keeping the order of the others.
+      for (++i; i < ntasks; ++i) {
+        kmp_uint32 next = (target + 1) & TASK_DEQUE_MASK(thread_data->td);
+        thread_data->td.td_deque[target] = thread_data->td.td_deque[next];
+        target = next;
+      }
+      thread_data->td.td_deque_tail = target;
+    } else {
+      // Bump head pointer and Wrap.
+      thread_data->td.td_deque_head =
+          (target + 1) & TASK_DEQUE_MASK(thread_data->td);
+    }
+    if (*thread_finished) {
+      kmp_int32 count = KMP_TEST_THEN_INC32(unfinished_threads);
+      KA_TRACE(20, ("__kmp_get_priority_task: T#%d inc unfinished_threads to "
+                    "%d: task_team=%p\n",
+                    gtid, count + 1, task_team));
+      *thread_finished = FALSE;
+    }
+    TCW_4(thread_data->td.td_deque_ntasks,
+          TCR_4(thread_data->td.td_deque_ntasks) - 1);
+    KMP_TEST_THEN_DEC32(&task_team->tt.tt_num_task_pri);
+    __kmp_release_bootstrap_lock(&thread_data->td.td_deque_lock);
+
+    KA_TRACE(10, ("__kmp_get_priority_task: T#%d took task %p of priority %d: "
+                  "task_team=%p ntasks=%d\n",
+                  gtid, taskdata, list->priority, task_team,
+                  thread_data->td.td_deque_ntasks));
+    return KMP_TASKDATA_TO_TASK(taskdata);
+  }
+  return NULL;
+}
+#endif // OMP_45_ENABLED
+
+#if OMP_40_ENABLED && KMP_AFFINITY_SUPPORTED
+#define KMP_STEAL_PLACE(thread) ((thread)->th.th_current_place)
+#else
+#define KMP_STEAL_PLACE(thread) 0
+#endif
+
+// Most tasks moved at once to the thief's deque by a remote steal
+#define TASK_STEAL_BATCH_MAX 8
+
+// __kmp_build_steal_order: sort the other threads of the team by distance
+// from thread in the machine hierarchy, for KMP_TASK_STEAL_ORDER=topology.
+// Ties are kept in thread order. Only the owner of the thread data calls it.
+static void __kmp_build_steal_order(kmp_info_t *thread,
+                                    kmp_thread_data_t *threads_data,
+                                    kmp_int32 tid, kmp_int32 nthreads) {
+  kmp_thread_data_t *thread_data = &threads_data[tid];
+  kmp_uint32 depth = 0;
+  kmp_int32 i, j, n = 0;
+
+  if (thread_data->td.td_steal_order != NULL) {
+    __kmp_free(thread_data->td.td_steal_order);
+    __kmp_free(thread_data->td.td_steal_dist);
+  }
+  kmp_int32 *order = (kmp_int32 *)__kmp_allocate(nthreads * sizeof(kmp_int32));
+  kmp_uint32 *dist =
+      (kmp_uint32 *)__kmp_allocate(nthreads * sizeof(kmp_uint32));
+
+  for (i = 0; i < nthreads; ++i) {
+    if (i == tid)
+      continue;
+    dist[i] = __kmp_get_hierarchy_distance(thread, threads_data[i].td.td_thr,
+                                           nthreads, &depth);
+    for (j = n++; j > 0 && dist[order[j - 1]] > dist[i]; --j)
+      order[j] = order[j - 1];
+    order[j] = i;
+  }
+
+  thread_data->td.td_steal_order = order;
+  thread_data->td.td_steal_dist = dist;
+  thread_data->td.td_steal_nproc = nthreads;
+  thread_data->td.td_steal_depth = depth;
+  thread_data->td.td_steal_team = thread->th.th_team;
+  thread_data->td.td_steal_place = KMP_STEAL_PLACE(thread);
+
+  KE_TRACE(10, ("__kmp_build_steal_order: T#%d built steal order for %d "
+                "threads, nearest victim T#%d at distance %u of %u\n",
+                __kmp_gtid_from_thread(thread), nthreads,
+                nthreads > 1 ? order[0] : -1, nthreads > 1 ? dist[order[0]] : 0,
+                depth));
+}
+
+// __kmp_steal_order_valid: check that the steal order of thread_data was built
+// for the current team of its owner.
+static inline bool __kmp_steal_order_valid(kmp_info_t *thread,
+                                           kmp_thread_data_t *thread_data,
+                                           kmp_int32 nthreads) {
+  return thread_data->td.td_steal_order != NULL &&
+         thread_data->td.td_steal_nproc == nthreads &&
+         thread_data->td.td_steal_team == thread->th.th_team &&
+         thread_data->td.td_steal_place == KMP_STEAL_PLACE(thread);
+}
+
+// __kmp_push_stolen_tasks: queue the tasks moved by a batched steal in the
+// deque of the thief, which owns it.
+static void __kmp_push_stolen_tasks(kmp_info_t *thread,
+                                    kmp_thread_data_t *thread_data,
+                                    kmp_taskdata_t **tasks, kmp_int32 ntasks) {
+  kmp_int32 i;
+  // No lock needed since only owner can allocate. The locked deque is needed
+  // in lock-free mode too, other threads give proxy tasks there.
+  if (thread_data->td.td_deque == NULL)
+    __kmp_alloc_task_deque(thread, thread_data);
+  if (__kmp_task_deque_kind == task_deque_lock_free) {
+    for (i = 0; i < ntasks; ++i)
+      __kmp_lf_deque_push(thread_data, tasks[i]);
+    return;
+  }
+  __kmp_acquire_bootstrap_lock(&thread_data->td.td_deque_lock);
+  for (i = 0; i < ntasks; ++i) {
+    if (TCR_4(thread_data->td.td_deque_ntasks) >=
+        TASK_DEQUE_SIZE(thread_data->td))
+      __kmp_realloc_task_deque(thread, thread_data);
+    thread_data->td.td_deque[thread_data->td.td_deque_tail] = tasks[i];
+    // Wrap index.
+    thread_data->td.td_deque_tail =
+        (thread_data->td.td_deque_tail + 1) & TASK_DEQUE_MASK(thread_data->td);
+    TCW_4(thread_data->td.td_deque_ntasks,
+          TCR_4(thread_data->td.td_deque_ntasks) + 1);
+  }
+  __kmp_release_bootstrap_lock(&thread_data->td.td_deque_lock);
+}
+
 // __kmp_steal_task: remove a task from another thread's deque
 // Assume that calling thread has already checked existence of
 // task_team thread_data before calling this routine.
+// When batch is not 0, up to batch more tasks, and at most half of the
+// victim's tasks, are moved to the deque of the calling thread.
 static kmp_task_t *__kmp_steal_task(kmp_info_t *victim, kmp_int32 gtid,
                                     kmp_task_team_t *task_team,
                                     volatile kmp_int32 *unfinished_threads,
                                     int *thread_finished,
-                                    kmp_int32 is_constrained) {
+                                    kmp_int32 is_constrained,
+                                    kmp_int32 batch) {
   kmp_task_t *task;
   kmp_taskdata_t *taskdata;
   kmp_thread_data_t *victim_td, *threads_data;
   kmp_int32 victim_tid;
+  kmp_taskdata_t *batch_tasks[TASK_STEAL_BATCH_MAX];
+  kmp_int32 nbatch = 0;
+
+  KMP_DEBUG_ASSERT(batch <= TASK_STEAL_BATCH_MAX);
 
   KMP_DEBUG_ASSERT(__kmp_tasking_mode != tskm_immediate_exec);
 
@@ -1982,6 +2461,54 @@ static kmp_task_t *__kmp_steal_task(kmp_info_t *victim, kmp_int32 gtid,
                 victim_td->td.td_deque_ntasks, victim_td->td.td_deque_head,
                 victim_td->td.td_deque_tail));
 
+  if (__kmp_task_deque_kind == task_deque_lock_free &&
+      __kmp_lf_deque_ntasks(victim_td) != 0 &&
+      TCR_PTR(victim->th.th_task_team) == task_team) {
+    kmp_int32 ntasks = __kmp_lf_deque_ntasks(victim_td);
+    int finished = *thread_finished;
+    // Between the CAS and the increment below, the task is in no deque. The
+    // victim waits for finished thieves before it can be counted as finished
+    // itself, and so keeps the task team alive.
+    if (finished)
+      KMP_TEST_THEN_INC32(&victim_td->td.td_lf_thieves);
+    taskdata = __kmp_lf_deque_steal(
+        victim_td,
+        is_constrained ? __kmp_threads[gtid]->th.th_current_task : NULL);
+    if (taskdata != NULL && finished) {
+      // Un-mark this thread as finished now that it holds a task, as with the
+      // locked deque.
+      kmp_int32 count = KMP_TEST_THEN_INC32(unfinished_threads);
+      KA_TRACE(20, ("__kmp_steal_task: T#%d inc unfinished_threads to %d: "
+                    "task_team=%p\n",
+                    gtid, count + 1, task_team));
+      *thread_finished = FALSE;
+    }
+    if (finished)
+      KMP_TEST_THEN_DEC32(&victim_td->td.td_lf_thieves);
+    if (taskdata != NULL) {
+      if (batch > 0) {
+        for (batch = KMP_MIN(batch, ntasks / 2 - 1); nbatch < batch;
+             ++nbatch) {
+          batch_tasks[nbatch] = __kmp_lf_deque_steal(victim_td, NULL);
+          if (batch_tasks[nbatch] == NULL)
+            break;
+        }
+        if (nbatch > 0) {
+          __kmp_push_stolen_tasks(
+              __kmp_threads[gtid],
+              &threads_data[__kmp_tid_from_gtid(gtid)], batch_tasks, nbatch);
+          KMP_COUNT_BLOCK(TASK_stolen_batch);
+        }
+      }
+      KMP_COUNT_BLOCK(TASK_stolen);
+      KA_TRACE(10, ("__kmp_steal_task(exit #5): T#%d stole task %p and %d "
+                    "more from T#%d: task_team=%p lock-free ntasks=%d\n",
+                    gtid, taskdata, nbatch, __kmp_gtid_from_thread(victim),
+                    task_team, __kmp_lf_deque_ntasks(victim_td)));
+      return KMP_TASKDATA_TO_TASK(taskdata);
+    }
+  }
+
   if ((TCR_4(victim_td->td.td_deque_ntasks) ==
        0) || // Caller should not check this condition
       (TCR_PTR(victim->th.th_task_team) !=
@@ -2019,15 +2546,8 @@ static kmp_task_t *__kmp_steal_task(kmp_info_t *victim, kmp_int32 gtid,
   if (is_constrained) {
     // we need to check if the candidate obeys task scheduling constraint:
     // only descendant of current task can be scheduled
-    kmp_taskdata_t *current = __kmp_threads[gtid]->th.th_current_task;
-    kmp_int32 level = current->td_level;
-    kmp_taskdata_t *parent = taskdata->td_parent;
-    while (parent != current && parent->td_level > level) {
-      parent = parent->td_parent; // check generation up to the level of the
-      // current task
-      KMP_DEBUG_ASSERT(parent != NULL);
-    }
-    if (parent != current) {
+    if (!__kmp_task_is_allowed(__kmp_threads[gtid]->th.th_current_task,
+                               taskdata)) {
       // If the head task is not a descendant of the current task then do not
       // steal it. No other task in victim's deque can be a descendant of the
       // current task.
@@ -2045,6 +2565,13 @@ static kmp_task_t *__kmp_steal_task(kmp_info_t *victim, kmp_int32 gtid,
   // Bump head pointer and Wrap.
   victim_td->td.td_deque_head =
       (victim_td->td.td_deque_head + 1) & TASK_DEQUE_MASK(victim_td->td);
+  // Take more tasks from the head, where the victim does not work.
+  batch = KMP_MIN(batch, TCR_4(victim_td->td.td_deque_ntasks) / 2 - 1);
+  for (; nbatch < batch; ++nbatch) {
+    batch_tasks[nbatch] = victim_td->td.td_deque[victim_td->td.td_deque_head];
+    victim_td->td.td_deque_head =
+        (victim_td->td.td_deque_head + 1) & TASK_DEQUE_MASK(victim_td->td);
+  }
   if (*thread_finished) {
     // We need to un-mark this victim as a finished victim.  This must be done
     // before releasing the lock, or else other threads (starting with the
@@ -2061,16 +2588,23 @@ static kmp_task_t *__kmp_steal_task(kmp_info_t *victim, kmp_int32 gtid,
     *thread_finished = FALSE;
   }
   TCW_4(victim_td->td.td_deque_ntasks,
-        TCR_4(victim_td->td.td_deque_ntasks) - 1);
+        TCR_4(victim_td->td.td_deque_ntasks) - 1 - nbatch);
 
   __kmp_release_bootstrap_lock(&victim_td->td.td_deque_lock);
 
+  if (nbatch > 0) {
+    // Outside of the victim's lock, the victim may be stealing from us.
+    __kmp_push_stolen_tasks(__kmp_threads[gtid],
+                            &threads_data[__kmp_tid_from_gtid(gtid)],
+                            batch_tasks, nbatch);
+    KMP_COUNT_BLOCK(TASK_stolen_batch);
+  }
   KMP_COUNT_BLOCK(TASK_stolen);
   KA_TRACE(
       10,
-      ("__kmp_steal_task(exit #3): T#%d stole task %p from T#%d: task_team=%p "
-       "ntasks=%d head=%u tail=%u\n",
-       gtid, taskdata, __kmp_gtid_from_thread(victim), task_team,
+      ("__kmp_steal_task(exit #3): T#%d stole task %p and %d more from T#%d: "
+       "task_team=%p ntasks=%d head=%u tail=%u\n",
+       gtid, taskdata, nbatch, __kmp_gtid_from_thread(victim), task_team,
        victim_td->td.td_deque_ntasks, victim_td->td.td_deque_head,
        victim_td->td.td_deque_tail));
 
@@ -2078,6 +2612,60 @@ static kmp_task_t *__kmp_steal_task(kmp_info_t *victim, kmp_int32 gtid,
   return task;
 }
 
+// __kmp_steal_near_task: steal from the threads with queued tasks, nearest
+// first in the machine hierarchy, for KMP_TASK_STEAL_ORDER=topology. Threads
+// at the same distance are tried from a random one. As with random victim
+// selection, sleeping threads are woken up on the way. On success, *victim is
+// the thread the task was stolen from.
+static kmp_task_t *__kmp_steal_near_task(
+    kmp_info_t *thread, kmp_int32 gtid, kmp_task_team_t *task_team,
+    kmp_thread_data_t *threads_data, kmp_int32 tid, kmp_int32 nthreads,
+    volatile kmp_int32 *unfinished_threads, int *thread_finished,
+    kmp_int32 is_constrained, kmp_int32 *victim) {
+  kmp_thread_data_t *thread_data = &threads_data[tid];
+  kmp_int32 i, end, k;
+
+  if (!__kmp_steal_order_valid(thread, thread_data, nthreads))
+    __kmp_build_steal_order(thread, threads_data, tid, nthreads);
+
+  kmp_int32 *order = thread_data->td.td_steal_order;
+  kmp_uint32 *dist = thread_data->td.td_steal_dist;
+  for (i = 0; i < nthreads - 1; i = end) {
+    for (end = i + 1; end < nthreads - 1 && dist[order[end]] == dist[order[i]];
+         ++end)
+      ;
+    kmp_int32 n = end - i, start = __kmp_get_random(thread) % n;
+    for (k = 0; k < n; ++k) {
+      kmp_int32 other = order[i + (start + k) % n];
+      kmp_info_t *other_thread = threads_data[other].td.td_thr;
+      if (__kmp_deque_ntasks(&threads_data[other]) == 0) {
+        if ((__kmp_tasking_mode == tskm_task_teams) &&
+            (__kmp_dflt_blocktime != KMP_MAX_BLOCKTIME) &&
+            (TCR_PTR(CCAST(void *, other_thread->th.th_sleep_loc)) != NULL)) {
+          __kmp_null_resume_wrapper(__kmp_gtid_from_thread(other_thread),
+                                    other_thread->th.th_sleep_loc);
+        }
+        continue;
+      }
+      // Remote steals take up to half of the victim's tasks, unless the
+      // scheduling constraint needs to check each task.
+      bool remote = dist[other] >= thread_data->td.td_steal_depth;
+      kmp_task_t *task = __kmp_steal_task(
+          other_thread, gtid, task_team, unfinished_threads, thread_finished,
+          is_constrained, remote && !is_constrained ? TASK_STEAL_BATCH_MAX : 0);
+      if (task != NULL) {
+        if (remote)
+          KMP_COUNT_BLOCK(TASK_stolen_remote);
+        else
+          KMP_COUNT_BLOCK(TASK_stolen_near);
+        *victim = other;
+        return task;
+      }
+    }
+  }
+  return NULL;
+}
+
 // __kmp_execute_tasks_template: Choose and execute tasks until either the
 // condition is statisfied (return true) or there are none left (return false).
 //
@@ -2128,7 +2716,15 @@ static inline int __kmp_execute_tasks_template(
     // getting tasks from target constructs
     while (1) { // Inner loop to find a task and execute it
       task = NULL;
+#if OMP_45_ENABLED
+      if (TCR_4(task_team->tt.tt_num_task_pri) != 0) { // high priority first
+        task = __kmp_get_priority_task(gtid, task_team, unfinished_threads,
+                                       thread_finished, is_constrained);
+      }
+      if (task == NULL && use_own_tasks) { // check on own queue next
+#else
       if (use_own_tasks) { // check on own queue first
+#endif
         task = __kmp_remove_my_task(thread, gtid, task_team, is_constrained);
       }
       if ((task == NULL) && (nthreads > 1)) { // Steal a task
@@ -2143,6 +2739,15 @@ static inline int __kmp_execute_tasks_template(
         }
         if (victim != -1) { // found last victim
           asleep = 0;
+        } else if (!new_victim &&
+                   __kmp_task_steal_order == task_steal_topology) {
+          // no recent steals; try the threads with tasks, nearest first
+          task = __kmp_steal_near_task(thread, gtid, task_team, threads_data,
+                                       tid, nthreads, unfinished_threads,
+                                       thread_finished, is_constrained,
+                                       &victim);
+          if (task != NULL)
+            other_thread = threads_data[victim].td.td_thr;
         } else if (!new_victim) { // no recent steals and we haven't already
           // used a new victim; select a random thread
           do { // Find a different thread to steal work from.
@@ -2182,10 +2787,23 @@ static inline int __kmp_execute_tasks_template(
         }
 
         if (!asleep) {
-          // We have a victim to try to steal from
-          task = __kmp_steal_task(other_thread, gtid, task_team,
-                                  unfinished_threads, thread_finished,
-                                  is_constrained);
+          // We have a victim to try to steal from. As in
+          // __kmp_steal_near_task, remote steals may take more tasks.
+          bool remote =
+              __kmp_task_steal_order == task_steal_topology &&
+              __kmp_steal_order_valid(thread, &threads_data[tid], nthreads) &&
+              threads_data[tid].td.td_steal_dist[victim] >=
+                  threads_data[tid].td.td_steal_depth;
+          task = __kmp_steal_task(
+              other_thread, gtid, task_team, unfinished_threads,
+              thread_finished, is_constrained,
+              remote && !is_constrained ? TASK_STEAL_BATCH_MAX : 0);
+          if (task != NULL && __kmp_task_steal_order == task_steal_topology) {
+            if (remote)
+              KMP_COUNT_BLOCK(TASK_stolen_remote);
+            else
+              KMP_COUNT_BLOCK(TASK_stolen_near);
+          }
         }
         if (task != NULL) { // set last stolen to victim
           if (threads_data[tid].td.td_deque_last_stolen != victim) {
@@ -2238,7 +2856,7 @@ static inline int __kmp_execute_tasks_template(
       KMP_YIELD(__kmp_library == library_throughput);
       // If execution of a stolen task results in more tasks being placed on our
       // run queue, reset use_own_tasks
-      if (!use_own_tasks && TCR_4(threads_data[tid].td.td_deque_ntasks) != 0) {
+      if (!use_own_tasks && __kmp_deque_ntasks(&threads_data[tid]) != 0) {
         KA_TRACE(20, ("__kmp_execute_tasks_template: T#%d stolen task spawned "
                       "other tasks, restart\n",
                       gtid));
@@ -2263,6 +2881,13 @@ static inline int __kmp_execute_tasks_template(
       if (!*thread_finished) {
         kmp_int32 count;
 
+        if (__kmp_task_deque_kind == task_deque_lock_free) {
+          // A finished thread may have just stolen a task from our lock-free
+          // deque without being counted as unfinished yet.
+          KMP_MB();
+          while (TCR_4(threads_data[tid].td.td_lf_thieves) != 0)
+            KMP_CPU_PAUSE();
+        }
         count = KMP_TEST_THEN_DEC32(unfinished_threads) - 1;
         KA_TRACE(20, ("__kmp_execute_tasks_template: T#%d dec "
                       "unfinished_threads to %d task_team=%p\n",
@@ -2512,6 +3137,24 @@ static void __kmp_free_task_deque(kmp_thread_data_t *thread_data) {
     __kmp_release_bootstrap_lock(&thread_data->td.td_deque_lock);
   }
 
+  // The lock-free deque, with the arrays it has replaced.
+  kmp_task_deque_array_t *array = thread_data->td.td_lf_array;
+  while (array != NULL) {
+    kmp_task_deque_array_t *prev = array->prev;
+    __kmp_free(array);
+    array = prev;
+  }
+  thread_data->td.td_lf_array = NULL;
+  thread_data->td.td_lf_top = 0;
+  thread_data->td.td_lf_bottom = 0;
+
+  if (thread_data->td.td_steal_order != NULL) {
+    __kmp_free(thread_data->td.td_steal_order);
+    __kmp_free(thread_data->td.td_steal_dist);
+    thread_data->td.td_steal_order = NULL;
+    thread_data->td.td_steal_dist = NULL;
+  }
+
 #ifdef BUILD_TIED_TASK_STACK
   // GEH: Figure out what to do here for td_susp_tied_tasks
   if (thread_data->td.td_susp_tied_tasks.ts_entries != TASK_STACK_EMPTY) {
@@ -2678,6 +3321,9 @@ static kmp_task_team_t *__kmp_allocate_task_team(kmp_info_t *thread,
     // kmp_reap_task_team( ).
     task_team = (kmp_task_team_t *)__kmp_allocate(sizeof(kmp_task_team_t));
     __kmp_init_bootstrap_lock(&task_team->tt.tt_threads_lock);
+#if OMP_45_ENABLED
+    __kmp_init_bootstrap_lock(&task_team->tt.tt_task_pri_lock);
+#endif
     // AC: __kmp_allocate zeroes returned memory
     // task_team -> tt.tt_threads_data = NULL;
     // task_team -> tt.tt_max_threads = 0;
@@ -2736,6 +3382,15 @@ void __kmp_reap_task_teams(void) {
       if (task_team->tt.tt_threads_data != NULL) {
         __kmp_free_task_threads_data(task_team);
       }
+#if OMP_45_ENABLED
+      // Free the priority deques
+      while (task_team->tt.tt_task_pri_list != NULL) {
+        kmp_task_pri_t *next = task_team->tt.tt_task_pri_list->next;
+        __kmp_free_task_deque(&task_team->tt.tt_task_pri_list->td);
+        __kmp_free(task_team->tt.tt_task_pri_list);
+        task_team->tt.tt_task_pri_list = next;
+      }
+#endif
       __kmp_free(task_team);
     }
     __kmp_release_bootstrap_lock(&__kmp_task_team_lock);
@@ -3541,6 +4196,10 @@ void __kmpc_taskloop(ident_t *loc, int gtid, kmp_task_t *task, int if_val,
                 "grain %llu(%d), dup %p\n",
                 gtid, taskdata, *lb, *ub, st, grainsize, sched, task_dup));
 
+  // the tasks of the loop are not created through __kmpc_omp_task
+  if (taskdata->td_parent->td_taskgraph)
+    __kmp_taskgraph_disable(taskdata->td_parent->td_taskgraph);
+
   if (nogroup == 0)
     __kmpc_taskgroup(loc, gtid);
 
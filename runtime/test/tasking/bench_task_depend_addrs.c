@@ -0,0 +1,56 @@
+// RUN: %libomp-compile-and-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * Microbenchmark: a single thread creates a fixed number of dependent tasks
+ * spread over a growing number of distinct dependence addresses, so the time
+ * spent in the dependence hash table of the creating task dominates once the
+ * number of addresses gets large.
+ */
+
+#define NTASKS (1 << 18)
+#define MIN_ADDRS (1 << 6)
+#define MAX_ADDRS (1 << 18)
+
+static int buf[MAX_ADDRS];
+
+int main()
+{
+  int naddrs;
+
+  for (naddrs = MIN_ADDRS; naddrs <= MAX_ADDRS; naddrs <<= 4) {
+    int i, errors = 0;
+    double time;
+
+    for (i = 0; i < naddrs; ++i)
+      buf[i] = 0;
+
+    time = omp_get_wtime();
+    #pragma omp parallel
+    #pragma omp single
+    {
+      for (i = 0; i < NTASKS; ++i) {
+        int *out = &buf[i % naddrs];
+        int *in = &buf[(i + 1) % naddrs];
+        #pragma omp task depend(inout: out[0]) depend(in: in[0]) \
+                         firstprivate(out)
+        out[0]++;
+      }
+    }
+    time = omp_get_wtime() - time;
+
+    for (i = 0; i < naddrs; ++i)
+      if (buf[i] != NTASKS / naddrs)
+        errors++;
+    if (errors) {
+      printf("%d of %d addresses with a wrong count\n", errors, naddrs);
+      return EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "%d tasks, %d distinct addresses: %f s\n", NTASKS,
+            naddrs, time);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+// RUN: %libomp-compile && env KMP_TASK_DEQUE=locked %libomp-run
+// RUN: env KMP_TASK_DEQUE=lock_free %libomp-run
+// RUN: env OMP_NUM_THREADS=1 %libomp-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * Microbenchmark: a blocked 1D Jacobi sweep creates the same tasks with the
+ * same dependences at every timestep. The timesteps are run once with the
+ * dependences resolved every time, and once inside a task graph region which
+ * is recorded the first time and replayed afterwards.
+ */
+
+// Compiler-generated code (emulation)
+extern int __kmpc_global_thread_num(void *loc);
+extern int __kmpc_taskgraph_begin(void *loc, int gtid, int graph_id);
+extern void __kmpc_taskgraph_end(void *loc, int gtid, int graph_id);
+
+#define NBLOCKS 64
+#define BS 256
+#define NSTEPS 200
+#define N (NBLOCKS * BS)
+
+static double a[N], b[N], ref[N];
+
+static void sweep(double *dst, const double *src, int blk)
+{
+  int i;
+  for (i = blk * BS; i < (blk + 1) * BS; ++i) {
+    double l = i > 0 ? src[i - 1] : 0.0;
+    double r = i < N - 1 ? src[i + 1] : 0.0;
+    dst[i] = (l + src[i] + r) / 3.0;
+  }
+}
+
+static void init(void)
+{
+  int i;
+  for (i = 0; i < N; ++i)
+    a[i] = b[i] = (double)(i % 97);
+}
+
+// Two sweeps, so that every timestep starts from the same array.
+static void timestep(void)
+{
+  int blk;
+  for (blk = 0; blk < NBLOCKS; ++blk) {
+    int lo = blk > 0 ? blk - 1 : blk;
+    int hi = blk < NBLOCKS - 1 ? blk + 1 : blk;
+    #pragma omp task firstprivate(blk) depend(in: a[lo * BS], a[blk * BS], \
+                     a[hi * BS]) depend(out: b[blk * BS])
+    sweep(b, a, blk);
+  }
+  for (blk = 0; blk < NBLOCKS; ++blk) {
+    int lo = blk > 0 ? blk - 1 : blk;
+    int hi = blk < NBLOCKS - 1 ? blk + 1 : blk;
+    #pragma omp task firstprivate(blk) depend(in: b[lo * BS], b[blk * BS], \
+                     b[hi * BS]) depend(out: a[blk * BS])
+    sweep(a, b, blk);
+  }
+}
+
+int main()
+{
+  int i, step, replayed = 0;
+  double time, time_graph;
+
+  init();
+  for (step = 0; step < NSTEPS; ++step) {
+    for (i = 0; i < NBLOCKS; ++i)
+      sweep(b, a, i);
+    for (i = 0; i < NBLOCKS; ++i)
+      sweep(a, b, i);
+  }
+  for (i = 0; i < N; ++i)
+    ref[i] = a[i];
+
+  init();
+  time = omp_get_wtime();
+  #pragma omp parallel
+  #pragma omp single
+  for (step = 0; step < NSTEPS; ++step) {
+    timestep();
+    #pragma omp taskwait
+  }
+  time = omp_get_wtime() - time;
+  for (i = 0; i < N; ++i)
+    if (a[i] != ref[i]) {
+      printf("wrong value at %d without task graph\n", i);
+      return EXIT_FAILURE;
+    }
+
+  init();
+  time_graph = omp_get_wtime();
+  #pragma omp parallel
+  #pragma omp single
+  for (step = 0; step < NSTEPS; ++step) {
+    int gtid = __kmpc_global_thread_num(NULL);
+    if (__kmpc_taskgraph_begin(NULL, gtid, 1))
+      timestep();
+    else
+      replayed++;
+    __kmpc_taskgraph_end(NULL, gtid, 1);
+  }
+  time_graph = omp_get_wtime() - time_graph;
+  for (i = 0; i < N; ++i)
+    if (a[i] != ref[i]) {
+      printf("wrong value at %d with task graph\n", i);
+      return EXIT_FAILURE;
+    }
+  if (replayed != NSTEPS - 1) {
+    printf("task graph replayed %d times, expected %d\n", replayed,
+           NSTEPS - 1);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(stderr, "%d timesteps of %d tasks: %f s, with task graph: %f s\n",
+          NSTEPS, 2 * NBLOCKS, time, time_graph);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+// RUN: %libomp-compile && env KMP_TASK_DEQUE=lock_free %libomp-run
+// RUN: env KMP_TASK_STEAL_ORDER=topology KMP_TASK_DEQUE=lock_free %libomp-run
+// RUN: env KMP_TASK_STEAL_ORDER=topology KMP_TASK_DEQUE=locked %libomp-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * Idle threads steal leaf tasks, by batches with the topology steal order,
+ * without ever pushing a task of their own. The threads waiting for their
+ * leaves in a taskwait steal from them in turn, and must leave the leaves of
+ * the other parents, which they are not allowed to run, in place.
+ */
+
+#define NPARENTS 3
+#define NLEAVES 2000
+#define REPS 20
+
+static int work(int n)
+{
+  int i, x = 0;
+  for (i = 0; i < n; ++i)
+    x += i ^ n;
+  return x;
+}
+
+int main()
+{
+  int r;
+
+  for (r = 0; r < REPS; ++r) {
+    int count = 0;
+    #pragma omp parallel num_threads(8) shared(count)
+    #pragma omp single
+    {
+      int p;
+      for (p = 0; p < NPARENTS; ++p) {
+        #pragma omp task shared(count)
+        {
+          int i;
+          for (i = 0; i < NLEAVES; ++i) {
+            #pragma omp task firstprivate(i) shared(count)
+            {
+              volatile int x = work(i % 256);
+              (void)x;
+              #pragma omp atomic
+              count++;
+            }
+          }
+          #pragma omp taskwait
+        }
+      }
+    }
+    if (count != NPARENTS * NLEAVES) {
+      printf("%d tasks executed, expected %d\n", count, NPARENTS * NLEAVES);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+// RUN: %libomp-compile && env KMP_TASK_DEQUE=locked %libomp-run
+// RUN: env KMP_TASK_DEQUE=lock_free %libomp-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * Recursive Fibonacci with one task per call and a taskwait per level. The
+ * owners push and pop tiny tied tasks while the other threads steal them
+ * under the task scheduling constraint. Every task must run exactly once for
+ * the result to be right.
+ */
+
+#define N 22
+#define NITERS 5
+
+static long fib(int n)
+{
+  long x, y;
+  if (n < 2)
+    return n;
+  #pragma omp task shared(x)
+  x = fib(n - 1);
+  #pragma omp task shared(y)
+  y = fib(n - 2);
+  #pragma omp taskwait
+  return x + y;
+}
+
+static long fib_seq(int n)
+{
+  return n < 2 ? n : fib_seq(n - 1) + fib_seq(n - 2);
+}
+
+int main()
+{
+  int it;
+  long expected = fib_seq(N);
+
+  for (it = 0; it < NITERS; ++it) {
+    long result = 0;
+    #pragma omp parallel
+    #pragma omp single
+    result = fib(N);
+    if (result != expected) {
+      printf("fib(%d) = %ld, expected %ld\n", N, result, expected);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("passed\n");
+  return EXIT_SUCCESS;
+}
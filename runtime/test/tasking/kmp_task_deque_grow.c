@@ -0,0 +1,46 @@
+// RUN: %libomp-compile && env KMP_TASK_DEQUE=locked %libomp-run
+// RUN: env KMP_TASK_DEQUE=lock_free %libomp-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * One thread spawns many more tasks than the initial deque holds while the
+ * others steal them. With the locked deque the tasks which do not fit are run
+ * immediately by the producer, the lock-free deque grows instead and must not
+ * lose or duplicate a task while its array is replaced.
+ */
+
+#define NTASKS 100000
+
+static int ran[NTASKS];
+
+int main()
+{
+  int i, errors = 0;
+
+  #pragma omp parallel
+  #pragma omp single
+  {
+    for (i = 0; i < NTASKS; ++i) {
+      #pragma omp task firstprivate(i)
+      {
+        #pragma omp atomic
+        ran[i]++;
+      }
+    }
+  }
+
+  for (i = 0; i < NTASKS; ++i)
+    if (ran[i] != 1) {
+      if (errors++ < 10)
+        printf("task %d ran %d times\n", i, ran[i]);
+    }
+
+  if (errors) {
+    printf("failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("passed\n");
+  return EXIT_SUCCESS;
+}
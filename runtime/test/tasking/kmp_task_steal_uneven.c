@@ -0,0 +1,65 @@
+// RUN: %libomp-compile && env KMP_TASK_DEQUE=locked %libomp-run
+// RUN: env KMP_TASK_DEQUE=lock_free %libomp-run
+// RUN: env KMP_TASK_STEAL_ORDER=topology %libomp-run
+// RUN: env KMP_TASK_STEAL_ORDER=topology KMP_TASK_DEQUE=lock_free %libomp-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * Every thread spawns tasks of uneven length into its own deque, so that the
+ * threads running out of work steal from the others while the owners keep
+ * pushing and popping. With KMP_TASK_STEAL_ORDER=topology, the thieves try
+ * the nearest threads first and take several tasks at once from remote ones.
+ * Every task must run exactly once.
+ */
+
+#define MAX_THREADS 64
+#define NTASKS_PER_THREAD 5000
+
+static int ran[MAX_THREADS][NTASKS_PER_THREAD];
+
+static int work(int n)
+{
+  int i, x = 0;
+  for (i = 0; i < n; ++i)
+    x += i ^ n;
+  return x;
+}
+
+int main()
+{
+  int t, i, nthreads = 0, errors = 0;
+
+  #pragma omp parallel num_threads(omp_get_max_threads() < MAX_THREADS ? \
+                                   omp_get_max_threads() : MAX_THREADS)
+  {
+    int j, tid = omp_get_thread_num();
+    #pragma omp single nowait
+    nthreads = omp_get_num_threads();
+    for (j = 0; j < NTASKS_PER_THREAD; ++j) {
+      #pragma omp task firstprivate(j, tid)
+      {
+        // Threads with a low number have much more work.
+        volatile int x = work((j % 64) * (tid < 2 ? 64 : 1));
+        (void)x;
+        #pragma omp atomic
+        ran[tid][j]++;
+      }
+    }
+  }
+
+  for (t = 0; t < nthreads; ++t)
+    for (i = 0; i < NTASKS_PER_THREAD; ++i)
+      if (ran[t][i] != 1) {
+        if (errors++ < 10)
+          printf("task %d of thread %d ran %d times\n", i, t, ran[t][i]);
+      }
+
+  if (errors) {
+    printf("failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("passed\n");
+  return EXIT_SUCCESS;
+}
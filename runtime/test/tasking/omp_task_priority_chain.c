@@ -0,0 +1,88 @@
+// RUN: %libomp-compile && env OMP_MAX_TASK_PRIORITY=0 %libomp-run
+// RUN: env OMP_MAX_TASK_PRIORITY=10 %libomp-run
+// RUN: env OMP_MAX_TASK_PRIORITY=10 KMP_TASK_DEQUE=lock_free %libomp-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * A single thread generates the steps of a factorization-like computation.
+ * Each step has one critical task, depending on the critical task of the
+ * previous step, followed by many independent bulk tasks. The critical tasks
+ * have a priority: unless OMP_MAX_TASK_PRIORITY=0, the threads must run each
+ * of them as soon as it is ready, so that the chain finishes before most of
+ * the bulk tasks have run. All the tasks fit in the deque of the generating
+ * thread.
+ */
+
+#define NSTEPS 16
+#define NBULK 14
+// The bulk tasks are long enough that the preemption of the thread running
+// the chain does not let the other threads run many of them.
+#define CRITICAL_WORK 20000
+#define BULK_WORK 1000000
+
+static int work(int n)
+{
+  int i, x = 0;
+  for (i = 0; i < n; ++i)
+    x += i ^ n;
+  return x;
+}
+
+int main()
+{
+  int chain = 0, count = 0, bulk_before_end = 0, errors = 0;
+
+  #pragma omp parallel shared(chain, count, bulk_before_end)
+  #pragma omp single
+  {
+    int k, i;
+    for (k = 0; k < NSTEPS; ++k) {
+      #pragma omp task depend(inout: chain) priority(10) firstprivate(k) \
+          shared(chain, count, bulk_before_end)
+      {
+        volatile int x = work(CRITICAL_WORK);
+        (void)x;
+        if (chain != k) {
+          printf("critical task %d ran after %d tasks\n", k, chain);
+          #pragma omp atomic
+          errors++;
+        }
+        chain++;
+        if (k == NSTEPS - 1) {
+          #pragma omp atomic read
+          bulk_before_end = count;
+        }
+      }
+      for (i = 0; i < NBULK; ++i) {
+        #pragma omp task shared(count)
+        {
+          volatile int x = work(BULK_WORK);
+          (void)x;
+          #pragma omp atomic
+          count++;
+        }
+      }
+    }
+  }
+
+  if (chain != NSTEPS || count != NSTEPS * NBULK) {
+    printf("%d critical and %d bulk tasks executed, expected %d and %d\n",
+           chain, count, NSTEPS, NSTEPS * NBULK);
+    errors++;
+  }
+  if (omp_get_max_task_priority() > 0 &&
+      bulk_before_end >= NSTEPS * NBULK / 2) {
+    printf("%d of %d bulk tasks ran before the end of the critical chain\n",
+           bulk_before_end, NSTEPS * NBULK);
+    errors++;
+  }
+
+  if (errors) {
+    printf("failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+// RUN: %libomp-compile && env KMP_TASK_DEQUE=locked %libomp-run
+// RUN: env KMP_TASK_DEQUE=lock_free %libomp-run
+// RUN: env OMP_NUM_THREADS=1 %libomp-run
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+/*
+ * Task graph regions which must not simply replay their recording: a task
+ * created before the region is a predecessor of its tasks, the region is
+ * nested in itself, it is encountered from frames at different depths, and
+ * the same graph identifier is used at two call sites of a frame.
+ */
+
+// Compiler-generated code (emulation)
+extern int __kmpc_global_thread_num(void *loc);
+extern int __kmpc_taskgraph_begin(void *loc, int gtid, int graph_id);
+extern void __kmpc_taskgraph_end(void *loc, int gtid, int graph_id);
+
+#define NITERS 50
+
+static int errors = 0;
+
+static void delay(void)
+{
+  double start = omp_get_wtime();
+  while (omp_get_wtime() - start < 1e-3)
+    ;
+}
+
+// The task of the region reads x, written by a task created before it.
+static void pending_predecessor(void)
+{
+  int it, x = -1, y = -1;
+  for (it = 0; it < NITERS; ++it) {
+    int gtid = __kmpc_global_thread_num(NULL);
+    #pragma omp task depend(out: x) shared(x) firstprivate(it)
+    {
+      delay();
+      x = it;
+    }
+    if (__kmpc_taskgraph_begin(NULL, gtid, 1)) {
+      #pragma omp task depend(in: x) shared(x, y)
+      y = x;
+    }
+    __kmpc_taskgraph_end(NULL, gtid, 1);
+    if (y != it) {
+      printf("pending predecessor: y=%d at iteration %d\n", y, it);
+      errors++;
+    }
+  }
+}
+
+// The nested region must not end the recording of the enclosing one.
+static void nested(void)
+{
+  int it, count;
+  for (it = 0; it < NITERS; ++it) {
+    int gtid = __kmpc_global_thread_num(NULL);
+    count = 0;
+    if (__kmpc_taskgraph_begin(NULL, gtid, 2)) {
+      #pragma omp task shared(count)
+      {
+        #pragma omp atomic
+        count++;
+      }
+      if (__kmpc_taskgraph_begin(NULL, gtid, 2)) {
+        #pragma omp task shared(count)
+        {
+          #pragma omp atomic
+          count++;
+        }
+      }
+      __kmpc_taskgraph_end(NULL, gtid, 2);
+      #pragma omp task shared(count)
+      {
+        #pragma omp atomic
+        count++;
+      }
+    }
+    __kmpc_taskgraph_end(NULL, gtid, 2);
+    if (count != 3) {
+      printf("nested: %d tasks run at iteration %d\n", count, it);
+      errors++;
+    }
+  }
+}
+
+// The task of the region writes a local variable of its frame.
+static int frame_local(void)
+{
+  int gtid = __kmpc_global_thread_num(NULL);
+  int local = 0;
+  if (__kmpc_taskgraph_begin(NULL, gtid, 3)) {
+    #pragma omp task shared(local)
+    local = 1;
+  }
+  __kmpc_taskgraph_end(NULL, gtid, 3);
+  return local;
+}
+
+static int deeper(int depth)
+{
+  volatile char pad[256];
+  pad[0] = 0;
+  return depth > 0 ? deeper(depth - 1) + pad[0] : frame_local();
+}
+
+static void frames(void)
+{
+  int it;
+  for (it = 0; it < NITERS; ++it)
+    if ((it % 3 ? frame_local() : deeper(it % 5)) != 1) {
+      printf("frames: local not written at iteration %d\n", it);
+      errors++;
+    }
+}
+
+// Two regions of the same frame with the same identifier create other tasks.
+static void sites(void)
+{
+  int it;
+  for (it = 0; it < NITERS; ++it) {
+    int gtid = __kmpc_global_thread_num(NULL);
+    int a = 0, b = 0;
+    if (__kmpc_taskgraph_begin(NULL, gtid, 4)) {
+      #pragma omp task shared(a)
+      a = 1;
+    }
+    __kmpc_taskgraph_end(NULL, gtid, 4);
+    if (__kmpc_taskgraph_begin(NULL, gtid, 4)) {
+      #pragma omp task shared(b)
+      b = 1;
+    }
+    __kmpc_taskgraph_end(NULL, gtid, 4);
+    if (a != 1 || b != 1) {
+      printf("sites: a=%d b=%d at iteration %d\n", a, b, it);
+      errors++;
+    }
+  }
+}
+
+int main()
+{
+  #pragma omp parallel
+  #pragma omp single
+  {
+    pending_predecessor();
+    nested();
+    frames();
+    sites();
+  }
+
+  if (errors) {
+    printf("failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("passed\n");
+  return EXIT_SUCCESS;
+}